@@ -221,6 +221,135 @@ AC_DEFUN([X11_EXT_SHAPE],
 ])
 
 
+# X11_EXT_SHM()
+#
+# Check for the presence of the "MIT-SHM" X Window System extension.
+# Defines "MITSHM", sets the $(XSHM) variable to "yes", and sets the $(LIBS)
+# appropriately if the extension is present.
+AC_DEFUN([X11_EXT_SHM],
+[
+  AC_REQUIRE([X11_DEVEL])
+
+  AC_ARG_ENABLE([xshm],
+  AC_HELP_STRING(
+  [--disable-xshm],
+  [build without support for the MIT-SHM extension [default=enabled]]),
+  [USE=$enableval], [USE="yes"])
+
+  if test "$USE" = "yes"; then
+    # Store these
+    OLDLIBS=$LIBS
+    OLDCPPFLAGS=$CPPFLAGS
+
+    CPPFLAGS="$CPPFLAGS $X_CFLAGS"
+    LIBS="$LIBS $X_LIBS"
+
+    AC_CHECK_LIB([Xext], [XShmQueryExtension],
+      AC_MSG_CHECKING([for X11/extensions/XShm.h])
+      AC_TRY_LINK(
+      [
+        #include <sys/types.h>
+        #include <sys/ipc.h>
+        #include <sys/shm.h>
+        #include <X11/Xlib.h>
+        #include <X11/Xutil.h>
+        #include <X11/extensions/XShm.h>
+      ],
+      [
+        XShmSegmentInfo foo;
+        shmget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+      ],
+      [
+        AC_MSG_RESULT([yes])
+        XSHM="yes"
+        AC_DEFINE([MITSHM], [1], [Found the MIT-SHM extension])
+
+        XSHM_CFLAGS=""
+        XSHM_LIBS="-lXext"
+        AC_SUBST(XSHM_CFLAGS)
+        AC_SUBST(XSHM_LIBS)
+      ],
+      [
+        AC_MSG_RESULT([no])
+        XSHM="no"
+      ])
+    )
+
+    LIBS=$OLDLIBS
+    CPPFLAGS=$OLDCPPFLAGS
+  fi
+
+  AC_MSG_CHECKING([for the MIT-SHM extension])
+  if test "$XSHM" = "yes"; then
+    AC_MSG_RESULT([yes])
+  else
+    AC_MSG_RESULT([no])
+  fi
+])
+
+
+# X11_EXT_XRENDER()
+#
+# Check for the presence of the "Render" X Window System extension.
+# Defines "XRENDER", sets the $(XRENDER) variable to "yes", and sets the
+# $(LIBS) appropriately if the extension is present.
+AC_DEFUN([X11_EXT_XRENDER],
+[
+  AC_REQUIRE([X11_DEVEL])
+
+  AC_ARG_ENABLE([xrender],
+  AC_HELP_STRING(
+  [--disable-xrender],
+  [build without support for the render extension [default=enabled]]),
+  [USE=$enableval], [USE="yes"])
+
+  if test "$USE" = "yes"; then
+    # Store these
+    OLDLIBS=$LIBS
+    OLDCPPFLAGS=$CPPFLAGS
+
+    CPPFLAGS="$CPPFLAGS $X_CFLAGS"
+    LIBS="$LIBS $X_LIBS"
+
+    AC_CHECK_LIB([Xrender], [XRenderCreateSolidFill],
+      AC_MSG_CHECKING([for X11/extensions/Xrender.h])
+      AC_TRY_LINK(
+      [
+        #include <X11/Xlib.h>
+        #include <X11/extensions/Xrender.h>
+      ],
+      [
+        XRenderColor foo;
+      ],
+      [
+        AC_MSG_RESULT([yes])
+        XRENDER="yes"
+        AC_DEFINE([XRENDER], [1], [Found the Render extension])
+
+        XRENDER_CFLAGS=""
+        XRENDER_LIBS="-lXrender"
+        AC_SUBST(XRENDER_CFLAGS)
+        AC_SUBST(XRENDER_LIBS)
+      ],
+      [
+        AC_MSG_RESULT([no])
+        XRENDER="no"
+      ])
+    )
+
+    LIBS=$OLDLIBS
+    CPPFLAGS=$OLDCPPFLAGS
+  fi
+
+  AC_MSG_CHECKING([for the Render extension])
+  if test "$XRENDER" = "yes"; then
+    AC_MSG_RESULT([yes])
+  else
+    AC_MSG_RESULT([no])
+  fi
+])
+
+
 # X11_EXT_XINERAMA()
 #
 # Check for the presence of the "Xinerama" X Window System extension.
@@ -395,6 +524,69 @@ AC_DEFUN([X11_EXT_AUTH],
   fi
 ])
 
+# X11_XCB()
+#
+# Check whether Xlib is built on XCB, so that XCB requests can be sent on the
+# same display connection.
+# Defines "XCB", sets the $(XCB) variable to "yes", and sets the $(LIBS)
+# appropriately if it is.
+AC_DEFUN([X11_XCB],
+[
+  AC_REQUIRE([X11_DEVEL])
+
+  AC_ARG_ENABLE([xcb],
+  AC_HELP_STRING(
+  [--disable-xcb],
+  [build without sending requests through XCB [default=enabled]]),
+  [USE=$enableval], [USE="yes"])
+
+  if test "$USE" = "yes"; then
+    # Store these
+    OLDLIBS=$LIBS
+    OLDCPPFLAGS=$CPPFLAGS
+
+    CPPFLAGS="$CPPFLAGS $X_CFLAGS"
+    LIBS="$LIBS $X_LIBS -lxcb"
+
+    AC_CHECK_LIB([X11-xcb], [XGetXCBConnection],
+      AC_MSG_CHECKING([for X11/Xlib-xcb.h])
+      AC_TRY_LINK(
+      [
+        #include <X11/Xlib.h>
+        #include <X11/Xlib-xcb.h>
+        #include <xcb/xcb.h>
+      ],
+      [
+        xcb_get_property_cookie_t foo;
+      ],
+      [
+        AC_MSG_RESULT([yes])
+        XCB="yes"
+        AC_DEFINE([XCB], [1], [Xlib is built on XCB])
+
+        XCB_CFLAGS=""
+        XCB_LIBS="-lX11-xcb -lxcb"
+        AC_SUBST(XCB_CFLAGS)
+        AC_SUBST(XCB_LIBS)
+      ],
+      [
+        AC_MSG_RESULT([no])
+        XCB="no"
+      ])
+    )
+
+    LIBS=$OLDLIBS
+    CPPFLAGS=$OLDCPPFLAGS
+  fi
+
+  AC_MSG_CHECKING([for Xlib on XCB])
+  if test "$XCB" = "yes"; then
+    AC_MSG_RESULT([yes])
+  else
+    AC_MSG_RESULT([no])
+  fi
+])
+
 # X11_SM()
 #
 # Check for the presence of SMlib for session management.
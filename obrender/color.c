@@ -21,11 +21,16 @@
 #include "render.h"
 #include "color.h"
 #include "instance.h"
+#include "simd.h"
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <string.h>
 
+#ifdef RR_SIMD_X86
+#  include <immintrin.h>
+#endif
+
 void RrColorAllocateGC(RrColor *in)
 {
     XGCValues gcv;
@@ -122,27 +127,126 @@ void RrColorFree(RrColor *c)
     }
 }
 
+#ifdef RR_SIMD_X86
+
+/* the kernels here convert a row of pixels at a time, and return how many of
+   them they converted.  the scalar code does the rest.  the visual's shifts
+   differ between displays, so they are passed in registers. */
+
+/*! Convert RrPixel32s into the visual's 32 or 16 bit TrueColor pixels */
+RR_TARGET_SSE2
+static gint reduce_row_sse2(const RrInstance *inst, const RrPixel32 *data,
+                            gpointer out, gint w, gint bpp)
+{
+    /* a channel wider than 8 bits has a negative shift, and is widened by
+       shifting it that much further left, like the instance's tables do */
+    const __m128i ff = _mm_set1_epi32(0xff);
+    const __m128i rs = _mm_cvtsi32_si128(MAX(RrRedShift(inst), 0));
+    const __m128i gs = _mm_cvtsi32_si128(MAX(RrGreenShift(inst), 0));
+    const __m128i bs = _mm_cvtsi32_si128(MAX(RrBlueShift(inst), 0));
+    const __m128i ro = _mm_cvtsi32_si128(RrRedOffset(inst) +
+                                         MAX(-RrRedShift(inst), 0));
+    const __m128i go = _mm_cvtsi32_si128(RrGreenOffset(inst) +
+                                         MAX(-RrGreenShift(inst), 0));
+    const __m128i bo = _mm_cvtsi32_si128(RrBlueOffset(inst) +
+                                         MAX(-RrBlueShift(inst), 0));
+    __m128i p[2];
+    gint x, i;
+
+    for (x = 0; x + 8 <= w; x += 8) {
+        for (i = 0; i < 2; ++i) {
+            __m128i s, r, g, b;
+
+            s = _mm_loadu_si128((__m128i*)(data + x + i * 4));
+            r = _mm_and_si128(_mm_srli_epi32(s, RrDefaultRedOffset), ff);
+            g = _mm_and_si128(_mm_srli_epi32(s, RrDefaultGreenOffset), ff);
+            b = _mm_and_si128(_mm_srli_epi32(s, RrDefaultBlueOffset), ff);
+            r = _mm_sll_epi32(_mm_srl_epi32(r, rs), ro);
+            g = _mm_sll_epi32(_mm_srl_epi32(g, gs), go);
+            b = _mm_sll_epi32(_mm_srl_epi32(b, bs), bo);
+            p[i] = _mm_or_si128(_mm_or_si128(r, g), b);
+        }
+        if (bpp == 32) {
+            _mm_storeu_si128((__m128i*)((RrPixel32*)out + x), p[0]);
+            _mm_storeu_si128((__m128i*)((RrPixel32*)out + x + 4), p[1]);
+        }
+        else {
+            /* sign extend the low 16 bits so that they survive the signed
+               saturation in the pack */
+            p[0] = _mm_srai_epi32(_mm_slli_epi32(p[0], 16), 16);
+            p[1] = _mm_srai_epi32(_mm_slli_epi32(p[1], 16), 16);
+            _mm_storeu_si128((__m128i*)((RrPixel16*)out + x),
+                             _mm_packs_epi32(p[0], p[1]));
+        }
+    }
+    return x;
+}
+
+/*! Convert RrPixel32s into packed 24 bit pixels, with the red, green and blue
+  bytes at roff, goff and boff in each one */
+RR_TARGET_SSSE3
+static gint reduce_row24_ssse3(const RrPixel32 *data, RrPixel8 *out, gint w,
+                               guint roff, guint goff, guint boff)
+{
+    gint8 m[16];
+    __m128i mask;
+    gint x, i;
+
+    /* move the bytes of 4 pixels into the first 12 bytes */
+    memset(m, 0x80, sizeof(m));
+    for (i = 0; i < 4; ++i) {
+        m[i * 3 + roff] = i * 4 + RrDefaultRedOffset / 8;
+        m[i * 3 + goff] = i * 4 + RrDefaultGreenOffset / 8;
+        m[i * 3 + boff] = i * 4 + RrDefaultBlueOffset / 8;
+    }
+    mask = _mm_loadu_si128((__m128i*)m);
+
+    for (x = 0; x + 4 <= w; x += 4, out += 12) {
+        __m128i p;
+        guint32 last;
+
+        p = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)(data + x)), mask);
+        _mm_storel_epi64((__m128i*)out, p);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(p, 8));
+        memcpy(out + 8, &last, 4);
+    }
+    return x;
+}
+
+#endif
+
 void RrReduceDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
 {
-    gint r, g, b;
+    const RrPixelTables *t = RrInstancePixelTables(inst);
     gint x,y;
     RrPixel32 *p32 = (RrPixel32 *) im->data;
     RrPixel16 *p16 = (RrPixel16 *) im->data;
     RrPixel8  *p8  = (RrPixel8 *)  im->data;
+#ifdef RR_SIMD_X86
+    gboolean simd;
+
+    simd = RrSimdGetLevel() >= RR_SIMD_SSE2 &&
+        RrVisual(inst)->class == TrueColor;
+#endif
+
+    /* the channels of an RrPixel32, looked up in the instance's tables */
+#define REDUCE(p) (t->red[((p) >> RrDefaultRedOffset) & 0xFF] | \
+                   t->green[((p) >> RrDefaultGreenOffset) & 0xFF] | \
+                   t->blue[((p) >> RrDefaultBlueOffset) & 0xFF])
+
     switch (im->bits_per_pixel) {
     case 32:
         if ((RrRedOffset(inst) != RrDefaultRedOffset) ||
             (RrBlueOffset(inst) != RrDefaultBlueOffset) ||
             (RrGreenOffset(inst) != RrDefaultGreenOffset)) {
             for (y = 0; y < im->height; y++) {
-                for (x = 0; x < im->width; x++) {
-                    r = (data[x] >> RrDefaultRedOffset) & 0xFF;
-                    g = (data[x] >> RrDefaultGreenOffset) & 0xFF;
-                    b = (data[x] >> RrDefaultBlueOffset) & 0xFF;
-                    p32[x] = (r << RrRedOffset(inst))
-                           + (g << RrGreenOffset(inst))
-                           + (b << RrBlueOffset(inst));
-                }
+                x = 0;
+#ifdef RR_SIMD_X86
+                if (simd)
+                    x = reduce_row_sse2(inst, data, p32, im->width, 32);
+#endif
+                for (; x < im->width; x++)
+                    p32[x] = REDUCE(data[x]);
                 data += im->width;
                 p32 += im->width;
             }
@@ -157,13 +261,15 @@ void RrReduceDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
         const guint boff = (16 - RrBlueOffset(inst)) / 8;
         gint outx;
         for (y = 0; y < im->height; y++) {
-            for (x = 0, outx = 0; x < im->width; x++, outx += 3) {
-                r = (data[x] >> RrDefaultRedOffset) & 0xFF;
-                g = (data[x] >> RrDefaultGreenOffset) & 0xFF;
-                b = (data[x] >> RrDefaultBlueOffset) & 0xFF;
-                p8[outx+roff] = r;
-                p8[outx+goff] = g;
-                p8[outx+boff] = b;
+            x = 0;
+#ifdef RR_SIMD_X86
+            if (simd && RrSimdGetLevel() >= RR_SIMD_SSSE3)
+                x = reduce_row24_ssse3(data, p8, im->width, roff, goff, boff);
+#endif
+            for (outx = x * 3; x < im->width; x++, outx += 3) {
+                p8[outx+roff] = (data[x] >> RrDefaultRedOffset) & 0xFF;
+                p8[outx+goff] = (data[x] >> RrDefaultGreenOffset) & 0xFF;
+                p8[outx+boff] = (data[x] >> RrDefaultBlueOffset) & 0xFF;
             }
             data += im->width;
             p8 += im->bytes_per_line;
@@ -172,17 +278,13 @@ void RrReduceDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
     }
     case 16:
         for (y = 0; y < im->height; y++) {
-            for (x = 0; x < im->width; x++) {
-                r = (data[x] >> RrDefaultRedOffset) & 0xFF;
-                r = r >> RrRedShift(inst);
-                g = (data[x] >> RrDefaultGreenOffset) & 0xFF;
-                g = g >> RrGreenShift(inst);
-                b = (data[x] >> RrDefaultBlueOffset) & 0xFF;
-                b = b >> RrBlueShift(inst);
-                p16[x] = (r << RrRedOffset(inst))
-                       + (g << RrGreenOffset(inst))
-                       + (b << RrBlueOffset(inst));
-            }
+            x = 0;
+#ifdef RR_SIMD_X86
+            if (simd)
+                x = reduce_row_sse2(inst, data, p16, im->width, 16);
+#endif
+            for (; x < im->width; x++)
+                p16[x] = REDUCE(data[x]);
             data += im->width;
             p16 += im->bytes_per_line/2;
         }
@@ -190,28 +292,19 @@ void RrReduceDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
     case 8:
         if (RrVisual(inst)->class == TrueColor) {
             for (y = 0; y < im->height; y++) {
-                for (x = 0; x < im->width; x++) {
-                    r = (data[x] >> RrDefaultRedOffset) & 0xFF;
-                    r = r >> RrRedShift(inst);
-                    g = (data[x] >> RrDefaultGreenOffset) & 0xFF;
-                    g = g >> RrGreenShift(inst);
-                    b = (data[x] >> RrDefaultBlueOffset) & 0xFF;
-                    b = b >> RrBlueShift(inst);
-                    p8[x] = (r << RrRedOffset(inst))
-                        + (g << RrGreenOffset(inst))
-                        + (b << RrBlueOffset(inst));
-                }
+                for (x = 0; x < im->width; x++)
+                    p8[x] = REDUCE(data[x]);
                 data += im->width;
                 p8 += im->bytes_per_line;
             }
         } else {
+            /* the tables give the index into the pseudo colors, like
+               RrPickColor would */
+            const XColor *colors = RrPseudoColors(inst);
+
             for (y = 0; y < im->height; y++) {
-                for (x = 0; x < im->width; x++) {
-                    p8[x] = RrPickColor(inst,
-                                        data[x] >> RrDefaultRedOffset,
-                                        data[x] >> RrDefaultGreenOffset,
-                                        data[x] >> RrDefaultBlueOffset)->pixel;
-                }
+                for (x = 0; x < im->width; x++)
+                    p8[x] = colors[REDUCE(data[x])].pixel;
                 data += im->width;
                 p8 += im->bytes_per_line;
             }
@@ -221,6 +314,7 @@ void RrReduceDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
         g_error("This image bit depth (%i) is currently unhandled", im->bits_per_pixel);
 
     }
+#undef REDUCE
 }
 
 XColor *RrPickColor(const RrInstance *inst, gint r, gint g, gint b)
@@ -269,21 +363,138 @@ static void swap_byte_order(XImage *im)
         im->byte_order = LSBFirst;
 }
 
+#ifdef RR_SIMD_X86
+
+/*! Convert the visual's 32 bit TrueColor pixels into RrPixel32s */
+RR_TARGET_SSE2
+static gint increase_row32_sse2(const RrInstance *inst, const RrPixel32 *in,
+                                RrPixel32 *data, gint w)
+{
+    const __m128i ff = _mm_set1_epi32(0xff);
+    const __m128i alpha = _mm_set1_epi32(0xff << RrDefaultAlphaOffset);
+    const __m128i ro = _mm_cvtsi32_si128(RrRedOffset(inst));
+    const __m128i go = _mm_cvtsi32_si128(RrGreenOffset(inst));
+    const __m128i bo = _mm_cvtsi32_si128(RrBlueOffset(inst));
+    gint x;
+
+    for (x = 0; x + 4 <= w; x += 4) {
+        __m128i p, r, g, b;
+
+        p = _mm_loadu_si128((__m128i*)(in + x));
+        r = _mm_and_si128(_mm_srl_epi32(p, ro), ff);
+        g = _mm_and_si128(_mm_srl_epi32(p, go), ff);
+        b = _mm_and_si128(_mm_srl_epi32(p, bo), ff);
+        p = _mm_or_si128(_mm_or_si128(
+                             _mm_slli_epi32(r, RrDefaultRedOffset),
+                             _mm_slli_epi32(g, RrDefaultGreenOffset)),
+                         _mm_or_si128(
+                             _mm_slli_epi32(b, RrDefaultBlueOffset), alpha));
+        _mm_storeu_si128((__m128i*)(data + x), p);
+    }
+    return x;
+}
+
+/*! Convert the visual's 16 bit TrueColor pixels into RrPixel32s */
+RR_TARGET_SSE2
+static gint increase_row16_sse2(const RrInstance *inst, const RrPixel16 *in,
+                                RrPixel32 *data, gint w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32(0xff << RrDefaultAlphaOffset);
+    const __m128i rm = _mm_set1_epi32(RrRedMask(inst));
+    const __m128i gm = _mm_set1_epi32(RrGreenMask(inst));
+    const __m128i bm = _mm_set1_epi32(RrBlueMask(inst));
+    const __m128i ro = _mm_cvtsi32_si128(RrRedOffset(inst));
+    const __m128i go = _mm_cvtsi32_si128(RrGreenOffset(inst));
+    const __m128i bo = _mm_cvtsi32_si128(RrBlueOffset(inst));
+    const __m128i rs = _mm_cvtsi32_si128(RrRedShift(inst) +
+                                         RrDefaultRedOffset);
+    const __m128i gs = _mm_cvtsi32_si128(RrGreenShift(inst) +
+                                         RrDefaultGreenOffset);
+    const __m128i bs = _mm_cvtsi32_si128(RrBlueShift(inst) +
+                                         RrDefaultBlueOffset);
+    gint x, i;
+
+    for (x = 0; x + 8 <= w; x += 8) {
+        __m128i s, p[2];
+
+        s = _mm_loadu_si128((__m128i*)(in + x));
+        p[0] = _mm_unpacklo_epi16(s, zero);
+        p[1] = _mm_unpackhi_epi16(s, zero);
+        for (i = 0; i < 2; ++i) {
+            __m128i r, g, b;
+
+            r = _mm_sll_epi32(_mm_srl_epi32(_mm_and_si128(p[i], rm), ro), rs);
+            g = _mm_sll_epi32(_mm_srl_epi32(_mm_and_si128(p[i], gm), go), gs);
+            b = _mm_sll_epi32(_mm_srl_epi32(_mm_and_si128(p[i], bm), bo), bs);
+            p[i] = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha));
+            _mm_storeu_si128((__m128i*)(data + x + i * 4), p[i]);
+        }
+    }
+    return x;
+}
+
+/*! Convert packed 24 bit pixels, with the red, green and blue bytes at
+  rbyte, gbyte and bbyte in each one, into RrPixel32s */
+RR_TARGET_SSSE3
+static gint increase_row24_ssse3(const RrPixel8 *in, RrPixel32 *data, gint w,
+                                 guint rbyte, guint gbyte, guint bbyte)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff << RrDefaultAlphaOffset);
+    gint8 m[16];
+    __m128i mask;
+    gint x, i;
+
+    memset(m, 0x80, sizeof(m));
+    for (i = 0; i < 4; ++i) {
+        m[i * 4 + RrDefaultRedOffset / 8] = i * 3 + rbyte;
+        m[i * 4 + RrDefaultGreenOffset / 8] = i * 3 + gbyte;
+        m[i * 4 + RrDefaultBlueOffset / 8] = i * 3 + bbyte;
+    }
+    mask = _mm_loadu_si128((__m128i*)m);
+
+    /* 16 bytes are read for each 4 pixels, so stop while there are still 2
+       more pixels in the row */
+    for (x = 0; x + 6 <= w; x += 4, in += 12) {
+        __m128i p;
+
+        p = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)in), mask);
+        _mm_storeu_si128((__m128i*)(data + x), _mm_or_si128(p, alpha));
+    }
+    return x;
+}
+
+#endif
+
 void RrIncreaseDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
 {
+    const RrPixelTables *t = RrInstancePixelTables(inst);
     gint r, g, b;
     gint x,y;
     RrPixel32 *p32 = (RrPixel32 *) im->data;
     RrPixel16 *p16 = (RrPixel16 *) im->data;
     guchar *p8 = (guchar *)im->data;
+#ifdef RR_SIMD_X86
+    gboolean simd;
 
-    if (im->byte_order != LSBFirst)
+    simd = RrSimdGetLevel() >= RR_SIMD_SSE2 &&
+        RrRedShift(inst) >= 0 && RrGreenShift(inst) >= 0 &&
+        RrBlueShift(inst) >= 0;
+#endif
+
+    /* 24 bit pixels are read in either byte order below */
+    if (im->byte_order != LSBFirst && im->bits_per_pixel != 24)
         swap_byte_order(im);
 
     switch (im->bits_per_pixel) {
     case 32:
         for (y = 0; y < im->height; y++) {
-            for (x = 0; x < im->width; x++) {
+            x = 0;
+#ifdef RR_SIMD_X86
+            if (simd)
+                x = increase_row32_sse2(inst, p32, data, im->width);
+#endif
+            for (; x < im->width; x++) {
                 r = (p32[x] >> RrRedOffset(inst)) & 0xff;
                 g = (p32[x] >> RrGreenOffset(inst)) & 0xff;
                 b = (p32[x] >> RrBlueOffset(inst)) & 0xff;
@@ -296,23 +507,43 @@ void RrIncreaseDepth(const RrInstance *inst, RrPixel32 *data, XImage *im)
             p32 += im->bytes_per_line/4;
         }
         break;
-    case 16:
+    case 24:
+    {
+        /* where each channel's byte is in a pixel */
+        const guint rbyte = im->byte_order == LSBFirst ?
+            RrRedOffset(inst) / 8 : (16 - RrRedOffset(inst)) / 8;
+        const guint gbyte = im->byte_order == LSBFirst ?
+            RrGreenOffset(inst) / 8 : (16 - RrGreenOffset(inst)) / 8;
+        const guint bbyte = im->byte_order == LSBFirst ?
+            RrBlueOffset(inst) / 8 : (16 - RrBlueOffset(inst)) / 8;
+        gint inx;
+
         for (y = 0; y < im->height; y++) {
-            for (x = 0; x < im->width; x++) {
-                r = (p16[x] & RrRedMask(inst)) >>
-                    RrRedOffset(inst) <<
-                    RrRedShift(inst);
-                g = (p16[x] & RrGreenMask(inst)) >>
-                    RrGreenOffset(inst) <<
-                    RrGreenShift(inst);
-                b = (p16[x] & RrBlueMask(inst)) >>
-                    RrBlueOffset(inst) <<
-                    RrBlueShift(inst);
-                data[x] = (r << RrDefaultRedOffset)
-                    + (g << RrDefaultGreenOffset)
-                    + (b << RrDefaultBlueOffset)
+            x = 0;
+#ifdef RR_SIMD_X86
+            if (simd && RrSimdGetLevel() >= RR_SIMD_SSSE3)
+                x = increase_row24_ssse3(p8, data, im->width,
+                                         rbyte, gbyte, bbyte);
+#endif
+            for (inx = x * 3; x < im->width; x++, inx += 3)
+                data[x] = (p8[inx+rbyte] << RrDefaultRedOffset)
+                    + (p8[inx+gbyte] << RrDefaultGreenOffset)
+                    + (p8[inx+bbyte] << RrDefaultBlueOffset)
                     + (0xff << RrDefaultAlphaOffset);
-            }
+            data += im->width;
+            p8 += im->bytes_per_line;
+        }
+        break;
+    }
+    case 16:
+        for (y = 0; y < im->height; y++) {
+            x = 0;
+#ifdef RR_SIMD_X86
+            if (simd)
+                x = increase_row16_sse2(inst, p16, data, im->width);
+#endif
+            for (; x < im->width; x++)
+                data[x] = t->low[p16[x] & 0xff] | t->high[p16[x] >> 8];
             data += im->width;
             p16 += im->bytes_per_line/2;
         }
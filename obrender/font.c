@@ -31,6 +31,139 @@
 #include <stdlib.h>
 #include <locale.h>
 
+/* the most measured strings kept for each font, this is enough for all the
+   entries of a large menu */
+#define EXTENTS_MAX 1024
+
+typedef struct _RrFontExtents RrFontExtents;
+
+/*! The size of a string laid out in a font */
+struct _RrFontExtents {
+    GString *key;
+    /*! The ink and logical rectangles of the laid out text, in pango units */
+    PangoRectangle ink, logical;
+    /*! The entry's link in the cache's lru queue */
+    GList *link;
+};
+
+/*! Remembers the size of strings measured in a font, so that the same string
+  isn't laid out over and over while sizing popups and menus */
+struct _RrFontCache {
+    /*! Maps a key (GString*) to an RrFontExtents* */
+    GHashTable *table;
+    /*! The entries, most recently used first */
+    GQueue *lru;
+    /*! The entry that the font's layout is set up for, or NULL */
+    RrFontExtents *layout_for;
+};
+
+#define KEY_ADD(k, v) g_string_append_len((k), (const gchar*)&(v), sizeof(v))
+
+static RrFontCache* font_cache_new(void)
+{
+    RrFontCache *c;
+
+    c = g_slice_new(RrFontCache);
+    c->table = g_hash_table_new((GHashFunc)g_string_hash,
+                                (GEqualFunc)g_string_equal);
+    c->lru = g_queue_new();
+    c->layout_for = NULL;
+    return c;
+}
+
+static void extents_free(RrFontExtents *e)
+{
+    g_string_free(e->key, TRUE);
+    g_slice_free(RrFontExtents, e);
+}
+
+static void font_cache_free(RrFontCache *c)
+{
+    RrFontExtents *e;
+
+    while ((e = g_queue_pop_head(c->lru)))
+        extents_free(e);
+    g_queue_free(c->lru);
+    g_hash_table_destroy(c->table);
+    g_slice_free(RrFontCache, c);
+}
+
+static void layout_set(const RrFont *f, const gchar *str, gboolean flow,
+                       gint width, PangoEllipsizeMode ell)
+{
+    pango_layout_set_text(f->layout, str, -1);
+    pango_layout_set_width(f->layout, width);
+    pango_layout_set_ellipsize(f->layout, ell);
+    pango_layout_set_single_paragraph_mode(f->layout, !flow);
+}
+
+/*! Find the extents of a string laid out in the font.  The width is in pango
+  units, or -1 for no limit.  If prepare is TRUE, the font's layout is left set
+  up for the string, ready to draw it. */
+static RrFontExtents* font_extents(const RrFont *f, const gchar *str,
+                                   gboolean flow, gint width,
+                                   PangoEllipsizeMode ell, gboolean prepare)
+{
+    RrFontCache *c = f->cache;
+    RrFontExtents *e;
+    GString *key;
+
+    key = g_string_sized_new(64);
+    KEY_ADD(key, flow);
+    KEY_ADD(key, width);
+    KEY_ADD(key, ell);
+    g_string_append(key, str);
+
+    if ((e = g_hash_table_lookup(c->table, key))) {
+        g_string_free(key, TRUE);
+
+        /* move it to the front of the lru queue */
+        g_queue_unlink(c->lru, e->link);
+        g_queue_push_head_link(c->lru, e->link);
+
+        if (prepare && c->layout_for != e) {
+            layout_set(f, str, flow, width, ell);
+            c->layout_for = e;
+        }
+        return e;
+    }
+
+    e = g_slice_new(RrFontExtents);
+    e->key = key;
+    layout_set(f, str, flow, width, ell);
+    c->layout_for = e;
+    pango_layout_get_extents(f->layout, &e->ink, &e->logical);
+
+    g_queue_push_head(c->lru, e);
+    e->link = g_queue_peek_head_link(c->lru);
+    g_hash_table_insert(c->table, e->key, e);
+
+    if (g_queue_get_length(c->lru) > EXTENTS_MAX) {
+        RrFontExtents *old = g_queue_pop_tail(c->lru);
+
+        g_hash_table_remove(c->table, old->key);
+        if (c->layout_for == old)
+            c->layout_for = NULL;
+        extents_free(old);
+    }
+    return e;
+}
+
+/*! Convert a rectangle from pango units to pixels, the same way as
+  pango_layout_get_pixel_extents */
+static void extents_to_pixels(PangoRectangle *r)
+{
+#if PANGO_VERSION_MAJOR > 1 || \
+    (PANGO_VERSION_MAJOR == 1 && PANGO_VERSION_MINOR >= 16)
+    pango_extents_to_pixels(r, NULL);
+#else
+    r->x = PANGO_PIXELS(r->x);
+    r->y = PANGO_PIXELS(r->y);
+    r->width = PANGO_PIXELS(r->width);
+    r->height = PANGO_PIXELS(r->height);
+#endif
+}
+
 static void measure_font(const RrInstance *inst, RrFont *f)
 {
     PangoFontMetrics *metrics;
@@ -63,6 +196,7 @@ static void measure_font(const RrInstance *inst, RrFont *f)
 RrFont *RrFontOpen(const RrInstance *inst, const gchar *name, gint size,
                    RrFontWeight weight, RrFontSlant slant)
 {
+    static guint next_id = 0;
     RrFont *out;
     PangoWeight pweight;
     PangoStyle pstyle;
@@ -71,6 +205,8 @@ RrFont *RrFontOpen(const RrInstance *inst, const gchar *name, gint size,
     out = g_slice_new(RrFont);
     out->inst = inst;
     out->ref = 1;
+    out->id = ++next_id;
+    out->cache = font_cache_new();
     out->font_desc = pango_font_description_new();
     out->layout = pango_layout_new(inst->pango);
     out->shortcut_underline = pango_attr_underline_new(PANGO_UNDERLINE_LOW);
@@ -132,6 +268,7 @@ void RrFontClose(RrFont *f)
     if (f) {
         if (--f->ref < 1) {
             g_object_unref(f->layout);
+            font_cache_free(f->cache);
             pango_font_description_free(f->font_desc);
             g_slice_free(RrFont, f);
         }
@@ -143,23 +280,18 @@ static void font_measure_full(const RrFont *f, const gchar *str,
                               gboolean flow, gint maxwidth)
 {
     PangoRectangle rect;
+    RrFontExtents *e;
 
-    pango_layout_set_text(f->layout, str, -1);
-    if (flow) {
-        pango_layout_set_single_paragraph_mode(f->layout, FALSE);
-        pango_layout_set_width(f->layout, maxwidth * PANGO_SCALE);
-        pango_layout_set_ellipsize(f->layout, PANGO_ELLIPSIZE_NONE);
-    }
-    else {
+    if (flow)
+        e = font_extents(f, str, TRUE, maxwidth * PANGO_SCALE,
+                         PANGO_ELLIPSIZE_NONE, FALSE);
+    else
         /* single line mode */
-        pango_layout_set_single_paragraph_mode(f->layout, TRUE);
-        pango_layout_set_width(f->layout, -1);
-        pango_layout_set_ellipsize(f->layout, PANGO_ELLIPSIZE_MIDDLE);
-    }
+        e = font_extents(f, str, FALSE, -1, PANGO_ELLIPSIZE_MIDDLE, FALSE);
 
     /* pango_layout_get_pixel_extents lies! this is the right way to get the
        size of the text's area */
-    pango_layout_get_extents(f->layout, NULL, &rect);
+    rect = e->logical;
 #if PANGO_VERSION_MAJOR > 1 || \
     (PANGO_VERSION_MAJOR == 1 && PANGO_VERSION_MINOR >= 16)
     /* pass the logical rect as the ink rect, this is on purpose so we get the
@@ -215,14 +347,17 @@ static inline int font_calculate_baseline(RrFont *f, gint height)
         / PANGO_SCALE; /* back to pixels */
 }
 
-void RrFontDraw(XftDraw *d, RrTextureText *t, RrRect *area)
+/*! Find where the text goes in the area, and set up the font's layout for
+  it if it is going to be drawn.  y is the baseline for text that does not
+  flow. */
+static RrFontExtents* font_layout(RrTextureText *t, RrRect *area,
+                                  gboolean prepare, gint *px, gint *py)
 {
     gint x,y,w;
-    XftColor c;
     gint mw;
     PangoRectangle rect;
-    PangoAttrList *attrlist;
     PangoEllipsizeMode ell;
+    RrFontExtents *e;
 
     g_assert(!t->flow || t->maxwidth > 0);
 
@@ -263,14 +398,13 @@ void RrFontDraw(XftDraw *d, RrTextureText *t, RrRect *area)
         }
     }
 
-    pango_layout_set_text(t->font->layout, t->string, -1);
-    pango_layout_set_width(t->font->layout, w * PANGO_SCALE);
-    pango_layout_set_ellipsize(t->font->layout, ell);
-    pango_layout_set_single_paragraph_mode(t->font->layout, !t->flow);
+    e = font_extents(t->font, t->string, t->flow, w * PANGO_SCALE, ell,
+                     prepare);
 
     /* * * end of setting up the layout * * */
 
-    pango_layout_get_pixel_extents(t->font->layout, NULL, &rect);
+    rect = e->logical;
+    extents_to_pixels(&rect);
     mw = rect.width;
 
     /* pango_layout_set_alignment doesn't work with
@@ -288,6 +422,46 @@ void RrFontDraw(XftDraw *d, RrTextureText *t, RrRect *area)
         g_assert_not_reached();
     }
 
+    *px = x;
+    *py = y;
+    return e;
+}
+
+void RrFontDrawArea(RrTextureText *t, RrRect *area, RrRect *drawn)
+{
+    gint x, y, l, r;
+    PangoRectangle ink, logical;
+    RrFontExtents *e;
+
+    if (t->flow) {
+        /* don't bother, this is only used for single lines of text */
+        *drawn = *area;
+        return;
+    }
+
+    e = font_layout(t, area, FALSE, &x, &y);
+    ink = e->ink;
+    logical = e->logical;
+    extents_to_pixels(&ink);
+    extents_to_pixels(&logical);
+
+    l = x + MIN(ink.x, logical.x);
+    r = x + MAX(ink.x + ink.width, logical.x + logical.width);
+    if (t->shadow_offset_x < 0)
+        l += t->shadow_offset_x;
+    else
+        r += t->shadow_offset_x;
+    RECT_SET(*drawn, l, area->y, r - l, area->height);
+}
+
+void RrFontDraw(XftDraw *d, RrTextureText *t, RrRect *area)
+{
+    gint x,y;
+    XftColor c;
+    PangoAttrList *attrlist;
+
+    font_layout(t, area, TRUE, &x, &y);
+
     if (t->shadow_offset_x || t->shadow_offset_y) {
         /* From nvidia's readme (chapter 23):
 
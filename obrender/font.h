@@ -23,6 +23,8 @@
 #include "geom.h"
 #include <pango/pango.h>
 
+typedef struct _RrFontCache RrFontCache;
+
 struct _RrFont {
     const RrInstance *inst;
     gint ref;
@@ -31,9 +33,14 @@ struct _RrFont {
     PangoAttribute *shortcut_underline; /*< For underlining the shortcut key */
     gint ascent; /*!< The font's ascent in pango-units */
     gint descent; /*!< The font's descent in pango-units */
+    guint id; /*!< Different for every RrFont opened, for use in cache keys */
+    RrFontCache *cache; /*!< The strings which have been measured */
 };
 
 void RrFontDraw(XftDraw *d, RrTextureText *t, RrRect *position);
+/*! Find the part of the area which RrFontDraw will draw the text in.  The
+  drawn area is as tall as the area given. */
+void RrFontDrawArea(RrTextureText *t, RrRect *area, RrRect *drawn);
 
 /*! Increment the references for this font, RrFontClose will decrement until 0
   and then really close it */
@@ -21,11 +21,19 @@
 #include "render.h"
 #include "gradient.h"
 #include "color.h"
+#include "simd.h"
 #include <glib.h>
 #include <string.h>
 
+#ifdef RR_SIMD_X86
+#  include <immintrin.h>
+#endif
+
 static void highlight(RrSurface *s, RrPixel32 *x, RrPixel32 *y,
                       gboolean raised);
+static void highlight_row(RrSurface *s, RrPixel32 *x, RrPixel32 *y, gint n,
+                          gboolean raised);
+static void fill_pixels(RrPixel32 *p, RrPixel32 c, gint n);
 static void gradient_parentrelative(RrAppearance *a, gint w, gint h);
 static void gradient_solid(RrAppearance *l, gint w, gint h);
 static void gradient_splitvertical(RrAppearance *a, gint w, gint h);
@@ -87,9 +95,8 @@ void RrRender(RrAppearance *a, gint w, gint h)
             + (g << RrDefaultGreenOffset)
             + (b << RrDefaultBlueOffset);
         p = data;
-        for (i = 0; i < h; i += 2, p += w)
-            for (x = 0; x < w; ++x, ++p)
-                *p = current;
+        for (i = 0; i < h; i += 2, p += w + w)
+            fill_pixels(p, current, w);
     }
 
     if (a->surface.relief == RR_RELIEF_FLAT && a->surface.border) {
@@ -111,9 +118,7 @@ void RrRender(RrAppearance *a, gint w, gint h)
 
     if (a->surface.relief != RR_RELIEF_FLAT) {
         if (a->surface.bevel == RR_BEVEL_1) {
-            for (off = 1, x = 1; x < w - 1; ++x, off++)
-                highlight(&a->surface, data + off,
-                          data + off + (h-1) * w,
+            highlight_row(&a->surface, data + 1, data + 1 + (h-1) * w, w - 2,
                           a->surface.relief==RR_RELIEF_RAISED);
             for (off = 0, x = 0; x < h; ++x, off++)
                 highlight(&a->surface, data + off * w,
@@ -122,10 +127,8 @@ void RrRender(RrAppearance *a, gint w, gint h)
         }
 
         if (a->surface.bevel == RR_BEVEL_2) {
-            for (off = 2, x = 2; x < w - 2; ++x, off++)
-                highlight(&a->surface, data + off + w,
-                          data + off + (h-2) * w,
-                          a->surface.relief==RR_RELIEF_RAISED);
+            highlight_row(&a->surface, data + 2 + w, data + 2 + (h-2) * w,
+                          w - 4, a->surface.relief==RR_RELIEF_RAISED);
             for (off = 1, x = 1; x < h-1; ++x, off++)
                 highlight(&a->surface, data + off * w + 1,
                           data + off * w + w - 2,
@@ -169,6 +172,115 @@ static void highlight(RrSurface *s, RrPixel32 *x, RrPixel32 *y, gboolean raised)
         + (b << RrDefaultBlueOffset);
 }
 
+#ifdef RR_SIMD_X86
+
+/* these widen the channels to 16 bits, where the products in highlight()
+   can't overflow as long as the adjustments are at most 256 */
+
+RR_TARGET_SSE2
+static gint highlight_row_sse2(RrPixel32 *up, RrPixel32 *down, gint n,
+                               gint light, gint dark)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vlight = _mm_set1_epi16(light);
+    const __m128i vdark = _mm_set1_epi16(dark);
+    const __m128i rgb = _mm_set1_epi32(0xffffff);
+    gint i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i p, lo, hi;
+
+        /* the up and down rows can be the same row, so finish one before
+           reading the other */
+        p = _mm_loadu_si128((__m128i*)(up + i));
+        lo = _mm_unpacklo_epi8(p, zero);
+        hi = _mm_unpackhi_epi8(p, zero);
+        lo = _mm_add_epi16(lo, _mm_srli_epi16(_mm_mullo_epi16(lo, vlight), 8));
+        hi = _mm_add_epi16(hi, _mm_srli_epi16(_mm_mullo_epi16(hi, vlight), 8));
+        p = _mm_and_si128(_mm_packus_epi16(lo, hi), rgb);
+        _mm_storeu_si128((__m128i*)(up + i), p);
+
+        p = _mm_loadu_si128((__m128i*)(down + i));
+        lo = _mm_unpacklo_epi8(p, zero);
+        hi = _mm_unpackhi_epi8(p, zero);
+        lo = _mm_sub_epi16(lo, _mm_srli_epi16(_mm_mullo_epi16(lo, vdark), 8));
+        hi = _mm_sub_epi16(hi, _mm_srli_epi16(_mm_mullo_epi16(hi, vdark), 8));
+        p = _mm_and_si128(_mm_packus_epi16(lo, hi), rgb);
+        _mm_storeu_si128((__m128i*)(down + i), p);
+    }
+    return i;
+}
+
+RR_TARGET_AVX2
+static gint highlight_row_avx2(RrPixel32 *up, RrPixel32 *down, gint n,
+                               gint light, gint dark)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vlight = _mm256_set1_epi16(light);
+    const __m256i vdark = _mm256_set1_epi16(dark);
+    const __m256i rgb = _mm256_set1_epi32(0xffffff);
+    gint i;
+
+    /* the unpacks and the pack work within each 128-bit half, so the pixels
+       come back out in the same order they went in */
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i p, lo, hi;
+
+        p = _mm256_loadu_si256((__m256i*)(up + i));
+        lo = _mm256_unpacklo_epi8(p, zero);
+        hi = _mm256_unpackhi_epi8(p, zero);
+        lo = _mm256_add_epi16(lo, _mm256_srli_epi16(
+                                  _mm256_mullo_epi16(lo, vlight), 8));
+        hi = _mm256_add_epi16(hi, _mm256_srli_epi16(
+                                  _mm256_mullo_epi16(hi, vlight), 8));
+        p = _mm256_and_si256(_mm256_packus_epi16(lo, hi), rgb);
+        _mm256_storeu_si256((__m256i*)(up + i), p);
+
+        p = _mm256_loadu_si256((__m256i*)(down + i));
+        lo = _mm256_unpacklo_epi8(p, zero);
+        hi = _mm256_unpackhi_epi8(p, zero);
+        lo = _mm256_sub_epi16(lo, _mm256_srli_epi16(
+                                  _mm256_mullo_epi16(lo, vdark), 8));
+        hi = _mm256_sub_epi16(hi, _mm256_srli_epi16(
+                                  _mm256_mullo_epi16(hi, vdark), 8));
+        p = _mm256_and_si256(_mm256_packus_epi16(lo, hi), rgb);
+        _mm256_storeu_si256((__m256i*)(down + i), p);
+    }
+    return i;
+}
+
+#endif
+
+/*! Call highlight() for n pixels along a row of the bevel */
+static void highlight_row(RrSurface *s, RrPixel32 *x, RrPixel32 *y, gint n,
+                          gboolean raised)
+{
+    gint i = 0;
+
+#ifdef RR_SIMD_X86
+    if (s->bevel_light_adjust <= 256 && s->bevel_dark_adjust <= 256) {
+        RrPixel32 *up = raised ? x : y, *down = raised ? y : x;
+
+        switch (RrSimdGetLevel()) {
+        case RR_SIMD_AVX2:
+            i = highlight_row_avx2(up, down, n, s->bevel_light_adjust,
+                                   s->bevel_dark_adjust);
+            break;
+        case RR_SIMD_SSE2:
+        case RR_SIMD_SSSE3:
+            i = highlight_row_sse2(up, down, n, s->bevel_light_adjust,
+                                   s->bevel_dark_adjust);
+            break;
+        case RR_SIMD_NONE:
+            break;
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+        highlight(s, x + i, y + i, raised);
+}
+
 static void create_bevel_colors(RrAppearance *l)
 {
     register gint r, g, b;
@@ -197,6 +309,53 @@ static void create_bevel_colors(RrAppearance *l)
     l->surface.bevel_dark = RrColorNew(l->inst, r, g, b);
 }
 
+#ifdef RR_SIMD_X86
+
+RR_TARGET_SSE2
+static void fill_pixels_sse2(RrPixel32 *p, RrPixel32 c, gint n)
+{
+    const __m128i v = _mm_set1_epi32(c);
+
+    for (; n >= 4; n -= 4, p += 4)
+        _mm_storeu_si128((__m128i*)p, v);
+    while (n-- > 0)
+        *(p++) = c;
+}
+
+RR_TARGET_AVX2
+static void fill_pixels_avx2(RrPixel32 *p, RrPixel32 c, gint n)
+{
+    const __m256i v = _mm256_set1_epi32(c);
+
+    for (; n >= 8; n -= 8, p += 8)
+        _mm256_storeu_si256((__m256i*)p, v);
+    while (n-- > 0)
+        *(p++) = c;
+}
+
+#endif
+
+/*! Set n pixels to the color c */
+static void fill_pixels(RrPixel32 *p, RrPixel32 c, gint n)
+{
+    switch (RrSimdGetLevel()) {
+#ifdef RR_SIMD_X86
+    case RR_SIMD_AVX2:
+        fill_pixels_avx2(p, c, n);
+        return;
+    case RR_SIMD_SSE2:
+    case RR_SIMD_SSSE3:
+        fill_pixels_sse2(p, c, n);
+        return;
+#endif
+    default:
+        break;
+    }
+
+    while (n-- > 0)
+        *(p++) = c;
+}
+
 /*! Repeat the first pixel over the entire block of memory
   @param start The block of memory. start[0] will be copied
          to the rest of the block.
@@ -208,6 +367,11 @@ static inline void repeat_pixel(RrPixel32 *start, gint w)
     register gint x;
     RrPixel32 *dest;
 
+    if (RrSimdGetLevel() != RR_SIMD_NONE) {
+        fill_pixels(start + 1, *start, w - 1);
+        return;
+    }
+
     dest = start + 1;
 
     /* for really small things, just copy ourselves */
@@ -274,6 +438,15 @@ static void gradient_parentrelative(RrAppearance *a, gint w, gint h)
     g_assert (a->surface.parent);
     g_assert (a->surface.parent->w);
 
+    /* the parent was painted from the pixmap cache, so render its pixel_data
+       now that it is needed */
+    if (a->surface.parent->pixel_data_stale) {
+        g_assert(a->surface.parent->pixmap == None);
+        RrRender(a->surface.parent, a->surface.parent->w,
+                 a->surface.parent->h);
+        a->surface.parent->pixel_data_stale = FALSE;
+    }
+
     sw = a->surface.parent->w;
     sh = a->surface.parent->h;
 
@@ -319,7 +492,6 @@ static void gradient_parentrelative(RrAppearance *a, gint w, gint h)
 
 static void gradient_solid(RrAppearance *l, gint w, gint h)
 {
-    register gint i;
     RrPixel32 pix;
     RrPixel32 *data = l->surface.pixel_data;
     RrSurface *sp = &l->surface;
@@ -329,10 +501,11 @@ static void gradient_solid(RrAppearance *l, gint w, gint h)
         + (sp->primary->g << RrDefaultGreenOffset)
         + (sp->primary->b << RrDefaultBlueOffset);
 
-    for (i = 0; i < w * h; i++)
-        *data++ = pix;
+    fill_pixels(data, pix, w * h);
 
-    if (sp->interlaced)
+    /* there is no pixmap when only rendering the pixel_data for
+       parentrelative children */
+    if (sp->interlaced || l->pixmap == None)
         return;
 
     XFillRectangle(RrDisplay(l->inst), l->pixmap, RrColorGC(sp->primary),
@@ -491,6 +664,263 @@ static void gradient_solid(RrAppearance *l, gint w, gint h)
     }                                                     \
 }
 
+/* the most pixels done at once by any of the gradient_row kernels */
+#define RAMP_MAX_LANES 8
+
+#ifdef RR_SIMD_X86
+
+/* the SIMD kernels can't follow NEXT's error terms from one pixel to the
+   next, so they use the closed form of it instead.  after k steps of NEXT, a
+   channel with cdelta <= len has moved floor((2k*cdelta + len) / (2*len))
+   steps, and one with cdelta > len has moved
+   ceil((2k-1)*cdelta / (2*len)) steps.
+
+   both are written as floor((A*k + B) / D), and each lane keeps the
+   quotient and remainder for its pixel.  moving a lane ahead by some
+   number of pixels adds A times that to the numerator, which is at most one
+   carry from the remainder into the quotient once it is split the same way.
+*/
+
+typedef struct _RrRamp {
+    gint from[3];
+    /*! -1 for a channel that is decreasing, 0 for one that is increasing */
+    gint neg[3];
+    /*! The quotients and remainders for pixels 1 to lanes */
+    gint q[3][RAMP_MAX_LANES];
+    gint r[3][RAMP_MAX_LANES];
+    /*! The quotient and remainder to add to move a lane ahead */
+    gint dq[3];
+    gint dr[3];
+    /*! The divisor, D */
+    gint den[3];
+} RrRamp;
+
+static void ramp_setup(RrRamp *rp, const RrColor *from, const RrColor *to,
+                       gint len, gint lanes)
+{
+    const gint f[3] = { from->r, from->g, from->b };
+    const gint t[3] = { to->r, to->g, to->b };
+    gint i, j;
+
+    for (i = 0; i < 3; ++i) {
+        gint cdelta, a, b, d;
+
+        cdelta = t[i] - f[i];
+        rp->from[i] = f[i];
+        rp->neg[i] = cdelta < 0 ? -1 : 0;
+        cdelta = ABS(cdelta);
+
+        a = cdelta << 1;
+        d = len << 1;
+        b = cdelta > len ? d - 1 - cdelta : len;
+
+        /* the numerators are all positive from pixel 1 on */
+        for (j = 0; j < lanes; ++j) {
+            rp->q[i][j] = (a * (j + 1) + b) / d;
+            rp->r[i][j] = (a * (j + 1) + b) % d;
+        }
+        rp->dq[i] = a * lanes / d;
+        rp->dr[i] = a * lanes % d;
+        rp->den[i] = d;
+    }
+}
+
+RR_TARGET_SSE2
+static void gradient_row_sse2(RrPixel32 *data, gint n,
+                              const RrColor *from, const RrColor *to)
+{
+    RrRamp rp;
+    __m128i q[3], r[3], dq[3], dr[3], den[3], lim[3], base[3], neg[3];
+    gint i, k;
+
+    ramp_setup(&rp, from, to, n, 4);
+    for (i = 0; i < 3; ++i) {
+        q[i] = _mm_loadu_si128((__m128i*)rp.q[i]);
+        r[i] = _mm_loadu_si128((__m128i*)rp.r[i]);
+        dq[i] = _mm_set1_epi32(rp.dq[i]);
+        dr[i] = _mm_set1_epi32(rp.dr[i]);
+        den[i] = _mm_set1_epi32(rp.den[i]);
+        lim[i] = _mm_set1_epi32(rp.den[i] - 1);
+        base[i] = _mm_set1_epi32(rp.from[i]);
+        neg[i] = _mm_set1_epi32(rp.neg[i]);
+    }
+
+    data[0] = (from->r << RrDefaultRedOffset) +
+        (from->g << RrDefaultGreenOffset) +
+        (from->b << RrDefaultBlueOffset);
+
+    for (k = 1; k < n; k += 4) {
+        __m128i c[3], m, px;
+
+        for (i = 0; i < 3; ++i) {
+            /* from + inc * q, where inc is 1 or -1 */
+            c[i] = _mm_add_epi32(base[i], _mm_sub_epi32(
+                                     _mm_xor_si128(q[i], neg[i]), neg[i]));
+
+            r[i] = _mm_add_epi32(r[i], dr[i]);
+            q[i] = _mm_add_epi32(q[i], dq[i]);
+            m = _mm_cmpgt_epi32(r[i], lim[i]);
+            q[i] = _mm_sub_epi32(q[i], m);
+            r[i] = _mm_sub_epi32(r[i], _mm_and_si128(m, den[i]));
+        }
+        px = _mm_or_si128(_mm_or_si128(
+                              _mm_slli_epi32(c[0], RrDefaultRedOffset),
+                              _mm_slli_epi32(c[1], RrDefaultGreenOffset)),
+                          _mm_slli_epi32(c[2], RrDefaultBlueOffset));
+
+        if (n - k >= 4)
+            _mm_storeu_si128((__m128i*)(data + k), px);
+        else {
+            RrPixel32 last[4];
+
+            _mm_storeu_si128((__m128i*)last, px);
+            memcpy(data + k, last, (n - k) * sizeof(RrPixel32));
+        }
+    }
+}
+
+RR_TARGET_AVX2
+static void gradient_row_avx2(RrPixel32 *data, gint n,
+                              const RrColor *from, const RrColor *to)
+{
+    RrRamp rp;
+    __m256i q[3], r[3], dq[3], dr[3], den[3], lim[3], base[3], neg[3];
+    gint i, k;
+
+    ramp_setup(&rp, from, to, n, 8);
+    for (i = 0; i < 3; ++i) {
+        q[i] = _mm256_loadu_si256((__m256i*)rp.q[i]);
+        r[i] = _mm256_loadu_si256((__m256i*)rp.r[i]);
+        dq[i] = _mm256_set1_epi32(rp.dq[i]);
+        dr[i] = _mm256_set1_epi32(rp.dr[i]);
+        den[i] = _mm256_set1_epi32(rp.den[i]);
+        lim[i] = _mm256_set1_epi32(rp.den[i] - 1);
+        base[i] = _mm256_set1_epi32(rp.from[i]);
+        neg[i] = _mm256_set1_epi32(rp.neg[i]);
+    }
+
+    data[0] = (from->r << RrDefaultRedOffset) +
+        (from->g << RrDefaultGreenOffset) +
+        (from->b << RrDefaultBlueOffset);
+
+    for (k = 1; k < n; k += 8) {
+        __m256i c[3], m, px;
+
+        for (i = 0; i < 3; ++i) {
+            c[i] = _mm256_add_epi32(base[i], _mm256_sub_epi32(
+                                        _mm256_xor_si256(q[i], neg[i]),
+                                        neg[i]));
+
+            r[i] = _mm256_add_epi32(r[i], dr[i]);
+            q[i] = _mm256_add_epi32(q[i], dq[i]);
+            m = _mm256_cmpgt_epi32(r[i], lim[i]);
+            q[i] = _mm256_sub_epi32(q[i], m);
+            r[i] = _mm256_sub_epi32(r[i], _mm256_and_si256(m, den[i]));
+        }
+        px = _mm256_or_si256(_mm256_or_si256(
+                                 _mm256_slli_epi32(c[0], RrDefaultRedOffset),
+                                 _mm256_slli_epi32(c[1],
+                                                   RrDefaultGreenOffset)),
+                             _mm256_slli_epi32(c[2], RrDefaultBlueOffset));
+
+        if (n - k >= 8)
+            _mm256_storeu_si256((__m256i*)(data + k), px);
+        else {
+            RrPixel32 last[8];
+
+            _mm256_storeu_si256((__m256i*)last, px);
+            memcpy(data + k, last, (n - k) * sizeof(RrPixel32));
+        }
+    }
+}
+
+RR_TARGET_SSE2
+static gint mirror_row_sse2(RrPixel32 *data, gint w, gint n)
+{
+    gint x;
+
+    for (x = 0; x + 4 <= n; x += 4) {
+        __m128i p = _mm_loadu_si128((__m128i*)(data + x));
+        p = _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i*)(data + w - x - 4), p);
+    }
+    return x;
+}
+
+RR_TARGET_AVX2
+static gint mirror_row_avx2(RrPixel32 *data, gint w, gint n)
+{
+    const __m256i rev = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    gint x;
+
+    for (x = 0; x + 8 <= n; x += 8) {
+        __m256i p = _mm256_loadu_si256((__m256i*)(data + x));
+        p = _mm256_permutevar8x32_epi32(p, rev);
+        _mm256_storeu_si256((__m256i*)(data + w - x - 8), p);
+    }
+    return x;
+}
+
+#endif
+
+/*! Fill n pixels with the colors from SETUP(x, from, to, n), stepping through
+  them with NEXT(x) */
+static void gradient_row(RrPixel32 *data, gint n,
+                         const RrColor *from, const RrColor *to)
+{
+    register gint x;
+
+    VARS(x);
+
+    /* short rows aren't worth setting up the lanes for */
+    if (n > RAMP_MAX_LANES) {
+        switch (RrSimdGetLevel()) {
+#ifdef RR_SIMD_X86
+        case RR_SIMD_AVX2:
+            gradient_row_avx2(data, n, from, to);
+            return;
+        case RR_SIMD_SSE2:
+        case RR_SIMD_SSSE3:
+            gradient_row_sse2(data, n, from, to);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+
+    SETUP(x, from, to, n);
+    for (x = n - 1; x > 0; --x) {  /* 0 -> n - 1 */
+        *(data++) = COLOR(x);
+        NEXT(x);
+    }
+    *data = COLOR(x);
+}
+
+/*! Copy the first n pixels of a row of width w into the end of the row,
+  reversing their order */
+static void mirror_row(RrPixel32 *data, gint w, gint n)
+{
+    gint x = 0;
+
+    switch (RrSimdGetLevel()) {
+#ifdef RR_SIMD_X86
+    case RR_SIMD_AVX2:
+        x = mirror_row_avx2(data, w, n);
+        break;
+    case RR_SIMD_SSE2:
+    case RR_SIMD_SSSE3:
+        x = mirror_row_sse2(data, w, n);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (; x < n; ++x)
+        data[w - 1 - x] = data[x];
+}
+
 static void gradient_splitvertical(RrAppearance *a, gint w, gint h)
 {
     register gint y1, y2, y3;
@@ -562,22 +992,13 @@ static void gradient_splitvertical(RrAppearance *a, gint w, gint h)
 
 static void gradient_horizontal(RrSurface *sf, gint w, gint h)
 {
-    register gint x, y, cpbytes;
+    register gint y, cpbytes;
     RrPixel32 *data = sf->pixel_data, *datav;
     gchar *datac;
 
-    VARS(x);
-    SETUP(x, sf->primary, sf->secondary, w);
-
     /* set the color values for the first row */
-    datav = data;
-    for (x = w - 1; x > 0; --x) {  /* 0 -> w - 1 */
-        *datav = COLOR(x);
-        ++datav;
-        NEXT(x);
-    }
-    *datav = COLOR(x);
-    ++datav;
+    gradient_row(data, w, sf->primary, sf->secondary);
+    datav = data + w;
 
     /* copy the first row to the rest in O(logn) copies */
     datac = (gchar*)datav;
@@ -594,37 +1015,18 @@ static void gradient_horizontal(RrSurface *sf, gint w, gint h)
 
 static void gradient_mirrorhorizontal(RrSurface *sf, gint w, gint h)
 {
-    register gint x, y, half1, half2, cpbytes;
+    register gint y, half1, half2, cpbytes;
     RrPixel32 *data = sf->pixel_data, *datav;
     gchar *datac;
 
-    VARS(x);
-
     half1 = (w + 1) / 2;
     half2 = w / 2;
 
     /* set the color values for the first row */
-
-    SETUP(x, sf->primary, sf->secondary, half1);
-    datav = data;
-    for (x = half1 - 1; x > 0; --x) {  /* 0 -> half1 - 1 */
-        *datav = COLOR(x);
-        ++datav;
-        NEXT(x);
-    }
-    *datav = COLOR(x);
-    ++datav;
-
-    if (half2 > 0) {
-        SETUP(x, sf->secondary, sf->primary, half2);
-        for (x = half2 - 1; x > 0; --x) {  /* 0 -> half2 - 1 */
-            *datav = COLOR(x);
-            ++datav;
-            NEXT(x);
-        }
-        *datav = COLOR(x);
-        ++datav;
-    }
+    gradient_row(data, half1, sf->primary, sf->secondary);
+    if (half2 > 0)
+        gradient_row(data + half1, half2, sf->secondary, sf->primary);
+    datav = data + w;
 
     /* copy the first row to the rest in O(logn) copies */
     datac = (gchar*)datav;
@@ -667,14 +1069,13 @@ static void gradient_vertical(RrSurface *sf, gint w, gint h)
 
 static void gradient_diagonal(RrSurface *sf, gint w, gint h)
 {
-    register gint x, y;
+    register gint y;
     RrPixel32 *data = sf->pixel_data;
     RrColor left, right;
     RrColor extracorner;
 
     VARS(lefty);
     VARS(righty);
-    VARS(x);
 
     extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
     extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
@@ -687,14 +1088,8 @@ static void gradient_diagonal(RrSurface *sf, gint w, gint h)
         COLOR_RR(lefty, (&left));
         COLOR_RR(righty, (&right));
 
-        SETUP(x, (&left), (&right), w);
-
-        for (x = w - 1; x > 0; --x) {  /* 0 -> w-1 */
-            *(data++) = COLOR(x);
-
-            NEXT(x);
-        }
-        *(data++) = COLOR(x);
+        gradient_row(data, w, &left, &right);
+        data += w;
 
         NEXT(lefty);
         NEXT(righty);
@@ -702,26 +1097,18 @@ static void gradient_diagonal(RrSurface *sf, gint w, gint h)
     COLOR_RR(lefty, (&left));
     COLOR_RR(righty, (&right));
 
-    SETUP(x, (&left), (&right), w);
-
-    for (x = w - 1; x > 0; --x) {  /* 0 -> w-1 */
-        *(data++) = COLOR(x);
-
-        NEXT(x);
-    }
-    *data = COLOR(x);
+    gradient_row(data, w, &left, &right);
 }
 
 static void gradient_crossdiagonal(RrSurface *sf, gint w, gint h)
 {
-    register gint x, y;
+    register gint y;
     RrPixel32 *data = sf->pixel_data;
     RrColor left, right;
     RrColor extracorner;
 
     VARS(lefty);
     VARS(righty);
-    VARS(x);
 
     extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
     extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
@@ -734,14 +1121,8 @@ static void gradient_crossdiagonal(RrSurface *sf, gint w, gint h)
         COLOR_RR(lefty, (&left));
         COLOR_RR(righty, (&right));
 
-        SETUP(x, (&left), (&right), w);
-
-        for (x = w - 1; x > 0; --x) {  /* 0 -> w-1 */
-            *(data++) = COLOR(x);
-
-            NEXT(x);
-        }
-        *(data++) = COLOR(x);
+        gradient_row(data, w, &left, &right);
+        data += w;
 
         NEXT(lefty);
         NEXT(righty);
@@ -749,27 +1130,19 @@ static void gradient_crossdiagonal(RrSurface *sf, gint w, gint h)
     COLOR_RR(lefty, (&left));
     COLOR_RR(righty, (&right));
 
-    SETUP(x, (&left), (&right), w);
-
-    for (x = w - 1; x > 0; --x) {  /* 0 -> w-1 */
-        *(data++) = COLOR(x);
-
-        NEXT(x);
-    }
-    *data = COLOR(x);
+    gradient_row(data, w, &left, &right);
 }
 
 static void gradient_pyramid(RrSurface *sf, gint w, gint h)
 {
-    RrPixel32 *ldata, *rdata;
+    RrPixel32 *ldata;
     RrPixel32 *cp;
     RrColor left, right;
     RrColor extracorner;
-    register gint x, y, halfw, halfh, midx, midy;
+    register gint y, halfw, halfh, midx, midy;
 
     VARS(lefty);
     VARS(righty);
-    VARS(x);
 
     extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
     extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
@@ -785,30 +1158,18 @@ static void gradient_pyramid(RrSurface *sf, gint w, gint h)
 
     /* draw the top half
 
-       it is faster to draw both top quarters together than to draw one and
-       then copy it over to the other side.
+       each row's left quarter is drawn, and then mirrored over to the other
+       side, so that both can be done a block of pixels at a time.
     */
 
     ldata = sf->pixel_data;
-    rdata = ldata + w - 1;
     for (y = halfh + midy; y > 0; --y) {  /* 0 -> (h+1)/2 */
-        RrPixel32 c;
-
         COLOR_RR(lefty, (&left));
         COLOR_RR(righty, (&right));
 
-        SETUP(x, (&left), (&right), halfw + midx);
-
-        for (x = halfw + midx - 1; x > 0; --x) {  /* 0 -> (w+1)/2 */
-            c = COLOR(x);
-            *(ldata++) = *(rdata--) = c;
-
-            NEXT(x);
-        }
-        c = COLOR(x);
-        *ldata = *rdata = c;
-        ldata += halfw + 1;
-        rdata += halfw - 1 + midx + w;
+        gradient_row(ldata, halfw + midx, &left, &right);
+        mirror_row(ldata, w, halfw + midx);
+        ldata += w;
 
         NEXT(lefty);
         NEXT(righty);
@@ -21,6 +21,11 @@
 #include "image.h"
 #include "color.h"
 #include "imagecache.h"
+#include "upload.h"
+#include "simd.h"
+#ifdef XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
 #ifdef USE_IMLIB2
 #include <Imlib2.h>
 #endif
@@ -30,6 +35,10 @@
 
 #include <glib.h>
 
+#ifdef RR_SIMD_X86
+#  include <immintrin.h>
+#endif
+
 #define FRACTION        12
 #define FLOOR(i)        ((i) & (~0UL << FRACTION))
 #define AVERAGE(a, b)   (((((a) ^ (b)) & 0xfefefefeL) >> 1) + ((a) & (b)))
@@ -59,6 +68,9 @@ static void RrImagePicInit(RrImagePic *pic, gint w, gint h, RrPixel32 *data)
     pic->width = w;
     pic->height = h;
     pic->data = data;
+    pic->picture = None;
+    pic->picture_inst = NULL;
+    pic->borrowed = FALSE;
     pic->sum = 0;
     for (i = w*h; i > 0; --i)
         pic->sum += *(data++);
@@ -83,7 +95,12 @@ static RrImagePic* RrImagePicNew(gint w, gint h, RrPixel32 *data)
 static void RrImagePicFree(RrImagePic *pic)
 {
     if (pic) {
-        g_free(pic->data);
+#ifdef XRENDER
+        if (pic->picture != None)
+            XRenderFreePicture(RrDisplay(pic->picture_inst), pic->picture);
+#endif
+        if (!pic->borrowed)
+            g_free(pic->data);
         g_slice_free(RrImagePic, pic);
     }
 }
@@ -128,7 +145,9 @@ static void RrImageSetFree(RrImageSet *self)
            be keys in the cache to RrImageSet objects, so remove them from
            the cache's pic_table as well. */
         for (i = 0; i < self->n_original; ++i) {
-            g_hash_table_remove(self->cache->pic_table, self->original[i]);
+            if (!self->original[i]->borrowed)
+                g_hash_table_remove(self->cache->pic_table,
+                                    self->original[i]);
             RrImagePicFree(self->original[i]);
         }
         g_free(self->original);
@@ -138,6 +157,16 @@ static void RrImageSetFree(RrImageSet *self)
         }
         g_free(self->resized);
 
+        /* the borrowed pictures are gone, so their sources can go too */
+        for (it = self->sources; it; it = g_slist_next(it)) {
+            RrImageSource *src = it->data;
+
+            g_hash_table_remove(self->cache->source_table, src);
+            g_free(src->data);
+            g_slice_free(RrImageSource, src);
+        }
+        g_slist_free(self->sources);
+
         g_slice_free(RrImageSet, self);
     }
 }
@@ -168,7 +197,8 @@ static void RrImageSetRemovePictureAt(RrImageSet *self, gint i,
     g_assert(i >= 0 && i < *len);
 
     /* remove the picture data as a key in the cache */
-    g_hash_table_remove(self->cache->pic_table, (*list)[i]);
+    if (!(*list)[i]->borrowed)
+        g_hash_table_remove(self->cache->pic_table, (*list)[i]);
 
     /* free the picture being removed */
     RrImagePicFree((*list)[i]);
@@ -182,7 +212,8 @@ static void RrImageSetRemovePictureAt(RrImageSet *self, gint i,
 }
 
 /*! Add an RrImagePic to an RrImageSet.
-  The RrImagePic should _not_ exist in the image cache already.
+  The RrImagePic should _not_ exist in the image cache already, unless it is
+  borrowed, as those are not put in the cache.
   Pictures are added to the front of the list, to maintain the ordering of
   newest to oldest.
 */
@@ -194,7 +225,8 @@ static void RrImageSetAddPicture(RrImageSet *self, RrImagePic *pic,
     gint *len;
 
     g_assert(pic->width > 0 && pic->height > 0);
-    g_assert(g_hash_table_lookup(self->cache->pic_table, pic) == NULL);
+    g_assert(pic->borrowed ||
+             g_hash_table_lookup(self->cache->pic_table, pic) == NULL);
 
     /* choose which list in the RrImageSet to add the new picture to. */
     if (original) {
@@ -223,7 +255,8 @@ static void RrImageSetAddPicture(RrImageSet *self, RrImagePic *pic,
     (*list)[0] = pic;
 
     /* add the picture as a key to point to this image in the cache */
-    g_hash_table_insert(self->cache->pic_table, (*list)[0], self);
+    if (!pic->borrowed)
+        g_hash_table_insert(self->cache->pic_table, (*list)[0], self);
 
 /*
 #ifdef DEBUG
@@ -324,8 +357,11 @@ RrImageSet* RrImageSetMergeSets(RrImageSet *b, RrImageSet *a)
 
     for (it = b->names; it; it = g_slist_next(it))
         g_hash_table_insert(a->cache->name_table, it->data, a);
+    for (it = b->sources; it; it = g_slist_next(it))
+        g_hash_table_insert(a->cache->source_table, it->data, a);
     for (b_i = 0; b_i < b->n_original; ++b_i)
-        g_hash_table_insert(a->cache->pic_table, b->original[b_i], a);
+        if (!b->original[b_i]->borrowed)
+            g_hash_table_insert(a->cache->pic_table, b->original[b_i], a);
     for (b_i = 0; b_i < b->n_resized; ++b_i)
         g_hash_table_insert(a->cache->pic_table, b->resized[b_i], a);
 
@@ -336,6 +372,8 @@ RrImageSet* RrImageSetMergeSets(RrImageSet *b, RrImageSet *a)
     b->images = NULL;
     a->names = g_slist_concat(a->names, b->names);
     b->names = NULL;
+    a->sources = g_slist_concat(a->sources, b->sources);
+    b->sources = NULL;
 
     a->n_original = a->n_resized = 0;
     g_free(a->original);
@@ -466,6 +504,78 @@ RrImage* RrImageNewFromData(RrImageCache *cache, RrPixel32 *data,
     return self;
 }
 
+RrImage* RrImageNewFromPacked(RrImageCache *cache, RrPixel32 *data,
+                              gulong len)
+{
+    RrImageSource key, *src;
+    RrImage *self;
+    RrImageSet *set;
+    gulong i, w, h;
+
+    g_return_val_if_fail(cache != NULL, NULL);
+
+    /* an identical buffer has been unpacked already, so use the same
+       RrImageSet and the pictures that were resized from it */
+    key.data = data;
+    key.len = len;
+    set = g_hash_table_lookup(cache->source_table, &key);
+    if (set) {
+        g_free(data);
+        self = set->images->data; /* just grab any RrImage from the list */
+        RrImageRef(self);
+        return self;
+    }
+
+    self = NULL;
+    i = 0;
+    while (i + 2 < len) { /* +2 is to make sure there is a w and h */
+        RrImagePic *pic;
+
+        w = data[i++];
+        h = data[i++];
+        /* watch for zero sized pictures, or for the data being too small for
+           the specified size */
+        if (w == 0 || h == 0)
+            continue;
+        if (h > (len - i) / w)
+            break;
+
+        if (!self) {
+            self = g_slice_new0(RrImage);
+            self->ref = 1;
+            self->set = g_slice_new0(RrImageSet);
+            self->set->cache = cache;
+            self->set->images = g_slist_append(self->set->images, self);
+        }
+
+        /* the picture is not hashed or summed, so its pixels are left alone
+           until it is drawn */
+        pic = g_slice_new(RrImagePic);
+        pic->width = w;
+        pic->height = h;
+        pic->data = &data[i];
+        pic->picture = None;
+        pic->picture_inst = NULL;
+        pic->sum = 0;
+        pic->borrowed = TRUE;
+        RrImageSetAddPicture(self->set, pic, TRUE);
+
+        i += w*h;
+    }
+
+    if (!self) {
+        g_free(data);
+        return NULL;
+    }
+
+    src = g_slice_new(RrImageSource);
+    src->data = data;
+    src->len = len;
+    self->set->sources = g_slist_prepend(self->set->sources, src);
+    g_hash_table_insert(cache->source_table, src, self->set);
+    return self;
+}
+
 #if defined(USE_IMLIB2)
 typedef struct _ImlibLoader ImlibLoader;
 
@@ -693,6 +803,272 @@ RrImage* RrImageNewFromName(RrImageCache *cache, const gchar *name)
  Image drawing and resizing operations.
 **************************************************************************/
 
+/* The resize is a box filter, where each destination pixel is the average of
+   the source pixels under it, weighted by how much of each one it covers.
+   The weights along each axis are found once, and the image is scaled
+   horizontally into a buffer of 16-bit channels, which is then scaled
+   vertically into the destination. */
+
+/*! The extra bits of precision kept for the channels between the passes */
+#define RESIZE_BITS 7
+/* to round to nearest when dropping the fractions after each pass */
+#define ROUND_ROWS    (1 << (FRACTION - RESIZE_BITS - 1))
+#define ROUND_COLUMNS (1 << (FRACTION + RESIZE_BITS - 1))
+
+typedef struct _RrResizeAxis RrResizeAxis;
+
+/*! The weights for scaling along one axis */
+struct _RrResizeAxis {
+    /*! The number of weights for each destination pixel */
+    gint taps;
+    /*! The first source pixel for each destination pixel.  The taps source
+      pixels from here are all inside the source. */
+    gint *first;
+    /*! taps weights for each destination pixel, which add up to
+      1 << FRACTION */
+    gint16 *weights;
+};
+
+static void ResizeAxisInit(RrResizeAxis *ax, gulong srcN, gulong dstN)
+{
+    gulong ratio, s1, s2, s;
+    gulong *portion;
+    gint *count;
+    gulong i, j;
+
+    ratio = MAX((srcN << FRACTION) / dstN, 1);
+
+    /* find how much of each source pixel is covered by each destination
+       pixel, the same way as ResizeImage always has */
+    portion = g_new(gulong, dstN * (ratio / (1UL << FRACTION) + 2));
+    count = g_new(gint, dstN);
+    ax->first = g_new(gint, dstN);
+    ax->taps = 0;
+    s2 = 0;
+    for (i = 0; i < dstN; ++i) {
+        gulong *p = portion + i * (ratio / (1UL << FRACTION) + 2);
+
+        s1 = s2;
+        s2 += ratio;
+        ax->first[i] = s1 >> FRACTION;
+        count[i] = 0;
+        for (s = s1; s < s2; s += (1UL << FRACTION)) {
+            if (s == s1) {
+                s = FLOOR(s);
+                p[count[i]] = (1UL << FRACTION) - (s1 - s);
+                if (p[count[i]] > s2 - s1)
+                    p[count[i]] = s2 - s1;
+            }
+            else if (s == FLOOR(s2))
+                p[count[i]] = s2 - s;
+            else
+                p[count[i]] = (1UL << FRACTION);
+            ++count[i];
+        }
+        ax->taps = MAX(ax->taps, count[i]);
+    }
+
+    /* normalize them so each destination pixel's weights add up to one */
+    ax->weights = g_new0(gint16, dstN * ax->taps);
+    for (i = 0; i < dstN; ++i) {
+        gulong *p = portion + i * (ratio / (1UL << FRACTION) + 2);
+        gint16 *w;
+        gulong sum = 0;
+        gint total = 0, big = 0, shift;
+
+        for (j = 0; j < (gulong)count[i]; ++j)
+            sum += p[j];
+        g_assert(sum != 0);
+
+        /* keep all the taps inside the source, using zero weights for the
+           extra pixels */
+        shift = MAX(ax->first[i] + ax->taps - (gint)srcN, 0);
+        ax->first[i] -= shift;
+        w = ax->weights + i * ax->taps + shift;
+
+        for (j = 0; j < (gulong)count[i]; ++j) {
+            w[j] = ((p[j] << FRACTION) + sum / 2) / sum;
+            total += w[j];
+            if (w[j] > w[big]) big = j;
+        }
+        /* put any rounding error on the biggest weight */
+        w[big] += (1 << FRACTION) - total;
+    }
+
+    g_free(count);
+    g_free(portion);
+}
+
+static void ResizeAxisClear(RrResizeAxis *ax)
+{
+    g_free(ax->first);
+    g_free(ax->weights);
+}
+
+/*! Scale the rows of src horizontally into tmp, which has 4 16-bit channels
+  for each pixel, in the order of their offsets in an RrPixel32.  The channels
+  are kept with RESIZE_BITS bits of fraction. */
+static void ResizeRows(const RrPixel32 *src, gulong srcW, gulong rows,
+                       guint16 *tmp, gulong dstW, const RrResizeAxis *ax)
+{
+    gulong x, y;
+    gint t;
+
+    for (y = 0; y < rows; ++y) {
+        const RrPixel32 *row = src + y * srcW;
+
+        for (x = 0; x < dstW; ++x) {
+            const RrPixel32 *p = row + ax->first[x];
+            const gint16 *w = ax->weights + x * ax->taps;
+            guint32 acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+
+            for (t = 0; t < ax->taps; ++t) {
+                acc0 += (p[t]         & 0xff) * w[t];
+                acc1 += ((p[t] >> 8)  & 0xff) * w[t];
+                acc2 += ((p[t] >> 16) & 0xff) * w[t];
+                acc3 += (p[t] >> 24)          * w[t];
+            }
+            *(tmp++) = (acc0 + ROUND_ROWS) >> (FRACTION - RESIZE_BITS);
+            *(tmp++) = (acc1 + ROUND_ROWS) >> (FRACTION - RESIZE_BITS);
+            *(tmp++) = (acc2 + ROUND_ROWS) >> (FRACTION - RESIZE_BITS);
+            *(tmp++) = (acc3 + ROUND_ROWS) >> (FRACTION - RESIZE_BITS);
+        }
+    }
+}
+
+/*! Scale one column of tmp, which is w pixels wide, vertically into a
+  single pixel */
+static inline RrPixel32 ResizeColumnPixel(const guint16 *col, gulong w,
+                                          const gint16 *wt, gint taps)
+{
+    guint32 acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    gint t;
+
+    for (t = 0; t < taps; ++t, col += w * 4) {
+        acc0 += col[0] * wt[t];
+        acc1 += col[1] * wt[t];
+        acc2 += col[2] * wt[t];
+        acc3 += col[3] * wt[t];
+    }
+    return ((acc0 + ROUND_COLUMNS) >> (FRACTION + RESIZE_BITS)) |
+        (((acc1 + ROUND_COLUMNS) >> (FRACTION + RESIZE_BITS)) << 8) |
+        (((acc2 + ROUND_COLUMNS) >> (FRACTION + RESIZE_BITS)) << 16) |
+        (((acc3 + ROUND_COLUMNS) >> (FRACTION + RESIZE_BITS)) << 24);
+}
+
+/*! Scale the columns of tmp vertically into dst */
+static void ResizeColumns(const guint16 *tmp, gulong w, RrPixel32 *dst,
+                          gulong dstH, const RrResizeAxis *ax)
+{
+    gulong x, y;
+
+    for (y = 0; y < dstH; ++y) {
+        const guint16 *col = tmp + ax->first[y] * w * 4;
+        const gint16 *wt = ax->weights + y * ax->taps;
+
+        for (x = 0; x < w; ++x, col += 4)
+            *(dst++) = ResizeColumnPixel(col, w, wt, ax->taps);
+    }
+}
+
+#ifdef RR_SIMD_X86
+
+/* these do the same arithmetic as the scalar passes, two taps at a time.
+   the channels are read in memory order, which matches their offsets in the
+   RrPixel32 on x86. */
+
+RR_TARGET_SSE2
+static void ResizeRowsSSE2(const RrPixel32 *src, gulong srcW, gulong rows,
+                           guint16 *tmp, gulong dstW, const RrResizeAxis *ax)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(ROUND_ROWS);
+    gulong x, y;
+    gint t;
+
+    for (y = 0; y < rows; ++y) {
+        const RrPixel32 *row = src + y * srcW;
+
+        for (x = 0; x < dstW; ++x) {
+            const RrPixel32 *p = row + ax->first[x];
+            const gint16 *w = ax->weights + x * ax->taps;
+            __m128i acc = round;
+
+            for (t = 0; t < ax->taps; t += 2) {
+                __m128i p0, p1, wt;
+                guint16 w1;
+
+                p0 = _mm_cvtsi32_si128(p[t]);
+                /* an odd tap is paired with itself with a zero weight */
+                if (t + 1 < ax->taps) {
+                    p1 = _mm_cvtsi32_si128(p[t + 1]);
+                    w1 = w[t + 1];
+                }
+                else {
+                    p1 = p0;
+                    w1 = 0;
+                }
+                /* b0 b1 g0 g1 r0 r1 a0 a1, as 16-bit values */
+                p0 = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+                wt = _mm_set1_epi32(((guint32)w1 << 16) | (guint16)w[t]);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(p0, wt));
+            }
+            acc = _mm_srli_epi32(acc, FRACTION - RESIZE_BITS);
+            _mm_storel_epi64((__m128i*)tmp, _mm_packs_epi32(acc, acc));
+            tmp += 4;
+        }
+    }
+}
+
+RR_TARGET_SSE2
+static void ResizeColumnsSSE2(const guint16 *tmp, gulong w, RrPixel32 *dst,
+                              gulong dstH, const RrResizeAxis *ax)
+{
+    const __m128i round = _mm_set1_epi32(ROUND_COLUMNS);
+    gulong x, y;
+    gint t;
+
+    for (y = 0; y < dstH; ++y) {
+        const guint16 *col = tmp + ax->first[y] * w * 4;
+        const gint16 *wt = ax->weights + y * ax->taps;
+
+        /* two pixels at a time */
+        for (x = 0; x + 2 <= w; x += 2, col += 8) {
+            __m128i lo = round, hi = round;
+
+            for (t = 0; t < ax->taps; t += 2) {
+                __m128i r0, r1, wp;
+                guint16 w1;
+
+                r0 = _mm_loadu_si128((__m128i*)(col + t * w * 4));
+                if (t + 1 < ax->taps) {
+                    r1 = _mm_loadu_si128((__m128i*)(col + (t + 1) * w * 4));
+                    w1 = wt[t + 1];
+                }
+                else {
+                    r1 = r0;
+                    w1 = 0;
+                }
+                wp = _mm_set1_epi32(((guint32)w1 << 16) | (guint16)wt[t]);
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(
+                                       _mm_unpacklo_epi16(r0, r1), wp));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(
+                                       _mm_unpackhi_epi16(r0, r1), wp));
+            }
+            lo = _mm_srli_epi32(lo, FRACTION + RESIZE_BITS);
+            hi = _mm_srli_epi32(hi, FRACTION + RESIZE_BITS);
+            lo = _mm_packs_epi32(lo, hi);
+            _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(lo, lo));
+            dst += 2;
+        }
+        /* the last pixel of an odd width row */
+        if (x < w)
+            *(dst++) = ResizeColumnPixel(col, w, wt, ax->taps);
+    }
+}
+
+#endif
+
 /*! Given a picture in RGBA format, of a specified size, resize it to the new
   requested size (but keep its aspect ratio).  If the image does not need to
   be resized (it is already the right size) then this returns NULL.  Otherwise
@@ -704,11 +1080,10 @@ static RrImagePic* ResizeImage(RrPixel32 *src,
                                gulong srcW, gulong srcH,
                                gulong dstW, gulong dstH)
 {
-    RrPixel32 *dst, *dststart;
+    RrPixel32 *dst;
     RrImagePic *pic;
-    gulong dstX, dstY, srcX, srcY;
-    gulong srcX1, srcX2, srcY1, srcY2;
-    gulong ratioX, ratioY;
+    RrResizeAxis ax, ay;
+    guint16 *tmp;
     gulong aspectW, aspectH;
 
     g_assert(srcW > 0);
@@ -729,80 +1104,30 @@ static RrImagePic* ResizeImage(RrPixel32 *src,
     if (srcW == dstW && srcH == dstH)
         return NULL; /* no scaling needed! */
 
-    dststart = dst = g_new(RrPixel32, dstW * dstH);
-
-    ratioX = (srcW << FRACTION) / dstW;
-    ratioY = (srcH << FRACTION) / dstH;
-
-    srcY2 = 0;
-    for (dstY = 0; dstY < dstH; dstY++) {
-        srcY1 = srcY2;
-        srcY2 += ratioY;
+    dst = g_new(RrPixel32, dstW * dstH);
+    tmp = g_new(guint16, srcH * dstW * 4);
 
-        srcX2 = 0;
-        for (dstX = 0; dstX < dstW; dstX++) {
-            gulong red = 0, green = 0, blue = 0, alpha = 0;
-            gulong portionX, portionY, portionXY, sumXY = 0;
-            RrPixel32 pixel;
+    ResizeAxisInit(&ax, srcW, dstW);
+    ResizeAxisInit(&ay, srcH, dstH);
 
-            srcX1 = srcX2;
-            srcX2 += ratioX;
-
-            for (srcY = srcY1; srcY < srcY2; srcY += (1UL << FRACTION)) {
-                if (srcY == srcY1) {
-                    srcY = FLOOR(srcY);
-                    portionY = (1UL << FRACTION) - (srcY1 - srcY);
-                    if (portionY > srcY2 - srcY1)
-                        portionY = srcY2 - srcY1;
-                }
-                else if (srcY == FLOOR(srcY2))
-                    portionY = srcY2 - srcY;
-                else
-                    portionY = (1UL << FRACTION);
-
-                for (srcX = srcX1; srcX < srcX2; srcX += (1UL << FRACTION)) {
-                    if (srcX == srcX1) {
-                        srcX = FLOOR(srcX);
-                        portionX = (1UL << FRACTION) - (srcX1 - srcX);
-                        if (portionX > srcX2 - srcX1)
-                            portionX = srcX2 - srcX1;
-                    }
-                    else if (srcX == FLOOR(srcX2))
-                        portionX = srcX2 - srcX;
-                    else
-                        portionX = (1UL << FRACTION);
-
-                    portionXY = (portionX * portionY) >> FRACTION;
-                    sumXY += portionXY;
-
-                    pixel = *(src + (srcY >> FRACTION) * srcW
-                            + (srcX >> FRACTION));
-                    red   += ((pixel >> RrDefaultRedOffset)   & 0xFF)
-                             * portionXY;
-                    green += ((pixel >> RrDefaultGreenOffset) & 0xFF)
-                             * portionXY;
-                    blue  += ((pixel >> RrDefaultBlueOffset)  & 0xFF)
-                             * portionXY;
-                    alpha += ((pixel >> RrDefaultAlphaOffset) & 0xFF)
-                             * portionXY;
-                }
-            }
-
-            g_assert(sumXY != 0);
-            red   /= sumXY;
-            green /= sumXY;
-            blue  /= sumXY;
-            alpha /= sumXY;
-
-            *dst++ = (red   << RrDefaultRedOffset)   |
-                     (green << RrDefaultGreenOffset) |
-                     (blue  << RrDefaultBlueOffset)  |
-                     (alpha << RrDefaultAlphaOffset);
-        }
+#ifdef RR_SIMD_X86
+    if (RrSimdGetLevel() >= RR_SIMD_SSE2) {
+        ResizeRowsSSE2(src, srcW, srcH, tmp, dstW, &ax);
+        ResizeColumnsSSE2(tmp, dstW, dst, dstH, &ay);
     }
+    else
+#endif
+    {
+        ResizeRows(src, srcW, srcH, tmp, dstW, &ax);
+        ResizeColumns(tmp, dstW, dst, dstH, &ay);
+    }
+
+    ResizeAxisClear(&ax);
+    ResizeAxisClear(&ay);
+    g_free(tmp);
 
     pic = g_slice_new(RrImagePic);
-    RrImagePicInit(pic, dstW, dstH, dststart);
+    RrImagePicInit(pic, dstW, dstH, dst);
 
     return pic;
 }
@@ -894,25 +1219,25 @@ void RrImageDrawRGBA(RrPixel32 *target, RrTextureRGBA *rgba,
                  rgba->alpha, area);
 }
 
-/*! Draw an RrImage texture into a target pixel buffer.  If the RrImage does
-  not contain a picture of the appropriate size, then one of its "original"
-  pictures will be resized and used (and stored in the RrImage as a "resized"
-  picture).
+/*! Find the picture in an RrImage texture to draw in the given area.  If the
+  RrImage does not contain a picture of the appropriate size, then one of its
+  "original" pictures will be resized and used (and stored in the RrImage as a
+  "resized" picture).
+  @param free_pic Set to TRUE if the returned picture was not saved in the
+    RrImage, and must be freed with RrImagePicFree by the caller.
  */
-void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
-                      gint target_w, gint target_h,
-                      RrRect *area)
+static RrImagePic* RrImagePickPicture(RrTextureImage *img, RrRect *area,
+                                      gboolean *free_pic)
 {
     gint i, min_diff, min_i, min_aspect_diff, min_aspect_i;
     RrImage *self;
     RrImageSet *set;
     RrImagePic *pic;
-    gboolean free_pic;
 
     self = img->image;
     set = self->set;
     pic = NULL;
-    free_pic = FALSE;
+    *free_pic = FALSE;
 
     /* is there an original of this size? (only the larger of
        w or h has to be right cuz we maintain aspect ratios) */
@@ -1004,7 +1329,7 @@ void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
                apparently the same image !  then next time we won't have to do
                this resizing, we will use the cache_set's pic instead. */
             set = RrImageSetMergeSets(set, cache_set);
-            free_pic = TRUE;
+            *free_pic = TRUE;
         }
         else {
             /* add the resized image to the image, as the first in the resized
@@ -1017,7 +1342,7 @@ void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
                 /* add it to the resized list */
                 RrImageSetAddPicture(set, pic, FALSE);
             else
-                free_pic = TRUE; /* don't leak mem! */
+                *free_pic = TRUE; /* don't leak mem! */
         }
     }
 
@@ -1026,10 +1351,109 @@ void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
     self->set = set;
 
     g_assert(pic != NULL);
+    return pic;
+}
 
+/*! Draw an RrImage texture into a target pixel buffer. */
+void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
+                      gint target_w, gint target_h,
+                      RrRect *area)
+{
+    RrImagePic *pic;
+    gboolean free_pic;
+
+    pic = RrImagePickPicture(img, area, &free_pic);
     DrawRGBA(target, target_w, target_h,
              pic->data, pic->width, pic->height,
              img->alpha, area);
     if (free_pic)
         RrImagePicFree(pic);
 }
+
+#ifdef XRENDER
+/*! Make a copy of the picture on the X server with premultiplied alpha, as
+  the Render extension expects */
+static Picture RrImagePicUpload(const RrInstance *inst, RrImagePic *pic)
+{
+    Display *d = RrDisplay(inst);
+    RrPixel32 *data, *p, *s;
+    Pixmap pixmap;
+    Picture picture;
+    XRenderPictFormat *format;
+    gint num_pixels;
+
+    p = data = g_new(RrPixel32, pic->width * pic->height);
+    s = pic->data;
+    for (num_pixels = pic->width * pic->height; num_pixels > 0; --num_pixels) {
+        guint a, r, g, b;
+
+        a = (*s >> RrDefaultAlphaOffset) & 0xff;
+        r = (((*s >> RrDefaultRedOffset) & 0xff) * a + 127) / 255;
+        g = (((*s >> RrDefaultGreenOffset) & 0xff) * a + 127) / 255;
+        b = (((*s >> RrDefaultBlueOffset) & 0xff) * a + 127) / 255;
+        *p++ = (a << 24) | (r << 16) | (g << 8) | b;
+        s++;
+    }
+
+    pixmap = XCreatePixmap(d, RrRootWindow(inst), pic->width, pic->height, 32);
+    RrUploadImage32(inst, pixmap, data, pic->width, pic->height);
+    g_free(data);
+
+    format = XRenderFindStandardFormat(d, PictStandardARGB32);
+    picture = XRenderCreatePicture(d, pixmap, format, 0, NULL);
+    /* the picture holds onto the pixmap */
+    XFreePixmap(d, pixmap);
+    return picture;
+}
+
+/*! Composite an RrImage texture onto a pixmap with the Render extension.  The
+  picture is placed the same way as with RrImageDrawImage, and is uploaded to
+  the X server only the first time it is drawn. */
+void RrImageRenderImage(const RrInstance *inst, Pixmap target,
+                        RrTextureImage *img, RrRect *area)
+{
+    Display *d = RrDisplay(inst);
+    RrImagePic *pic;
+    gboolean free_pic;
+    Picture dest, mask;
+    gint dw, dh;
+
+    pic = RrImagePickPicture(img, area, &free_pic);
+    if (pic->picture == None) {
+        pic->picture = RrImagePicUpload(inst, pic);
+        pic->picture_inst = inst;
+    }
+
+    /* keep the aspect ratio, and center it, like DrawRGBA does */
+    dw = area->width;
+    dh = (gint)(dw * ((gdouble)pic->height / pic->width));
+    if (dh > area->height) {
+        dh = area->height;
+        dw = (gint)(dh * ((gdouble)pic->width / pic->height));
+    }
+
+    mask = None;
+    if (img->alpha < 0xff) {
+        XRenderColor c;
+
+        c.red = c.green = c.blue = 0;
+        c.alpha = img->alpha * 0x101;
+        mask = XRenderCreateSolidFill(d, &c);
+    }
+
+    dest = XRenderCreatePicture(d, target,
+                                XRenderFindVisualFormat(d, RrVisual(inst)),
+                                0, NULL);
+    XRenderComposite(d, PictOpOver, pic->picture, mask, dest,
+                     0, 0, 0, 0,
+                     area->x + (area->width - dw) / 2,
+                     area->y + (area->height - dh) / 2,
+                     pic->width, pic->height);
+    XRenderFreePicture(d, dest);
+    if (mask != None)
+        XRenderFreePicture(d, mask);
+
+    if (free_pic)
+        RrImagePicFree(pic);
+}
+#endif
@@ -25,6 +25,10 @@
 void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
                       gint target_w, gint target_h,
                       RrRect *area);
+#ifdef XRENDER
+void RrImageRenderImage(const RrInstance *inst, Pixmap target,
+                        RrTextureImage *img, RrRect *area);
+#endif
 void RrImageDrawRGBA(RrPixel32 *target, RrTextureRGBA *rgba,
                      gint target_w, gint target_h,
                      RrRect *area);
@@ -20,8 +20,14 @@
 #include "imagecache.h"
 #include "image.h"
 
+#ifdef HAVE_STRING_H
+#  include <string.h>
+#endif
+
 static gboolean RrImagePicEqual(const RrImagePic *p1,
                                 const RrImagePic *p2);
+static gboolean RrImageSourceEqual(const RrImageSource *s1,
+                                   const RrImageSource *s2);
 
 RrImageCache* RrImageCacheNew(gint max_resized_saved)
 {
@@ -35,6 +41,8 @@ RrImageCache* RrImageCacheNew(gint max_resized_saved)
     self->pic_table = g_hash_table_new((GHashFunc)RrImagePicHash,
                                        (GEqualFunc)RrImagePicEqual);
     self->name_table = g_hash_table_new(g_str_hash, g_str_equal);
+    self->source_table = g_hash_table_new((GHashFunc)RrImageSourceHash,
+                                          (GEqualFunc)RrImageSourceEqual);
     return self;
 }
 
@@ -54,6 +62,10 @@ void RrImageCacheUnref(RrImageCache *self)
         g_hash_table_destroy(self->name_table);
         self->name_table = NULL;
 
+        g_assert(g_hash_table_size(self->source_table) == 0);
+        g_hash_table_destroy(self->source_table);
+        self->source_table = NULL;
+
         g_slice_free(RrImageCache, self);
     }
 }
@@ -138,3 +150,48 @@ static gboolean RrImagePicEqual(const RrImagePic *p1,
     return p1->width == p2->width && p1->height == p2->height &&
         p1->sum == p2->sum;
 }
+
+/*! The most picture sizes from a buffer of packed pictures that go into its
+  hash */
+#define SOURCE_HASH_SIZES 16
+/*! How many values from across a buffer of packed pictures go into its
+  hash */
+#define SOURCE_HASH_SAMPLES 32
+
+guint RrImageSourceHash(const RrImageSource *s)
+{
+    guint32 key[1 + SOURCE_HASH_SIZES * 2 + SOURCE_HASH_SAMPLES];
+    gulong i, w, h;
+    gint n, j;
+
+    /* hash the sizes of the pictures, and a few values from across the
+       buffer, so that looking a buffer up doesn't read all of its pixels */
+    n = 0;
+    key[n++] = s->len;
+    i = 0;
+    for (j = 0; j < SOURCE_HASH_SIZES && i + 2 < s->len; ++j) {
+        w = s->data[i++];
+        h = s->data[i++];
+        key[n++] = w;
+        key[n++] = h;
+        if (w == 0 || h == 0)
+            continue;
+        if (h > (s->len - i) / w)
+            break;
+        i += w * h;
+    }
+    for (j = 0; j < SOURCE_HASH_SAMPLES && s->len; ++j)
+        key[n++] = s->data[(guint64)(s->len - 1) * j /
+                           (SOURCE_HASH_SAMPLES - 1)];
+
+    return hashword(key, n, HASH_INITVAL);
+}
+
+/*! Only called for buffers with the same hash, which are very likely to be
+  the same buffer, so the whole buffer is read only when it can be shared */
+static gboolean RrImageSourceEqual(const RrImageSource *s1,
+                                   const RrImageSource *s2)
+{
+    return s1->len == s2->len &&
+        !memcmp(s1->data, s2->data, s1->len * sizeof(RrPixel32));
+}
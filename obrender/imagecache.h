@@ -23,7 +23,17 @@
 
 struct _RrImagePic;
 
+typedef struct _RrImageSource RrImageSource;
+
+/*! A buffer of packed pictures, which an RrImageSet was made from */
+struct _RrImageSource {
+    RrPixel32 *data;
+    /*! The number of values in data */
+    gulong len;
+};
+
 guint RrImagePicHash(const struct _RrImagePic *p);
+guint RrImageSourceHash(const RrImageSource *s);
 
 /*! Create a new image cache.  An image cache is basically a hash table to look
   up RrImages.  Each RrImage in the cache may contain one or more Pictures,
@@ -53,6 +63,11 @@ struct _RrImageCache {
     /*! Used to find out if an image file has already been loaded into an
       image set. Provides a quick file_name -> RrImageSet lookup. */
     GHashTable *name_table;
+
+    /*! Used to find out if a buffer of packed pictures has already been
+      unpacked into an image set.  Provides a quick RrImageSource ->
+      RrImageSet lookup. */
+    GHashTable *source_table;
 };
 
 #endif
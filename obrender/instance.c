@@ -19,10 +19,20 @@
 
 #include "render.h"
 #include "instance.h"
+#include "upload.h"
+#include "pixmapcache.h"
+
+#ifdef XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+
+/* the most memory used by pixmaps in the pixmap cache */
+#define PIXMAP_CACHE_BUDGET (16 * 1024 * 1024)
 
 static RrInstance *definst = NULL;
 
 static void RrTrueColorSetup (RrInstance *inst);
+static void RrTrueColorTables (RrInstance *inst);
 static void RrPseudoColorSetup (RrInstance *inst);
 
 #ifdef DEBUG
@@ -86,6 +96,20 @@ RrInstance* RrInstanceNew (Display *display, gint screen)
         g_free (definst);
         return definst = NULL;
     }
+
+    definst->xrender = FALSE;
+#ifdef XRENDER
+    {
+        gint event_base, error_base;
+
+        definst->xrender =
+            XRenderQueryExtension(display, &event_base, &error_base) &&
+            XRenderFindVisualFormat(display, definst->visual) != NULL;
+    }
+#endif
+
+    definst->upload = RrUploaderNew(definst);
+    definst->pixmap_cache = RrPixmapCacheNew(PIXMAP_CACHE_BUDGET);
     return definst;
 }
 
@@ -115,6 +139,43 @@ static void RrTrueColorSetup (RrInstance *inst)
   while (green_mask) { green_mask >>= 1; inst->green_shift--; }
   while (blue_mask)  { blue_mask  >>= 1; inst->blue_shift--;  }
   XFree(timage);
+
+  RrTrueColorTables(inst);
+}
+
+static void RrTrueColorTables (RrInstance *inst)
+{
+    RrPixelTables *t = &inst->tables;
+    guint32 v, r, g, b;
+
+    /* channels wider than 8 bits have a negative shift */
+#define NARROW(v, shift) ((shift) >= 0 ? (v) >> (shift) : (v) << -(shift))
+    for (v = 0; v < 256; ++v) {
+        t->red[v] = NARROW(v, inst->red_shift) << inst->red_offset;
+        t->green[v] = NARROW(v, inst->green_shift) << inst->green_offset;
+        t->blue[v] = NARROW(v, inst->blue_shift) << inst->blue_offset;
+    }
+#undef NARROW
+
+    /* each bit of a 16-bit pixel lands in at most one bit of the RrPixel32,
+       so the two bytes can be looked up separately */
+    if (inst->depth > 16) return;
+    for (v = 0; v < 256; ++v) {
+        r = (v & inst->red_mask) >> inst->red_offset << inst->red_shift;
+        g = (v & inst->green_mask) >> inst->green_offset << inst->green_shift;
+        b = (v & inst->blue_mask) >> inst->blue_offset << inst->blue_shift;
+        t->low[v] = (r << RrDefaultRedOffset) + (g << RrDefaultGreenOffset) +
+            (b << RrDefaultBlueOffset) + (0xff << RrDefaultAlphaOffset);
+
+        r = ((v << 8) & inst->red_mask) >> inst->red_offset
+            << inst->red_shift;
+        g = ((v << 8) & inst->green_mask) >> inst->green_offset
+            << inst->green_shift;
+        b = ((v << 8) & inst->blue_mask) >> inst->blue_offset
+            << inst->blue_shift;
+        t->high[v] = (r << RrDefaultRedOffset) + (g << RrDefaultGreenOffset) +
+            (b << RrDefaultBlueOffset);
+    }
 }
 
 #define RrPseudoNcolors(inst) (1 << (inst->pseudo_bpc * 3))
@@ -141,6 +202,17 @@ static void RrPseudoColorSetup (RrInstance *inst)
     inst->pseudo_colors = g_new(XColor, _ncolors);
     cpc = 1 << inst->pseudo_bpc; /* colors per channel */
 
+    /* the parts of the index into the cube for each channel, the same as
+       RrPickColor finds */
+    for (i = 0; i < 256; ++i) {
+        inst->tables.red[i] = (i >> (8 - inst->pseudo_bpc))
+            << (2 * inst->pseudo_bpc);
+        inst->tables.green[i] = (i >> (8 - inst->pseudo_bpc))
+            << inst->pseudo_bpc;
+        inst->tables.blue[i] = i >> (8 - inst->pseudo_bpc);
+        inst->tables.low[i] = inst->tables.high[i] = 0;
+    }
+
     for (n = 0, r = 0; r < cpc; r++)
         for (g = 0; g < cpc; g++)
             for (b = 0; b < cpc; b++, n++) {
@@ -209,6 +281,8 @@ void RrInstanceFree (RrInstance *inst)
 {
     if (inst) {
         if (inst == definst) definst = NULL;
+        RrPixmapCacheFree(inst->pixmap_cache, inst->display);
+        RrUploaderFree(inst->upload, inst);
         g_free(inst->pseudo_colors);
         g_hash_table_destroy(inst->color_hash);
         g_object_unref(inst->pango);
@@ -305,3 +379,23 @@ GHashTable* RrColorHash (const RrInstance *inst)
 {
     return (inst ? inst : definst)->color_hash;
 }
+
+gboolean RrHasXRender (const RrInstance *inst)
+{
+    return (inst ? inst : definst)->xrender;
+}
+
+RrUploader* RrInstanceUploader (const RrInstance *inst)
+{
+    return (inst ? inst : definst)->upload;
+}
+
+RrPixmapCache* RrInstancePixmapCache (const RrInstance *inst)
+{
+    return (inst ? inst : definst)->pixmap_cache;
+}
+
+const RrPixelTables* RrInstancePixelTables (const RrInstance *inst)
+{
+    return &(inst ? inst : definst)->tables;
+}
@@ -23,6 +23,26 @@
 #include <glib.h>
 #include <pango/pangoxft.h>
 
+struct _RrUploader;
+struct _RrPixmapCache;
+
+typedef struct _RrPixelTables RrPixelTables;
+
+/*! Lookup tables for converting between RrPixel32s and the visual's pixels,
+  built when the instance is created */
+struct _RrPixelTables {
+    /*! For TrueColor visuals, each 8-bit channel value's bits in a pixel of
+      the visual.  For other visuals, its part of the index into the
+      instance's pseudo_colors. */
+    guint32 red[256];
+    guint32 green[256];
+    guint32 blue[256];
+    /*! The RrPixel32 for the low and the high byte of a 16-bit TrueColor
+      pixel, which are or'd together.  The alpha is included in low. */
+    guint32 low[256];
+    guint32 high[256];
+};
+
 struct _RrInstance {
     Display *display;
     gint screen;
@@ -47,11 +67,23 @@ struct _RrInstance {
     gint pseudo_bpc;
     XColor *pseudo_colors;
 
+    RrPixelTables tables;
+
     GHashTable *color_hash;
+
+    /*! TRUE if images can be composited with the Render extension */
+    gboolean xrender;
+
+    struct _RrUploader *upload;
+    struct _RrPixmapCache *pixmap_cache;
 };
 
 guint       RrPseudoBPC    (const RrInstance *inst);
 XColor*     RrPseudoColors (const RrInstance *inst);
 GHashTable* RrColorHash    (const RrInstance *inst);
+gboolean    RrHasXRender   (const RrInstance *inst);
+struct _RrUploader* RrInstanceUploader (const RrInstance *inst);
+struct _RrPixmapCache* RrInstancePixmapCache (const RrInstance *inst);
+const RrPixelTables* RrInstancePixelTables (const RrInstance *inst);
 
 #endif
@@ -0,0 +1,235 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   pixmapcache.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "pixmapcache.h"
+#include "color.h"
+#include "font.h"
+
+#ifdef HAVE_STRING_H
+#  include <string.h>
+#endif
+
+typedef struct _RrPixmapCacheEntry RrPixmapCacheEntry;
+
+struct _RrPixmapCacheEntry {
+    GString *key;
+    Pixmap pixmap;
+    gulong bytes;
+    /*! The entry's link in the cache's lru queue */
+    GList *link;
+};
+
+#define KEY_ADD(k, v) g_string_append_len((k), (const gchar*)&(v), sizeof(v))
+
+static void entry_free(RrPixmapCacheEntry *e, Display *d)
+{
+    XFreePixmap(d, e->pixmap);
+    g_string_free(e->key, TRUE);
+    g_slice_free(RrPixmapCacheEntry, e);
+}
+
+RrPixmapCache* RrPixmapCacheNew(gulong budget)
+{
+    RrPixmapCache *self;
+
+    self = g_slice_new(RrPixmapCache);
+    self->table = g_hash_table_new((GHashFunc)g_string_hash,
+                                   (GEqualFunc)g_string_equal);
+    self->lru = g_queue_new();
+    self->bytes = 0;
+    self->budget = budget;
+    return self;
+}
+
+void RrPixmapCacheFree(RrPixmapCache *self, Display *d)
+{
+    if (self) {
+        RrPixmapCacheEntry *e;
+
+        while ((e = g_queue_pop_head(self->lru)))
+            entry_free(e, d);
+        g_queue_free(self->lru);
+        g_hash_table_destroy(self->table);
+        g_slice_free(RrPixmapCache, self);
+    }
+}
+
+static void key_add_color(GString *k, const RrColor *c)
+{
+    gint r, g, b;
+
+    /* use the color's value, as colors aren't shared between appearances */
+    if (c) {
+        r = c->r;
+        g = c->g;
+        b = c->b;
+    }
+    else
+        r = g = b = -1;
+    KEY_ADD(k, r);
+    KEY_ADD(k, g);
+    KEY_ADD(k, b);
+}
+
+GString* RrPixmapCacheSurfaceKey(const RrAppearance *a, gint w, gint h)
+{
+    const RrSurface *s = &a->surface;
+    GString *k;
+
+    if (s->grad == RR_SURFACE_PARENTREL && !s->parent->cache_key)
+        return NULL;
+
+    k = g_string_sized_new(128);
+    KEY_ADD(k, w);
+    KEY_ADD(k, h);
+
+    KEY_ADD(k, s->grad);
+    KEY_ADD(k, s->relief);
+    KEY_ADD(k, s->bevel);
+    KEY_ADD(k, s->interlaced);
+    KEY_ADD(k, s->border);
+    KEY_ADD(k, s->bevel_dark_adjust);
+    KEY_ADD(k, s->bevel_light_adjust);
+    key_add_color(k, s->primary);
+    key_add_color(k, s->secondary);
+    key_add_color(k, s->border_color);
+    key_add_color(k, s->bevel_dark);
+    key_add_color(k, s->bevel_light);
+    key_add_color(k, s->interlace_color);
+    key_add_color(k, s->split_primary);
+    key_add_color(k, s->split_secondary);
+
+    if (s->grad == RR_SURFACE_PARENTREL) {
+        /* the parent's key says what is in its pixel_data */
+        KEY_ADD(k, s->parentx);
+        KEY_ADD(k, s->parenty);
+        KEY_ADD(k, s->parent->cache_key->len);
+        g_string_append_len(k, s->parent->cache_key->str,
+                            s->parent->cache_key->len);
+    }
+    return k;
+}
+
+GString* RrPixmapCacheKey(const RrAppearance *a, gint w, gint h)
+{
+    GString *k;
+    gint i;
+
+    for (i = 0; i < a->textures; ++i)
+        if (a->texture[i].type == RR_TEXTURE_IMAGE ||
+            a->texture[i].type == RR_TEXTURE_RGBA)
+            return NULL;
+
+    if (!(k = RrPixmapCacheSurfaceKey(a, w, h)))
+        return NULL;
+
+    KEY_ADD(k, a->textures);
+    for (i = 0; i < a->textures; ++i) {
+        const RrTextureData *d = &a->texture[i].data;
+
+        KEY_ADD(k, a->texture[i].type);
+        switch (a->texture[i].type) {
+        case RR_TEXTURE_NONE:
+            break;
+        case RR_TEXTURE_TEXT:
+        {
+            gsize len = d->text.string ? strlen(d->text.string) : 0;
+
+            KEY_ADD(k, d->text.font->id);
+            KEY_ADD(k, d->text.justify);
+            key_add_color(k, d->text.color);
+            KEY_ADD(k, d->text.shadow_offset_x);
+            KEY_ADD(k, d->text.shadow_offset_y);
+            key_add_color(k, d->text.shadow_color);
+            KEY_ADD(k, d->text.shadow_alpha);
+            KEY_ADD(k, d->text.shortcut);
+            KEY_ADD(k, d->text.shortcut_pos);
+            KEY_ADD(k, d->text.ellipsize);
+            KEY_ADD(k, d->text.flow);
+            KEY_ADD(k, d->text.maxwidth);
+            KEY_ADD(k, len);
+            g_string_append_len(k, d->text.string, len);
+            break;
+        }
+        case RR_TEXTURE_LINE_ART:
+            key_add_color(k, d->lineart.color);
+            KEY_ADD(k, d->lineart.x1);
+            KEY_ADD(k, d->lineart.y1);
+            KEY_ADD(k, d->lineart.x2);
+            KEY_ADD(k, d->lineart.y2);
+            break;
+        case RR_TEXTURE_MASK:
+        {
+            const RrPixmapMask *m = d->mask.mask;
+            gint mw = m ? m->width : -1, mh = m ? m->height : -1;
+
+            key_add_color(k, d->mask.color);
+            KEY_ADD(k, mw);
+            KEY_ADD(k, mh);
+            if (m)
+                g_string_append_len(k, m->data, (mw + 7) / 8 * mh);
+            break;
+        }
+        case RR_TEXTURE_IMAGE:
+        case RR_TEXTURE_RGBA:
+        case RR_TEXTURE_NUM_TYPES:
+            g_assert_not_reached();
+        }
+    }
+    return k;
+}
+
+Pixmap RrPixmapCacheLookup(RrPixmapCache *self, const GString *key)
+{
+    RrPixmapCacheEntry *e;
+
+    e = g_hash_table_lookup(self->table, key);
+    if (!e) return None;
+
+    /* move it to the front of the lru queue */
+    g_queue_unlink(self->lru, e->link);
+    g_queue_push_head_link(self->lru, e->link);
+    return e->pixmap;
+}
+
+void RrPixmapCacheInsert(RrPixmapCache *self, Display *d,
+                         const GString *key, Pixmap p, gulong bytes)
+{
+    RrPixmapCacheEntry *e;
+
+    g_assert(g_hash_table_lookup(self->table, key) == NULL);
+
+    e = g_slice_new(RrPixmapCacheEntry);
+    e->key = g_string_new_len(key->str, key->len);
+    e->pixmap = p;
+    e->bytes = bytes;
+    g_queue_push_head(self->lru, e);
+    e->link = g_queue_peek_head_link(self->lru);
+    g_hash_table_insert(self->table, e->key, e);
+    self->bytes += bytes;
+
+    /* windows still showing an evicted pixmap keep it until they are
+       repainted, the server holds onto it for them */
+    while (self->bytes > self->budget &&
+           (e = g_queue_pop_tail(self->lru)))
+    {
+        g_hash_table_remove(self->table, e->key);
+        self->bytes -= e->bytes;
+        entry_free(e, d);
+    }
+}
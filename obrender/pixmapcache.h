@@ -0,0 +1,70 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   pixmapcache.h for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __pixmapcache_h
+#define __pixmapcache_h
+
+#include "render.h"
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+typedef struct _RrPixmapCache RrPixmapCache;
+
+/*! A cache of pixmaps that have been painted by RrPaintCached, so that
+  identical appearances painted at the same size can share one pixmap.  The
+  cache owns the pixmaps in it, and frees the least recently used ones when it
+  holds more than its budget. */
+struct _RrPixmapCache {
+    /*! Maps a key (GString*) to an RrPixmapCacheEntry* */
+    GHashTable *table;
+    /*! The entries, most recently used first */
+    GQueue *lru;
+    /*! The number of bytes held by the pixmaps in the cache */
+    gulong bytes;
+    /*! The most bytes the cache should hold */
+    gulong budget;
+};
+
+RrPixmapCache* RrPixmapCacheNew(gulong budget);
+void           RrPixmapCacheFree(RrPixmapCache *self, Display *d);
+
+/*! Build the key for an appearance painted at the given size.  Appearances
+  containing images are not cached, and this returns NULL for them.  It also
+  returns NULL for a PARENTREL appearance if its parent was not painted from
+  the cache.
+  @return A new GString, which must be freed by the caller.
+*/
+GString* RrPixmapCacheKey(const RrAppearance *a, gint w, gint h);
+
+/*! Build a key for only the surface of an appearance painted at the given
+  size, leaving out its textures.  Like RrPixmapCacheKey, this returns NULL for
+  a PARENTREL appearance if its parent was not painted from the cache.
+  @return A new GString, which must be freed by the caller.
+*/
+GString* RrPixmapCacheSurfaceKey(const RrAppearance *a, gint w, gint h);
+
+/*! Returns the pixmap stored for the key, or None */
+Pixmap RrPixmapCacheLookup(RrPixmapCache *self, const GString *key);
+
+/*! Add a pixmap to the cache.  The cache takes ownership of the pixmap, and
+  makes its own copy of the key. */
+void RrPixmapCacheInsert(RrPixmapCache *self, Display *d,
+                         const GString *key, Pixmap p, gulong bytes);
+
+#endif
@@ -25,6 +25,9 @@
 #include "color.h"
 #include "image.h"
 #include "theme.h"
+#include "upload.h"
+#include "instance.h"
+#include "pixmapcache.h"
 
 #include <glib.h>
 #include <X11/Xlib.h>
@@ -34,52 +37,108 @@
 #ifdef HAVE_STDLIB_H
 #  include <stdlib.h>
 #endif
+#ifdef HAVE_STRING_H
+#  include <string.h>
+#endif
 
 static void pixel_data_to_pixmap(RrAppearance *l,
                                  gint x, gint y, gint w, gint h);
 
-Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
+static gboolean can_paint(RrAppearance *a, gint w, gint h)
 {
-    gint i, transferred = 0, force_transfer = 0;
-    Pixmap oldp = None;
-    RrRect tarea; /* area in which to draw textures */
-    gboolean resized;
-
-    if (w <= 0 || h <= 0) return None;
+    if (w <= 0 || h <= 0) return FALSE;
 
     if (a->surface.parentx < 0 || a->surface.parenty < 0) {
         /* ob_debug("Invalid parent co-ordinates\n"); */
-        return None;
+        return FALSE;
     }
 
     if (a->surface.grad == RR_SURFACE_PARENTREL &&
         (a->surface.parentx >= a->surface.parent->w ||
          a->surface.parenty >= a->surface.parent->h))
     {
-        return None;
+        return FALSE;
     }
+    return TRUE;
+}
 
-    resized = (a->w != w || a->h != h);
+/*! Round a pixmap's width or height up to its size class.  A window's pixmap
+  is kept as long as the window's size stays in the same class, and the pixmap
+  is as big as the largest size in the class. */
+static gint size_class(gint n)
+{
+    gint step = 16;
 
-    oldp = a->pixmap; /* save to free after changing the visible pixmap */
-    a->pixmap = XCreatePixmap(RrDisplay(a->inst),
-                              RrRootWindow(a->inst),
-                              w, h, RrDepth(a->inst));
+    /* the classes are at most 1/8th bigger than the size */
+    while (step * 8 < n)
+        step <<= 1;
+    return (n + step - 1) / step * step;
+}
 
-    g_assert(a->pixmap != None);
-    a->w = w;
-    a->h = h;
+/*! Make sure the pixel_data has room for w x h pixels */
+static void pixel_data_reserve(RrAppearance *a, gint w, gint h)
+{
+    if (a->surface.pixel_data_size < w * h) {
+        /* leave room to grow within the size class */
+        a->surface.pixel_data_size = size_class(w) * size_class(h);
+        g_free(a->surface.pixel_data);
+        a->surface.pixel_data = g_new(RrPixel32, a->surface.pixel_data_size);
+    }
+}
 
-    if (a->xftdraw != NULL)
-        XftDrawDestroy(a->xftdraw);
-    a->xftdraw = XftDrawCreate(RrDisplay(a->inst), a->pixmap,
-                               RrVisual(a->inst), RrColormap(a->inst));
-    g_assert(a->xftdraw != NULL);
+/*! Paint into the appearance's pixmap.  When win is not None, the pixmap is
+  going to be shown in the window, and if the pixmap was already showing in
+  the same window then it is drawn over instead of being replaced. */
+static Pixmap paint_pixmap(RrAppearance *a, gint w, gint h, Window win)
+{
+    gint i, transferred = 0, force_transfer = 0;
+    Pixmap oldp = None;
+    RrRect tarea; /* area in which to draw textures */
+    gboolean render_images;
 
-    if (resized) {
-        g_free(a->surface.pixel_data);
-        a->surface.pixel_data = g_new(RrPixel32, w * h);
+    if (!can_paint(a, w, h)) return None;
+
+    RrUploadBeginPaint(a->inst);
+
+    /* this paint is not in the pixmap cache */
+    if (a->cache_key) {
+        g_string_free(a->cache_key, TRUE);
+        a->cache_key = NULL;
     }
+    /* and it can't be repainted in part until RrPaintRegion says so */
+    if (a->region_key) {
+        g_string_free(a->region_key, TRUE);
+        a->region_key = NULL;
+    }
+    a->pixel_data_stale = FALSE;
+
+    if (win != None && a->pixmap != None && a->window == win &&
+        a->pixmap_w == size_class(w) && a->pixmap_h == size_class(h))
+    {
+        /* nothing else is showing the pixmap, so draw over it.  the window
+           shows only the top left of it. */
+    }
+    else {
+        oldp = a->pixmap; /* save to free after changing the visible pixmap */
+        a->pixmap_w = win != None ? size_class(w) : w;
+        a->pixmap_h = win != None ? size_class(h) : h;
+        a->pixmap = XCreatePixmap(RrDisplay(a->inst),
+                                  RrRootWindow(a->inst),
+                                  a->pixmap_w, a->pixmap_h,
+                                  RrDepth(a->inst));
+        g_assert(a->pixmap != None);
+
+        if (a->xftdraw != NULL)
+            XftDrawDestroy(a->xftdraw);
+        a->xftdraw = XftDrawCreate(RrDisplay(a->inst), a->pixmap,
+                                   RrVisual(a->inst), RrColormap(a->inst));
+        g_assert(a->xftdraw != NULL);
+    }
+    a->window = win;
+    a->w = w;
+    a->h = h;
+
+    pixel_data_reserve(a, w, h);
 
     RrRender(a, w, h);
 
@@ -89,6 +148,14 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
         RECT_SET(tarea, l, t, w - l - r, h - t - b);
     }
 
+    /* images are composited on the server when possible, but RGBA textures
+       are always blended into the pixel_data, and need it to be the last
+       thing sent to the server */
+    render_images = RrHasXRender(a->inst);
+    for (i = 0; i < a->textures; i++)
+        if (a->texture[i].type == RR_TEXTURE_RGBA)
+            render_images = FALSE;
+
     for (i = 0; i < a->textures; i++) {
         switch (a->texture[i].type) {
         case RR_TEXTURE_NONE:
@@ -131,7 +198,7 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
             RrPixmapMaskDraw(a->pixmap, &a->texture[i].data.mask, &tarea);
             break;
         case RR_TEXTURE_IMAGE:
-            g_assert(!transferred);
+            g_assert(render_images || !transferred);
             {
                 RrRect narea = tarea;
                 RrTextureImage *img = &a->texture[i].data.image;
@@ -143,6 +210,18 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
                     narea.width = MIN(narea.width, img->twidth);
                 if (img->theight)
                     narea.height = MIN(narea.height, img->theight);
+#ifdef XRENDER
+                if (render_images) {
+                    if (!transferred) {
+                        transferred = 1;
+                        if ((a->surface.grad != RR_SURFACE_SOLID)
+                            || (a->surface.interlaced))
+                            pixel_data_to_pixmap(a, 0, 0, w, h);
+                    }
+                    RrImageRenderImage(a->inst, a->pixmap, img, &narea);
+                    break;
+                }
+#endif
                 RrImageDrawImage(a->surface.pixel_data,
                                  &a->texture[i].data.image,
                                  a->w, a->h,
@@ -187,17 +266,202 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
     return oldp;
 }
 
+Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
+{
+    return paint_pixmap(a, w, h, None);
+}
+
 void RrPaint(RrAppearance *a, Window win, gint w, gint h)
 {
     Pixmap oldp;
 
-    oldp = RrPaintPixmap(a, w, h);
+    oldp = paint_pixmap(a, w, h, win);
     XSetWindowBackgroundPixmap(RrDisplay(a->inst), win, a->pixmap);
     XClearWindow(RrDisplay(a->inst), win);
     /* free this after changing the visible pixmap */
     if (oldp) XFreePixmap(RrDisplay(a->inst), oldp);
 }
 
+void RrPaintCached(RrAppearance *a, Window win, gint w, gint h)
+{
+    Display *d = RrDisplay(a->inst);
+    RrPixmapCache *cache = RrInstancePixmapCache(a->inst);
+    GString *key;
+    Pixmap p;
+
+    if (!can_paint(a, w, h) || !(key = RrPixmapCacheKey(a, w, h))) {
+        RrPaint(a, win, w, h);
+        return;
+    }
+
+    if ((p = RrPixmapCacheLookup(cache, key))) {
+        RrUploadBeginPaint(a->inst);
+
+        /* the pixel_data is only rendered if a parentrelative child needs
+           it, but keep it the right size */
+        pixel_data_reserve(a, w, h);
+        a->w = w;
+        a->h = h;
+        a->pixel_data_stale = TRUE;
+
+        XSetWindowBackgroundPixmap(d, win, p);
+        XClearWindow(d, win);
+
+        /* free this after changing the visible pixmap, along with the
+           XftDraw that was made for it */
+        if (a->pixmap != None) {
+            if (a->xftdraw != NULL) {
+                XftDrawDestroy(a->xftdraw);
+                a->xftdraw = NULL;
+            }
+            XFreePixmap(d, a->pixmap);
+            a->pixmap = None;
+            a->window = None;
+        }
+    }
+    else {
+        Pixmap oldp;
+        gint bpp;
+
+        oldp = RrPaintPixmap(a, w, h);
+        XSetWindowBackgroundPixmap(d, win, a->pixmap);
+        XClearWindow(d, win);
+        if (oldp) XFreePixmap(d, oldp);
+
+        /* hand the pixmap over to the cache */
+        bpp = RrDepth(a->inst) > 16 ? 4 : (RrDepth(a->inst) > 8 ? 2 : 1);
+        RrPixmapCacheInsert(cache, d, key, a->pixmap, (gulong)w * h * bpp);
+        a->pixmap = None;
+        if (a->xftdraw != NULL) {
+            XftDrawDestroy(a->xftdraw);
+            a->xftdraw = NULL;
+        }
+    }
+
+    if (a->cache_key)
+        g_string_free(a->cache_key, TRUE);
+    a->cache_key = key;
+}
+
+/*! Grow r to also cover o */
+static void rect_add(RrRect *r, const RrRect *o)
+{
+    gint x2, y2;
+
+    if (o->width <= 0 || o->height <= 0)
+        return;
+    if (r->width <= 0 || r->height <= 0) {
+        *r = *o;
+        return;
+    }
+    x2 = MAX(r->x + r->width, o->x + o->width);
+    y2 = MAX(r->y + r->height, o->y + o->height);
+    r->x = MIN(r->x, o->x);
+    r->y = MIN(r->y, o->y);
+    r->width = x2 - r->x;
+    r->height = y2 - r->y;
+}
+
+/*! Find where the appearance's text textures are drawn */
+static void text_area(RrAppearance *a, RrRect *tarea, RrRect *area)
+{
+    RrRect r;
+    gint i;
+
+    RECT_SET(*area, 0, 0, 0, 0);
+    for (i = 0; i < a->textures; i++)
+        if (a->texture[i].type == RR_TEXTURE_TEXT) {
+            RrFontDrawArea(&a->texture[i].data.text, tarea, &r);
+            rect_add(area, &r);
+        }
+}
+
+/*! Returns TRUE if the pixmap painted for the window can be repainted in
+  part, instead of painting the whole appearance again */
+static gboolean region_reusable(RrAppearance *a, Window win, gint w, gint h,
+                                const GString *key)
+{
+    gint i;
+
+    if (!key || !a->region_key || a->pixmap == None || a->xftdraw == NULL ||
+        a->window != win || a->w != w || a->h != h ||
+        !g_string_equal(key, a->region_key))
+        return FALSE;
+
+    /* only text can be redrawn on top of the surface inside a clip */
+    for (i = 0; i < a->textures; i++)
+        if (a->texture[i].type != RR_TEXTURE_NONE &&
+            a->texture[i].type != RR_TEXTURE_TEXT)
+            return FALSE;
+    return TRUE;
+}
+
+void RrPaintRegion(RrAppearance *a, Window win, gint w, gint h,
+                   const RrRect *area)
+{
+    Display *d = RrDisplay(a->inst);
+    GString *key;
+    RrRect tarea, text, damage;
+    XRectangle clip;
+    gint i, l, t, r, b, x1, y1, x2, y2;
+
+    if (!can_paint(a, w, h)) {
+        RrPaint(a, win, w, h);
+        return;
+    }
+
+    RrMargins(a, &l, &t, &r, &b);
+    RECT_SET(tarea, l, t, w - l - r, h - t - b);
+
+    key = RrPixmapCacheSurfaceKey(a, w, h);
+    if (!region_reusable(a, win, w, h, key)) {
+        RrPaint(a, win, w, h);
+        a->region_key = key;
+        text_area(a, &tarea, &a->region_text);
+        return;
+    }
+    g_string_free(key, TRUE);
+
+    RrUploadBeginPaint(a->inst);
+
+    /* cover up the old text, and draw the new text */
+    text_area(a, &tarea, &text);
+    damage = a->region_text;
+    rect_add(&damage, &text);
+    if (area) rect_add(&damage, area);
+    a->region_text = text;
+
+    /* the surface around the textures' area is unchanged */
+    x1 = MAX(damage.x, tarea.x);
+    y1 = MAX(damage.y, tarea.y);
+    x2 = MIN(damage.x + damage.width, tarea.x + tarea.width);
+    y2 = MIN(damage.y + damage.height, tarea.y + tarea.height);
+
+    if (x1 < x2 && y1 < y2) {
+        if ((a->surface.grad != RR_SURFACE_SOLID) || (a->surface.interlaced))
+            pixel_data_to_pixmap(a, x1, y1, x2 - x1, y2 - y1);
+        else
+            XFillRectangle(d, a->pixmap, RrColorGC(a->surface.primary),
+                           x1, y1, x2 - x1, y2 - y1);
+
+        clip.x = x1;
+        clip.y = y1;
+        clip.width = x2 - x1;
+        clip.height = y2 - y1;
+        XftDrawSetClipRectangles(a->xftdraw, 0, 0, &clip, 1);
+        for (i = 0; i < a->textures; i++)
+            if (a->texture[i].type == RR_TEXTURE_TEXT)
+                RrFontDraw(a->xftdraw, &a->texture[i].data.text, &tarea);
+        XftDrawSetClip(a->xftdraw, None);
+    }
+
+    /* the window may have shown another appearance since this one was
+       painted in it.  the server redraws it from the pixmap, so this sends no
+       pixels. */
+    XSetWindowBackgroundPixmap(d, win, a->pixmap);
+    XClearWindow(d, win);
+}
+
 RrAppearance *RrAppearanceNew(const RrInstance *inst, gint numtex)
 {
   RrAppearance *out;
@@ -308,6 +572,7 @@ RrAppearance *RrAppearanceCopy(RrAppearance *orig)
     spc->parent = NULL;
     spc->parentx = spc->parenty = 0;
     spc->pixel_data = NULL;
+    spc->pixel_data_size = 0;
 
     copy->textures = orig->textures;
     copy->texture = g_memdup(orig->texture,
@@ -315,6 +580,12 @@ RrAppearance *RrAppearanceCopy(RrAppearance *orig)
     copy->pixmap = None;
     copy->xftdraw = NULL;
     copy->w = copy->h = 0;
+    copy->cache_key = NULL;
+    copy->pixel_data_stale = FALSE;
+    copy->window = None;
+    copy->pixmap_w = copy->pixmap_h = 0;
+    copy->region_key = NULL;
+    RECT_SET(copy->region_text, 0, 0, 0, 0);
     return copy;
 }
 
@@ -325,6 +596,8 @@ void RrAppearanceFree(RrAppearance *a)
         RrSurface *p;
         if (a->pixmap != None) XFreePixmap(RrDisplay(a->inst), a->pixmap);
         if (a->xftdraw != NULL) XftDrawDestroy(a->xftdraw);
+        if (a->cache_key) g_string_free(a->cache_key, TRUE);
+        if (a->region_key) g_string_free(a->region_key, TRUE);
         if (a->textures)
             g_free(a->texture);
         p = &a->surface;
@@ -338,6 +611,7 @@ void RrAppearanceFree(RrAppearance *a)
         RrColorFree(p->split_secondary);
         g_free(p->pixel_data);
         p->pixel_data = NULL;
+        p->pixel_data_size = 0;
         g_slice_free(RrAppearance, a);
     }
 }
@@ -345,28 +619,22 @@ void RrAppearanceFree(RrAppearance *a)
 static void pixel_data_to_pixmap(RrAppearance *l,
                                  gint x, gint y, gint w, gint h)
 {
-    RrPixel32 *in, *scratch;
-    Pixmap out;
-    XImage *im = NULL;
-    im = XCreateImage(RrDisplay(l->inst), RrVisual(l->inst), RrDepth(l->inst),
-                      ZPixmap, 0, NULL, w, h, 32, 0);
-    g_assert(im != NULL);
-
-    in = l->surface.pixel_data;
-    out = l->pixmap;
-
-/* this malloc is a complete waste of time on normal 32bpp
-   as reduce_depth just sets im->data = data and returns
-*/
-    scratch = g_new(RrPixel32, im->width * im->height);
-    im->data = (gchar*) scratch;
-    RrReduceDepth(l->inst, in, im);
-    XPutImage(RrDisplay(l->inst), out,
-              DefaultGC(RrDisplay(l->inst), RrScreen(l->inst)),
-              im, 0, 0, x, y, w, h);
-    im->data = NULL;
-    XDestroyImage(im);
-    g_free(scratch);
+    RrPixel32 *rect;
+    gint i;
+
+    if (x == 0 && w == l->w) {
+        /* the rows are already together */
+        RrUploadImage(l->inst, l->pixmap,
+                      l->surface.pixel_data + y * l->w, x, y, w, h);
+        return;
+    }
+
+    rect = g_new(RrPixel32, w * h);
+    for (i = 0; i < h; ++i)
+        memcpy(rect + i * w, l->surface.pixel_data + (y + i) * l->w + x,
+               w * sizeof(RrPixel32));
+    RrUploadImage(l->inst, l->pixmap, rect, x, y, w, h);
+    g_free(rect);
 }
 
 void RrMargins (RrAppearance *a, gint *l, gint *t, gint *r, gint *b)
@@ -138,6 +138,8 @@ struct _RrSurface {
     gint parentx;
     gint parenty;
     RrPixel32 *pixel_data;
+    /* the number of pixels that pixel_data has room for */
+    gint pixel_data_size;
     gint bevel_dark_adjust;  /* 0-255, default is 64 */
     gint bevel_light_adjust; /* 0-255, default is 128 */
     RrColor *split_primary;
@@ -186,6 +188,9 @@ struct _RrTextureRGBA {
     gint theight;
 };
 
+/* When the Render extension is available, images are composited onto the
+   appearance's pixmap on the X server.  They are then not part of the
+   appearance's pixel_data, which PARENTREL children copy from. */
 struct _RrTextureImage {
     RrImage *image;
     gint alpha;
@@ -231,6 +236,19 @@ struct _RrAppearance {
 
     /* cached for internal use */
     gint w, h;
+    /* the key for the pixmap cache, when last painted with RrPaintCached */
+    GString *cache_key;
+    /* the last paint came from the pixmap cache, and the pixel_data was not
+       rendered for it */
+    gboolean pixel_data_stale;
+    /* the size of the pixmap, which can be larger than the area painted */
+    gint pixmap_w, pixmap_h;
+    /* the window showing the pixmap, when it was painted by RrPaint */
+    Window window;
+    /* the key for the surface, when it was last painted by RrPaintRegion,
+       and where its text was drawn */
+    GString *region_key;
+    RrRect region_text;
 };
 
 /*! Holds a RGBA image picture */
@@ -240,6 +258,15 @@ struct _RrImagePic {
     /* The sum of all the pixels.  This is used to compare pictures if their
        hashes match. */
     gint sum;
+    /* TRUE if the data points into one of the RrImageSet's sources, rather
+       than belonging to the picture.  These pictures are found through their
+       source, so they are not in the cache's pic_table and have no sum. */
+    gboolean borrowed;
+
+    /* A copy of the picture on the X server, made the first time it is
+       composited with the Render extension. */
+    Picture picture;
+    const RrInstance *picture_inst;
 };
 
 typedef void (*RrImageDestroyFunc)(RrImage *image, gpointer data);
@@ -270,6 +297,12 @@ struct _RrImageSet
       only be associated with a single RrImageSet. */
     GSList *names;
 
+    /*! Buffers of packed pictures which have been unpacked into the
+      RrImageSet, as RrImageSources.  The RrImageSet owns them, and the
+      "original" pictures that came from them point into their data.  Each
+      one is a key in the RrImageCache's source_table. */
+    GSList *sources;
+
     /*! RrImages that point at this RrImageSet. If this is empty, then there
       are no images using the set and it can be freed. */
     GSList *images;
@@ -403,6 +436,17 @@ gint    RrFontMaxCharWidth  (const RrFont *f);
    it is non-null. */
 Pixmap RrPaintPixmap (RrAppearance *a, gint w, gint h);
 void   RrPaint       (RrAppearance *a, Window win, gint w, gint h);
+/* Paint like RrPaint, but share the pixmap with every window painted from an
+   identical appearance at the same size.  The pixmap is kept in a cache owned
+   by the RrInstance, and appearances with images in them are not cached. */
+void   RrPaintCached (RrAppearance *a, Window win, gint w, gint h);
+/* Paint like RrPaint.  But when the appearance was last painted into the same
+   window at the same size by RrPaintRegion, and only its text has changed
+   since, keep the pixmap and repaint only where the old text was and the new
+   text goes, along with the area given (which may be NULL).  Nothing but the
+   changed pixels are sent to the X server. */
+void   RrPaintRegion (RrAppearance *a, Window win, gint w, gint h,
+                      const RrRect *area);
 void   RrMinSize     (RrAppearance *a, gint *w, gint *h);
 gint   RrMinWidth    (RrAppearance *a);
 /* For text textures, if flow is TRUE, then the string must be set before
@@ -410,6 +454,19 @@ gint   RrMinWidth    (RrAppearance *a);
 gint   RrMinHeight   (RrAppearance *a);
 void   RrMargins     (RrAppearance *a, gint *l, gint *t, gint *r, gint *b);
 
+/*! Returns the number of bytes of pixel data that the last RrPaint or
+  RrPaintPixmap wrote down the connection to the X server */
+gulong  RrPaintBytesUploaded (const RrInstance *inst);
+/*! Returns the number of bytes of pixel data that the last RrPaint or
+  RrPaintPixmap handed to the X server through shared memory */
+gulong  RrPaintBytesShared   (const RrInstance *inst);
+/*! Returns the number of bytes of pixel data written down the connection to
+  the X server since the instance was created */
+guint64 RrTotalBytesUploaded (const RrInstance *inst);
+/*! Returns the number of bytes of pixel data handed to the X server through
+  shared memory since the instance was created */
+guint64 RrTotalBytesShared   (const RrInstance *inst);
+
 gboolean RrPixmapToRGBA(const RrInstance *inst,
                         Pixmap pmap, Pixmap mask,
                         gint *w, gint *h, RrPixel32 **data);
@@ -454,6 +511,23 @@ RrImage* RrImageNewFromData(RrImageCache *cache, RrPixel32 *data,
 */
 void RrImageAddFromData(RrImage *image, RrPixel32 *data, gint w, gint h);
 
+/*! Create a new image from several sizes of a picture packed into one buffer,
+  or return one from the cache that was made from the same buffer.  Each
+  picture in the buffer is its width and its height, followed by its pixels,
+  which is the format of the _NET_WM_ICON property.  Pictures with no size, or
+  which run past the end of the buffer, are skipped.
+  Only the sizes and a few values used to find the buffer in the cache are
+  read here.  The whole buffer is compared only with a cached buffer that
+  matches them.  The pictures keep pointing into the buffer, and their pixels
+  are not looked at otherwise until they are drawn.
+  @param data The buffer, allocated with g_malloc.  The image takes ownership
+    of it.
+  @param len The number of values in the buffer
+  @return Returns NULL if the buffer does not hold any pictures, and frees it
+*/
+RrImage* RrImageNewFromPacked(RrImageCache *cache, RrPixel32 *data,
+                              gulong len);
+
 void RrImageRef(RrImage *im);
 void RrImageUnref(RrImage *im);
 
@@ -0,0 +1,53 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   simd.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "simd.h"
+
+static gboolean detected = FALSE;
+/*! The best level supported by the cpu */
+static RrSimdLevel supported = RR_SIMD_NONE;
+/*! The level the kernels are using */
+static RrSimdLevel level = RR_SIMD_NONE;
+
+static void detect(void)
+{
+#ifdef RR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        supported = RR_SIMD_AVX2;
+    else if (__builtin_cpu_supports("ssse3"))
+        supported = RR_SIMD_SSSE3;
+    else if (__builtin_cpu_supports("sse2"))
+        supported = RR_SIMD_SSE2;
+#endif
+    level = supported;
+    detected = TRUE;
+}
+
+RrSimdLevel RrSimdGetLevel(void)
+{
+    if (!detected) detect();
+    return level;
+}
+
+RrSimdLevel RrSimdSetLevel(RrSimdLevel l)
+{
+    if (!detected) detect();
+    level = MIN(l, supported);
+    return level;
+}
@@ -0,0 +1,54 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   simd.h for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __render_simd_h
+#define __render_simd_h
+
+#include <glib.h>
+
+/* the SIMD kernels are compiled with per-function target attributes, so the
+   rest of the library can still be built for the baseline cpu.  they are only
+   used when the cpu running us supports them. */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#  define RR_SIMD_X86
+#  define RR_TARGET_SSE2  __attribute__((target("sse2")))
+#  define RR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#  define RR_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+
+typedef enum {
+    RR_SIMD_NONE, /*!< Use the scalar code only */
+    RR_SIMD_SSE2,
+    RR_SIMD_SSSE3,
+    RR_SIMD_AVX2
+} RrSimdLevel;
+
+/*! Returns the most capable instruction set which the kernels should use */
+RrSimdLevel RrSimdGetLevel(void);
+
+/*! Limit the kernels to the given instruction set.  The level can not be
+  raised above what the cpu supports.  This is used to compare the SIMD
+  kernels against the scalar code.
+  @return The level that will be used
+*/
+RrSimdLevel RrSimdSetLevel(RrSimdLevel level);
+
+#endif
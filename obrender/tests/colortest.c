@@ -0,0 +1,171 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O0 -o ./colortest `pkg-config --cflags --libs obrender-3.5` \
+  colortest.c && \
+./colortest
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   colortest.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "../render.h"
+#include "../color.h"
+#include "../instance.h"
+#include "../simd.h"
+#include <stdio.h>
+#include <string.h>
+
+/* checks that the SIMD kernels in RrReduceDepth give exactly what the scalar
+   code does, for TrueColor visuals with each of these layouts */
+
+typedef struct {
+    const gchar *name;
+    gint bpp;
+    gulong red_mask, green_mask, blue_mask;
+} Layout;
+
+static const Layout layouts[] = {
+    { "rgb 888",      32, 0xff0000,   0x00ff00, 0x0000ff   },
+    { "bgr 888",      32, 0x0000ff,   0x00ff00, 0xff0000   },
+    { "rgb 101010",   32, 0x3ff00000, 0x000ffc00, 0x000003ff },
+    { "rgb 565",      16, 0xf800,     0x07e0,   0x001f     },
+    { "rgb 555",      16, 0x7c00,     0x03e0,   0x001f     },
+    { "bgr 565",      16, 0x001f,     0x07e0,   0xf800     }
+};
+#define NUM_LAYOUTS (sizeof(layouts) / sizeof(layouts[0]))
+
+/*! Find a channel's offset and shift from its mask, like RrInstanceNew */
+static void channel(gulong mask, gint *offset, gint *shift)
+{
+    *offset = 0;
+    while (!(mask & 1)) { ++*offset; mask >>= 1; }
+    *shift = 8;
+    while (mask) { mask >>= 1; --*shift; }
+}
+
+#define NARROW(v, shift) ((shift) >= 0 ? (v) >> (shift) : (v) << -(shift))
+
+static void setup(RrInstance *inst, Visual *visual, const Layout *l)
+{
+    guint32 v;
+
+    memset(inst, 0, sizeof(*inst));
+    memset(visual, 0, sizeof(*visual));
+    visual->class = TrueColor;
+    inst->visual = visual;
+    inst->depth = l->bpp == 32 ? 24 : 16;
+    inst->red_mask = l->red_mask;
+    inst->green_mask = l->green_mask;
+    inst->blue_mask = l->blue_mask;
+    channel(l->red_mask, &inst->red_offset, &inst->red_shift);
+    channel(l->green_mask, &inst->green_offset, &inst->green_shift);
+    channel(l->blue_mask, &inst->blue_offset, &inst->blue_shift);
+
+    /* the tables RrInstanceNew makes for the scalar code */
+    for (v = 0; v < 256; ++v) {
+        inst->tables.red[v] = NARROW(v, inst->red_shift) << inst->red_offset;
+        inst->tables.green[v] =
+            NARROW(v, inst->green_shift) << inst->green_offset;
+        inst->tables.blue[v] =
+            NARROW(v, inst->blue_shift) << inst->blue_offset;
+    }
+}
+
+static void reduce(RrInstance *inst, const Layout *l, RrPixel32 *data,
+                   gchar *out, gint w, gint h)
+{
+    XImage im;
+
+    memset(&im, 0, sizeof(im));
+    memset(out, 0xaa, w * h * (l->bpp / 8));
+    im.width = w;
+    im.height = h;
+    im.bits_per_pixel = l->bpp;
+    im.bytes_per_line = w * (l->bpp / 8);
+    im.data = out;
+    RrReduceDepth(inst, data, &im);
+    /* a layout the same as RrPixel32's is used as it is */
+    if (im.data != out)
+        memcpy(out, im.data, w * h * (l->bpp / 8));
+}
+
+static gint check(RrSimdLevel level)
+{
+    const gint w = 301, h = 3;
+    RrInstance inst;
+    Visual visual;
+    RrPixel32 *data;
+    gchar *scalar, *simd;
+    guint i, n;
+    gint checked = 0;
+
+    data = g_new(RrPixel32, w * h);
+    scalar = g_new(gchar, w * h * 4);
+    simd = g_new(gchar, w * h * 4);
+    for (n = 0; n < (1 << 24); n += w * h) {
+        for (i = 0; i < (guint)(w * h); ++i)
+            data[i] = (0xff << RrDefaultAlphaOffset) |
+                ((n + i) & 0xffffff);
+
+        for (i = 0; i < NUM_LAYOUTS; ++i) {
+            const Layout *l = &layouts[i];
+
+            setup(&inst, &visual, l);
+            RrSimdSetLevel(RR_SIMD_NONE);
+            reduce(&inst, l, data, scalar, w, h);
+            RrSimdSetLevel(level);
+            reduce(&inst, l, data, simd, w, h);
+
+            if (memcmp(scalar, simd, w * h * (l->bpp / 8))) {
+                printf("mismatch: level %d layout %s\n", level, l->name);
+                g_assert_not_reached();
+            }
+            ++checked;
+        }
+    }
+    g_free(simd);
+    g_free(scalar);
+    g_free(data);
+    return checked;
+}
+
+int main()
+{
+    const Layout *l = &layouts[2];
+    RrInstance inst;
+    Visual visual;
+    RrPixel32 white = 0xffffffff;
+    guint32 out;
+    RrSimdLevel level, best;
+
+    /* a channel wider than 8 bits gets the 8 bits at its top */
+    setup(&inst, &visual, l);
+    reduce(&inst, l, &white, (gchar*)&out, 1, 1);
+    g_assert(out == 0x3fcff3fc);
+
+    best = RrSimdGetLevel();
+    for (level = RR_SIMD_SSE2; level <= best; ++level)
+        printf("level %d: %d blocks of pixels identical\n", level,
+               check(level));
+    if (best == RR_SIMD_NONE)
+        printf("no SIMD support, nothing to compare\n");
+    return 0;
+}
@@ -0,0 +1,147 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O0 -o ./gradienttest `pkg-config --cflags --libs obrender-3.5` \
+  gradienttest.c && \
+./gradienttest
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   gradienttest.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "../render.h"
+#include "../gradient.h"
+#include "../color.h"
+#include "../simd.h"
+#include <stdio.h>
+#include <string.h>
+
+/* checks that the SIMD gradient kernels draw exactly what the scalar code
+   does */
+
+static RrColor colors[][2] = {
+    { { NULL,   0,   0,   0 }, { NULL, 255, 255, 255 } },
+    { { NULL, 255, 128,   0 }, { NULL,   0, 128, 255 } },
+    { { NULL,  18, 200,  77 }, { NULL,  19, 201,  75 } },
+    { { NULL, 100, 100, 100 }, { NULL, 100, 100, 100 } },
+    { { NULL, 250,   3, 129 }, { NULL,   7, 254,  64 } }
+};
+#define NUM_COLORS (sizeof(colors) / sizeof(colors[0]))
+
+static RrColor extra[] = {
+    { NULL,  40,  50,  60 },
+    { NULL, 220, 210, 200 },
+    { NULL,  90,   0, 255 }
+};
+
+static const RrSurfaceColorType grads[] = {
+    RR_SURFACE_SOLID,
+    RR_SURFACE_SPLIT_VERTICAL,
+    RR_SURFACE_HORIZONTAL,
+    RR_SURFACE_MIRROR_HORIZONTAL,
+    RR_SURFACE_VERTICAL,
+    RR_SURFACE_DIAGONAL,
+    RR_SURFACE_CROSS_DIAGONAL,
+    RR_SURFACE_PYRAMID
+};
+#define NUM_GRADS (sizeof(grads) / sizeof(grads[0]))
+
+static const gint sizes[][2] = {
+    { 1, 1 }, { 2, 2 }, { 3, 7 }, { 5, 3 }, { 8, 8 }, { 9, 2 }, { 13, 17 },
+    { 16, 16 }, { 17, 5 }, { 31, 4 }, { 33, 33 }, { 64, 3 }, { 100, 20 },
+    { 255, 2 }, { 256, 9 }, { 301, 257 }, { 600, 5 }, { 3840, 24 }
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static void render(RrAppearance *a, RrPixel32 *data, gint w, gint h)
+{
+    memset(data, 0xaa, w * h * sizeof(RrPixel32));
+    a->surface.pixel_data = data;
+    RrRender(a, w, h);
+}
+
+static gint check(RrSimdLevel level)
+{
+    RrAppearance a;
+    guint g, c, s, relief, bevel, flags;
+    gint checked = 0;
+
+    memset(&a, 0, sizeof(a));
+    a.pixmap = None;
+    a.surface.border_color = &extra[0];
+    a.surface.interlace_color = &extra[1];
+    a.surface.split_primary = &extra[2];
+    a.surface.split_secondary = &extra[0];
+
+    for (g = 0; g < NUM_GRADS; ++g)
+    for (c = 0; c < NUM_COLORS; ++c)
+    for (s = 0; s < NUM_SIZES; ++s)
+    for (relief = 0; relief < RR_RELIEF_NUM_TYPES; ++relief)
+    for (bevel = 0; bevel < RR_BEVEL_NUM_TYPES; ++bevel)
+    for (flags = 0; flags < 4; ++flags) {
+        gint w = sizes[s][0], h = sizes[s][1];
+        RrPixel32 *scalar, *simd;
+
+        /* a second bevel needs at least 2 rows */
+        if (bevel == RR_BEVEL_2 && h < 2) continue;
+
+        a.surface.grad = grads[g];
+        a.surface.relief = relief;
+        a.surface.bevel = bevel;
+        a.surface.primary = &colors[c][0];
+        a.surface.secondary = &colors[c][1];
+        a.surface.interlaced = flags & 1;
+        a.surface.border = (flags & 2) != 0;
+        a.surface.bevel_light_adjust = (flags & 2) ? 300 : 128;
+        a.surface.bevel_dark_adjust = (flags & 1) ? 256 : 64;
+
+        scalar = g_new(RrPixel32, w * h);
+        simd = g_new(RrPixel32, w * h);
+
+        RrSimdSetLevel(RR_SIMD_NONE);
+        render(&a, scalar, w, h);
+        RrSimdSetLevel(level);
+        render(&a, simd, w, h);
+
+        if (memcmp(scalar, simd, w * h * sizeof(RrPixel32))) {
+            printf("mismatch: level %d gradient %d colors %d size %dx%d "
+                   "relief %d bevel %d flags %d\n", level, grads[g], c, w, h,
+                   relief, bevel, flags);
+            g_assert_not_reached();
+        }
+        ++checked;
+
+        g_free(scalar);
+        g_free(simd);
+    }
+    return checked;
+}
+
+int main()
+{
+    RrSimdLevel level, best;
+
+    best = RrSimdGetLevel();
+    for (level = RR_SIMD_SSE2; level <= best; ++level)
+        printf("level %d: %d surfaces identical\n", level, check(level));
+    if (best == RR_SIMD_NONE)
+        printf("no SIMD support, nothing to compare\n");
+    return 0;
+}
@@ -0,0 +1,110 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O2 -o ./resizebench `pkg-config --cflags --libs obrender-3.5` \
+  resizebench.c && \
+./resizebench
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   resizebench.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "../render.h"
+#include "../image.h"
+#include "../simd.h"
+#include <stdio.h>
+#include <string.h>
+
+/* times scaling icons between the sizes they are usually given in and the
+   sizes they are drawn at, and checks that every SIMD level draws the same
+   thing */
+
+static const gint sizes[][2] = {
+    /* source, destination */
+    { 256, 16 }, { 256, 24 }, { 256, 48 }, { 256, 64 }, { 256, 128 },
+    { 128, 16 }, { 128, 24 }, { 128, 48 }, { 128, 64 },
+    { 64, 16 }, { 64, 24 }, { 64, 48 },
+    { 48, 16 }, { 48, 24 }, { 32, 16 }, { 32, 24 },
+    { 16, 24 }, { 16, 48 }
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static void draw(RrTextureRGBA *rgba, RrPixel32 *target, gint size)
+{
+    RrRect area = { 0, 0, size, size };
+
+    memset(target, 0, size * size * sizeof(RrPixel32));
+    RrImageDrawRGBA(target, rgba, size, size, &area);
+}
+
+int main()
+{
+    RrTextureRGBA rgba;
+    RrSimdLevel level, best;
+    guint i;
+    gint j;
+
+    best = RrSimdGetLevel();
+
+    memset(&rgba, 0, sizeof(rgba));
+    rgba.alpha = 0xff;
+
+    for (i = 0; i < NUM_SIZES; ++i) {
+        gint src = sizes[i][0], dst = sizes[i][1];
+        gint iters = 20000000 / (src * src + dst * dst);
+        RrPixel32 *scalar, *target;
+
+        rgba.width = rgba.height = src;
+        rgba.data = g_new(RrPixel32, src * src);
+        for (j = 0; j < src * src; ++j)
+            rgba.data[j] = g_random_int();
+        scalar = g_new(RrPixel32, dst * dst);
+        target = g_new(RrPixel32, dst * dst);
+
+        printf("%3dx%-3d -> %3dx%-3d", src, src, dst, dst);
+        /* the resize kernels only go up to SSE2 */
+        for (level = RR_SIMD_NONE; level <= MIN(best, RR_SIMD_SSE2);
+             ++level)
+        {
+            GTimer *t;
+            gint n;
+
+            RrSimdSetLevel(level);
+            t = g_timer_new();
+            for (n = 0; n < iters; ++n)
+                draw(&rgba, target, dst);
+            printf("  level %d: %7.2f us", level,
+                   g_timer_elapsed(t, NULL) * 1000000 / iters);
+            g_timer_destroy(t);
+
+            if (level == RR_SIMD_NONE)
+                memcpy(scalar, target, dst * dst * sizeof(RrPixel32));
+            else
+                g_assert(!memcmp(scalar, target,
+                                 dst * dst * sizeof(RrPixel32)));
+        }
+        printf("\n");
+
+        g_free(rgba.data);
+        g_free(scalar);
+        g_free(target);
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   upload.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "upload.h"
+#include "instance.h"
+#include "color.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#ifdef MITSHM
+#  include <sys/types.h>
+#  include <sys/ipc.h>
+#  include <sys/shm.h>
+#  include <X11/extensions/XShm.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#  include <string.h>
+#endif
+
+#ifdef MITSHM
+
+/* images smaller than this are cheaper to write down the connection than to
+   wait for a shared segment to come free */
+#define SHM_MIN_BYTES 4096
+/* segment sizes are rounded up to a multiple of this */
+#define SHM_ROUND_BYTES (64 * 1024)
+/* the most segments that will be kept in the pool */
+#define SHM_MAX_SEGMENTS 4
+
+typedef struct _RrShmSegment RrShmSegment;
+
+struct _RrShmSegment {
+    XShmSegmentInfo info;
+    gsize size;
+    /*! The serial of the last request that reads from the segment.  The
+      segment can be written to again once the server has processed it. */
+    gulong serial;
+};
+
+static gboolean shm_error;
+
+static gint shm_error_handler(Display *d, XErrorEvent *e)
+{
+    shm_error = TRUE;
+    return 0;
+}
+
+static RrShmSegment* shm_segment_new(Display *d, gsize size)
+{
+    RrShmSegment *seg;
+    XErrorHandler old;
+    Bool ok;
+
+    size = (size + SHM_ROUND_BYTES - 1) / SHM_ROUND_BYTES * SHM_ROUND_BYTES;
+
+    seg = g_slice_new0(RrShmSegment);
+    seg->size = size;
+    seg->info.readOnly = True;
+    seg->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (seg->info.shmid < 0) {
+        g_slice_free(RrShmSegment, seg);
+        return NULL;
+    }
+    seg->info.shmaddr = shmat(seg->info.shmid, NULL, 0);
+    if (seg->info.shmaddr == (gchar*)-1) {
+        shmctl(seg->info.shmid, IPC_RMID, NULL);
+        g_slice_free(RrShmSegment, seg);
+        return NULL;
+    }
+
+    /* attaching fails with an error when the server can't see our memory,
+       such as when the display is remote.  flush out any errors that belong
+       to the real error handler before catching our own. */
+    XSync(d, False);
+    shm_error = FALSE;
+    old = XSetErrorHandler(shm_error_handler);
+    ok = XShmAttach(d, &seg->info);
+    XSync(d, False);
+    XSetErrorHandler(old);
+
+    /* the segment is destroyed once both sides have detached from it */
+    shmctl(seg->info.shmid, IPC_RMID, NULL);
+
+    if (!ok || shm_error) {
+        shmdt(seg->info.shmaddr);
+        g_slice_free(RrShmSegment, seg);
+        return NULL;
+    }
+    return seg;
+}
+
+static void shm_segment_free(Display *d, RrShmSegment *seg)
+{
+    XShmDetach(d, &seg->info);
+    shmdt(seg->info.shmaddr);
+    g_slice_free(RrShmSegment, seg);
+}
+
+static gboolean shm_segment_idle(Display *d, RrShmSegment *seg)
+{
+    return (glong)(LastKnownRequestProcessed(d) - seg->serial) >= 0;
+}
+
+/*! Find a segment of at least size bytes which the server is done reading
+  from, creating one if needed */
+static RrShmSegment* shm_segment_get(RrUploader *up, Display *d, gsize size)
+{
+    GSList *it;
+    RrShmSegment *idle = NULL, *busy = NULL, *smallest = NULL;
+    RrShmSegment *seg;
+
+    for (it = up->segments; it; it = g_slist_next(it)) {
+        seg = it->data;
+
+        if (!smallest || seg->size < smallest->size)
+            smallest = seg;
+        if (seg->size < size)
+            continue;
+
+        if (shm_segment_idle(d, seg)) {
+            if (!idle || seg->size < idle->size)
+                idle = seg;
+        }
+        else if (!busy || seg->size < busy->size)
+            busy = seg;
+    }
+
+    if (idle)
+        return idle;
+
+    if (busy && g_slist_length(up->segments) >= SHM_MAX_SEGMENTS) {
+        /* wait for the server to finish with it rather than growing the
+           pool */
+        XSync(d, False);
+        return busy;
+    }
+
+    if (g_slist_length(up->segments) >= SHM_MAX_SEGMENTS) {
+        /* every segment is too small, so replace the smallest one */
+        XSync(d, False);
+        up->segments = g_slist_remove(up->segments, smallest);
+        shm_segment_free(d, smallest);
+    }
+
+    if ((seg = shm_segment_new(d, size)))
+        up->segments = g_slist_prepend(up->segments, seg);
+    return seg;
+}
+
+static gboolean shm_upload(const RrInstance *inst, RrUploader *up,
+                           Drawable d, RrPixel32 *data,
+                           gint x, gint y, gint w, gint h)
+{
+    Display *dpy = RrDisplay(inst);
+    RrShmSegment *seg;
+    XImage *im;
+    gsize bytes;
+
+    im = XShmCreateImage(dpy, RrVisual(inst), RrDepth(inst),
+                         ZPixmap, NULL, NULL, w, h);
+    if (!im) return FALSE;
+
+    bytes = (gsize)im->bytes_per_line * h;
+    if (bytes < SHM_MIN_BYTES || !(seg = shm_segment_get(up, dpy, bytes))) {
+        XDestroyImage(im);
+        return FALSE;
+    }
+
+    im->obdata = (gchar*) &seg->info;
+    im->data = seg->info.shmaddr;
+    RrReduceDepth(inst, data, im);
+    /* when no conversion is needed, RrReduceDepth just points the image at
+       the source data */
+    if (im->data != seg->info.shmaddr) {
+        memcpy(seg->info.shmaddr, im->data, bytes);
+        im->data = seg->info.shmaddr;
+    }
+
+    XShmPutImage(dpy, d, DefaultGC(dpy, RrScreen(inst)),
+                 im, 0, 0, x, y, w, h, False);
+    seg->serial = NextRequest(dpy) - 1;
+
+    im->data = NULL;
+    im->obdata = NULL;
+    XDestroyImage(im);
+
+    up->paint_shared += bytes;
+    up->total_shared += bytes;
+    return TRUE;
+}
+
+#endif
+
+RrUploader* RrUploaderNew(const RrInstance *inst)
+{
+    RrUploader *up;
+
+    up = g_slice_new0(RrUploader);
+#ifdef MITSHM
+    if (XShmQueryExtension(RrDisplay(inst))) {
+        RrShmSegment *seg;
+
+        /* make sure the server can actually attach to our memory */
+        if ((seg = shm_segment_new(RrDisplay(inst), SHM_ROUND_BYTES))) {
+            up->segments = g_slist_prepend(up->segments, seg);
+            up->shm = TRUE;
+        }
+    }
+#endif
+    return up;
+}
+
+void RrUploaderFree(RrUploader *up, const RrInstance *inst)
+{
+    if (up) {
+#ifdef MITSHM
+        while (up->segments) {
+            shm_segment_free(RrDisplay(inst), up->segments->data);
+            up->segments = g_slist_delete_link(up->segments, up->segments);
+        }
+#endif
+        g_slice_free(RrUploader, up);
+    }
+}
+
+void RrUploadBeginPaint(const RrInstance *inst)
+{
+    RrUploader *up = RrInstanceUploader(inst);
+
+    up->paint_wire = up->paint_shared = 0;
+}
+
+void RrUploadImage(const RrInstance *inst, Drawable d, RrPixel32 *data,
+                   gint x, gint y, gint w, gint h)
+{
+    RrUploader *up = RrInstanceUploader(inst);
+    RrPixel32 *scratch;
+    XImage *im = NULL;
+    gulong bytes;
+
+#ifdef MITSHM
+    if (up->shm && shm_upload(inst, up, d, data, x, y, w, h))
+        return;
+#endif
+
+    im = XCreateImage(RrDisplay(inst), RrVisual(inst), RrDepth(inst),
+                      ZPixmap, 0, NULL, w, h, 32, 0);
+    g_assert(im != NULL);
+
+/* this malloc is a complete waste of time on normal 32bpp
+   as reduce_depth just sets im->data = data and returns
+*/
+    scratch = g_new(RrPixel32, im->width * im->height);
+    im->data = (gchar*) scratch;
+    RrReduceDepth(inst, data, im);
+    XPutImage(RrDisplay(inst), d,
+              DefaultGC(RrDisplay(inst), RrScreen(inst)),
+              im, 0, 0, x, y, w, h);
+
+    bytes = (gulong)im->bytes_per_line * h;
+    up->paint_wire += bytes;
+    up->total_wire += bytes;
+
+    im->data = NULL;
+    XDestroyImage(im);
+    g_free(scratch);
+}
+
+void RrUploadImage32(const RrInstance *inst, Drawable d, RrPixel32 *data,
+                     gint w, gint h)
+{
+    RrUploader *up = RrInstanceUploader(inst);
+    Display *dpy = RrDisplay(inst);
+    XImage *im;
+    GC gc;
+    gulong bytes;
+
+    im = XCreateImage(dpy, RrVisual(inst), 32, ZPixmap, 0, (gchar*)data,
+                      w, h, 32, 0);
+    g_assert(im != NULL);
+    /* the data is in our byte order, let Xlib swap it if the server's is
+       different */
+    im->byte_order = (G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst);
+
+    /* the default GC is for the default depth, so it can't be used here */
+    gc = XCreateGC(dpy, d, 0, NULL);
+    XPutImage(dpy, d, gc, im, 0, 0, 0, 0, w, h);
+    XFreeGC(dpy, gc);
+
+    bytes = (gulong)im->bytes_per_line * h;
+    up->paint_wire += bytes;
+    up->total_wire += bytes;
+
+    im->data = NULL;
+    XDestroyImage(im);
+}
+
+gulong RrPaintBytesUploaded(const RrInstance *inst)
+{
+    return RrInstanceUploader(inst)->paint_wire;
+}
+
+gulong RrPaintBytesShared(const RrInstance *inst)
+{
+    return RrInstanceUploader(inst)->paint_shared;
+}
+
+guint64 RrTotalBytesUploaded(const RrInstance *inst)
+{
+    return RrInstanceUploader(inst)->total_wire;
+}
+
+guint64 RrTotalBytesShared(const RrInstance *inst)
+{
+    return RrInstanceUploader(inst)->total_shared;
+}
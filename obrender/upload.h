@@ -0,0 +1,65 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   upload.h for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __render_upload_h
+#define __render_upload_h
+
+#include "render.h"
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+typedef struct _RrUploader RrUploader;
+
+/*! Moves pixel data from the client into pixmaps on the X server.  When the
+  MIT-SHM extension is usable, the data is handed over through a small pool of
+  shared memory segments instead of being written down the X connection. */
+struct _RrUploader {
+    /*! TRUE if MIT-SHM is usable for this display */
+    gboolean shm;
+    /*! Segments that can be (or soon will be) reused, RrShmSegment*s */
+    GSList *segments;
+
+    /*! Bytes written down the X connection by the current paint */
+    gulong paint_wire;
+    /*! Bytes handed over through shared memory by the current paint */
+    gulong paint_shared;
+    /*! Bytes written down the X connection since the instance was created */
+    guint64 total_wire;
+    /*! Bytes handed over through shared memory since the instance was
+      created */
+    guint64 total_shared;
+};
+
+RrUploader* RrUploaderNew(const RrInstance *inst);
+void        RrUploaderFree(RrUploader *up, const RrInstance *inst);
+
+/*! Reset the per-paint counters, called when a new paint begins */
+void RrUploadBeginPaint(const RrInstance *inst);
+
+/*! Convert the RrPixel32 data to the visual's format and put it into the
+  drawable at x, y.  The data must be w x h pixels. */
+void RrUploadImage(const RrInstance *inst, Drawable d, RrPixel32 *data,
+                   gint x, gint y, gint w, gint h);
+
+/*! Put w x h pixels of 32 bit data into a drawable of depth 32 as they are,
+  without converting them for the visual */
+void RrUploadImage32(const RrInstance *inst, Drawable d, RrPixel32 *data,
+                     gint w, gint h);
+
+#endif
@@ -53,7 +53,18 @@ gint     obt_display_extension_sync_basep;
 
 static gint xerror_handler(Display *d, XErrorEvent *e);
 
-static gboolean xerror_ignore = FALSE;
+/*! A range of requests whose errors are ignored */
+typedef struct _ObtErrorRange {
+    gulong start;
+    gulong end; /* inclusive, only valid once the range is closed */
+    gboolean closed;
+    gboolean error; /* an error was ignored in the range */
+} ObtErrorRange;
+
+/*! The ranges which the server may still send errors for, oldest first */
+static GQueue *xerror_ranges = NULL;
+/*! The most recent range, which is kept to check for errors in it */
+static ObtErrorRange *xerror_last = NULL;
 
 gboolean obt_display_open(const char *display_name)
 {
@@ -134,15 +145,69 @@ void obt_display_close(void)
         xqueue_destroy();
         XCloseDisplay(obt_display);
     }
+    if (xerror_ranges) {
+        ObtErrorRange *r;
+
+        while ((r = g_queue_pop_head(xerror_ranges)))
+            if (r != xerror_last)
+                g_slice_free(ObtErrorRange, r);
+        g_queue_free(xerror_ranges);
+        xerror_ranges = NULL;
+    }
+    if (xerror_last) {
+        g_slice_free(ObtErrorRange, xerror_last);
+        xerror_last = NULL;
+    }
+}
+
+/*! Returns TRUE if request a was made before request b */
+static inline gboolean serial_before(gulong a, gulong b)
+{
+    return (glong)(a - b) < 0;
+}
+
+/*! Forget the ranges that the server is done with, as it can't send any
+  more errors for them */
+static void xerror_ranges_prune(void)
+{
+    const gulong done = LastKnownRequestProcessed(obt_display);
+    ObtErrorRange *r;
+
+    while ((r = g_queue_peek_head(xerror_ranges)) &&
+           r->closed && !serial_before(done, r->end))
+    {
+        g_queue_pop_head(xerror_ranges);
+        if (r != xerror_last)
+            g_slice_free(ObtErrorRange, r);
+    }
+}
+
+/*! Returns the range that the request is in, or NULL if its errors are not
+  being ignored */
+static ObtErrorRange* xerror_range_find(gulong serial)
+{
+    GList *it;
+
+    for (it = xerror_ranges ? xerror_ranges->head : NULL; it;
+         it = g_list_next(it))
+    {
+        ObtErrorRange *r = it->data;
+
+        if (!serial_before(serial, r->start) &&
+            (!r->closed || !serial_before(r->end, serial)))
+            return r;
+    }
+    return NULL;
 }
 
 static gint xerror_handler(Display *d, XErrorEvent *e)
 {
+    ObtErrorRange *r = xerror_range_find(e->serial);
 #ifdef DEBUG
     gchar errtxt[128];
 
     XGetErrorText(d, e->error_code, errtxt, 127);
-    if (!xerror_ignore) {
+    if (!r) {
         if (e->error_code == BadWindow)
             /*g_debug(_("X Error: %s\n"), errtxt)*/;
         else
@@ -150,16 +215,50 @@ static gint xerror_handler(Display *d, XErrorEvent *e)
     } else
         g_debug("Ignoring XError code %d '%s'", e->error_code, errtxt);
 #else
-    (void)d; (void)e;
+    (void)d;
 #endif
 
+    if (r) r->error = TRUE;
     obt_display_error_occured = TRUE;
     return 0;
 }
 
 void obt_display_ignore_errors(gboolean ignore)
 {
-    XSync(obt_display, FALSE);
-    xerror_ignore = ignore;
-    if (ignore) obt_display_error_occured = FALSE;
+    if (!xerror_ranges)
+        xerror_ranges = g_queue_new();
+
+    if (ignore) {
+        xerror_ranges_prune();
+
+        /* the last range is only kept until a new one begins */
+        if (xerror_last && !g_queue_find(xerror_ranges, xerror_last))
+            g_slice_free(ObtErrorRange, xerror_last);
+
+        xerror_last = g_slice_new0(ObtErrorRange);
+        xerror_last->start = NextRequest(obt_display);
+        g_queue_push_tail(xerror_ranges, xerror_last);
+        obt_display_error_occured = FALSE;
+    }
+    else if (xerror_last && !xerror_last->closed) {
+        xerror_last->end = NextRequest(obt_display) - 1;
+        xerror_last->closed = TRUE;
+        if (serial_before(xerror_last->end, xerror_last->start)) {
+            /* no requests were made in it */
+            g_queue_remove(xerror_ranges, xerror_last);
+        }
+    }
+}
+
+gboolean obt_display_ignored_error(void)
+{
+    g_return_val_if_fail(xerror_last != NULL, FALSE);
+    g_return_val_if_fail(xerror_last->closed, FALSE);
+
+    /* wait for the server to reply to all the requests in the range */
+    if (g_queue_find(xerror_ranges, xerror_last) &&
+        serial_before(LastKnownRequestProcessed(obt_display),
+                      xerror_last->end))
+        XSync(obt_display, FALSE);
+    return xerror_last->error;
 }
@@ -61,7 +61,14 @@ extern Display* obt_display;
 gboolean obt_display_open(const char *display_name);
 void     obt_display_close(void);
 
+/*! Begin (TRUE) or end (FALSE) ignoring the errors caused by the requests
+  made in between.  This does not wait for the server, the requests are
+  remembered by their serial numbers instead. */
 void     obt_display_ignore_errors(gboolean ignore);
+/*! Returns TRUE if any of the requests made while errors were last ignored
+  caused an error.  This waits for the server to process them, if it has not
+  already. */
+gboolean obt_display_ignored_error(void);
 
 #define  obt_root(screen) (RootWindow(obt_display, screen))
 
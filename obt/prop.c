@@ -21,20 +21,48 @@
 #include "obt/display.h"
 
 #include <X11/Xatom.h>
+#ifdef XCB
+#  include <X11/Xlib-xcb.h>
+#  include <xcb/xcb.h>
+#endif
 #ifdef HAVE_STRING_H
 #  include <string.h>
 #endif
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
 
 Atom prop_atoms[OBT_PROP_NUM_ATOMS];
 gboolean prop_started = FALSE;
 
-#define CREATE_NAME(var, name) (prop_atoms[OBT_PROP_##var] = \
-                                XInternAtom((obt_display), (name), FALSE))
+/* properties larger than this are not kept in the cache */
+#define CACHE_MAX_BYTES 4096
+
+/*! Maps a Window* to a GHashTable, which maps an Atom to the ObtPropRaw* for
+  the property's value on the window */
+static GHashTable *prop_cache = NULL;
+static gulong cache_hits = 0;
+static gulong cache_misses = 0;
+
+#ifdef XCB
+/*! The window whose properties have been requested by obt_prop_prefetch */
+static Window prefetch_win = None;
+/*! Maps an Atom to the xcb_get_property_cookie_t* for its request */
+static GHashTable *prefetch_cookies = NULL;
+#endif
+
+/* the atoms are collected into names and ids, and interned all together */
+#define CREATE_NAME(var, name) (ids[n] = OBT_PROP_##var, names[n++] = (name))
 #define CREATE(var) CREATE_NAME(var, #var)
 #define CREATE_(var) CREATE_NAME(var, "_" #var)
 
 void obt_prop_startup(void)
 {
+    gchar *names[OBT_PROP_NUM_ATOMS];
+    ObtPropAtom ids[OBT_PROP_NUM_ATOMS];
+    Atom atoms[OBT_PROP_NUM_ATOMS];
+    guint i, n = 0;
+
     if (prop_started) return;
     prop_started = TRUE;
 
@@ -200,6 +228,11 @@ void obt_prop_startup(void)
     CREATE_(OB_APP_GROUP_NAME);
     CREATE_(OB_APP_GROUP_CLASS);
     CREATE_(OB_APP_TYPE);
+
+    /* this sends all the requests before waiting for any replies */
+    XInternAtoms(obt_display, names, n, FALSE, atoms);
+    for (i = 0; i < n; ++i)
+        prop_atoms[ids[i]] = atoms[i];
 }
 
 Atom obt_prop_atom(ObtPropAtom a)
@@ -209,40 +242,309 @@ Atom obt_prop_atom(ObtPropAtom a)
     return prop_atoms[a];
 }
 
+void obt_prop_prefetch(Window win, const Atom *props, guint n)
+{
+#ifdef XCB
+    xcb_connection_t *conn = XGetXCBConnection(obt_display);
+    guint i;
+
+    obt_prop_prefetch_end(prefetch_win);
+
+    prefetch_win = win;
+    prefetch_cookies = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+    for (i = 0; i < n; ++i) {
+        xcb_get_property_cookie_t *c = g_new(xcb_get_property_cookie_t, 1);
+
+        /* ask for all of it, of any type, and check it when it is read */
+        *c = xcb_get_property(conn, FALSE, win, props[i],
+                              XCB_GET_PROPERTY_TYPE_ANY, 0, G_MAXUINT32 / 4);
+        g_hash_table_insert(prefetch_cookies, GUINT_TO_POINTER(props[i]), c);
+    }
+    xcb_flush(conn);
+#endif
+}
+
+#ifdef XCB
+static void prefetch_discard(gpointer key, gpointer value, gpointer data)
+{
+    xcb_get_property_cookie_t *c = value;
+
+    xcb_discard_reply(data, c->sequence);
+}
+#endif
+
+void obt_prop_prefetch_end(Window win)
+{
+#ifdef XCB
+    if (prefetch_cookies && win == prefetch_win) {
+        /* throw away the replies that nobody read */
+        g_hash_table_foreach(prefetch_cookies, prefetch_discard,
+                             XGetXCBConnection(obt_display));
+        g_hash_table_destroy(prefetch_cookies);
+        prefetch_cookies = NULL;
+        prefetch_win = None;
+    }
+#endif
+}
+
+/*! A property's value as it was read from the X server */
+typedef struct _ObtPropValue {
+    Atom type;
+    gint size;
+    gulong items;
+    /*! The value, with an extra nul byte after it */
+    guchar *data;
+    /*! TRUE when the value came from Xlib, which stores 32-bit items in
+      longs and must free the data */
+    gboolean longs;
+} ObtPropValue;
+
+/*! A whole property's value, with 32-bit items stored in 32 bits */
+typedef struct _ObtPropRaw {
+    /*! None if the window does not have the property */
+    Atom type;
+    gint format;
+    guchar *data;
+    gulong bytes;
+} ObtPropRaw;
+
+#ifdef XCB
+/*! Take the reply for a prefetched property.  Returns FALSE if the property
+  was not prefetched, and sets *ok to FALSE if the request failed. */
+static gboolean prefetch_take(Window win, Atom prop, gboolean *ok,
+                              ObtPropRaw *raw)
+{
+    xcb_connection_t *conn;
+    xcb_get_property_cookie_t *c;
+    xcb_generic_error_t *e = NULL;
+    xcb_get_property_reply_t *r;
+
+    if (!prefetch_cookies || win != prefetch_win ||
+        !(c = g_hash_table_lookup(prefetch_cookies, GUINT_TO_POINTER(prop))))
+        return FALSE;
+
+    conn = XGetXCBConnection(obt_display);
+    r = xcb_get_property_reply(conn, *c, &e);
+    g_hash_table_remove(prefetch_cookies, GUINT_TO_POINTER(prop));
+    free(e);
+
+    if ((*ok = (r != NULL))) {
+        raw->type = r->type;
+        raw->format = r->format;
+        raw->bytes = xcb_get_property_value_length(r);
+        raw->data = g_memdup(xcb_get_property_value(r), raw->bytes);
+        free(r);
+    }
+    return TRUE;
+}
+#endif
+
+/*! Read the whole property, of any type */
+static gboolean get_raw(Window win, Atom prop, ObtPropRaw *raw)
+{
+    gboolean ok;
+    guchar *xdata = NULL;
+    gulong items, bytes_left;
+
+#ifdef XCB
+    if (prefetch_take(win, prop, &ok, raw))
+        return ok;
+#endif
+
+    ok = XGetWindowProperty(obt_display, win, prop, 0l, G_MAXLONG,
+                            FALSE, AnyPropertyType, &raw->type, &raw->format,
+                            &items, &bytes_left, &xdata) == Success;
+    if (ok) {
+        raw->bytes = items * (raw->format / 8);
+        if (raw->format == 32) {
+            guint32 *d = g_new(guint32, items);
+            gulong i;
+
+            for (i = 0; i < items; ++i)
+                d[i] = ((gulong*)xdata)[i];
+            raw->data = (guchar*)d;
+        }
+        else
+            raw->data = g_memdup(xdata, raw->bytes);
+    }
+    if (xdata) XFree(xdata);
+    return ok;
+}
+
+/*! Fill out the value from a whole property, the way XGetWindowProperty
+  would for the type and length asked for */
+static void value_from_raw(const ObtPropRaw *raw, Atom type, glong num32,
+                           ObtPropValue *v)
+{
+    gulong len = raw->bytes;
+
+    v->type = raw->type;
+    v->size = raw->format;
+    if (raw->format == 0 || (type != AnyPropertyType && raw->type != type))
+        len = 0; /* the server sends nothing in this case */
+    v->items = MIN(len, (gulong)num32 * 4) /
+        (raw->format ? raw->format / 8 : 1);
+
+    /* copy it out to add the nul byte like Xlib does */
+    v->data = g_malloc(len + 1);
+    if (len) memcpy(v->data, raw->data, len);
+    v->data[len] = '\0';
+    v->longs = FALSE;
+}
+
+/* how many 32-bit elements are read at a time by
+   obt_prop_get_array32_chunked() */
+#define CHUNK_LONGS (64 * 1024)
+/* how many times obt_prop_get_array32_chunked() starts over when the property
+   changes size while it is reading it */
+#define CHUNK_TRIES 3
+
+/*! Find the cache of properties for a window, or NULL if the window's
+  properties are not cached */
+static GHashTable* cache_find(Window win)
+{
+    return prop_cache ? g_hash_table_lookup(prop_cache, &win) : NULL;
+}
+
+static void cache_raw_free(gpointer r)
+{
+    g_free(((ObtPropRaw*)r)->data);
+    g_slice_free(ObtPropRaw, r);
+}
+
+/*! Read up to num32 32-bit elements of a property.  If the property's type
+  doesn't match the one asked for (which may be AnyPropertyType), then no
+  items are returned.  The value must be freed with value_free() afterwards,
+  whether this succeeds or not. */
+static gboolean get_value(Window win, Atom prop, Atom type, glong num32,
+                          ObtPropValue *v)
+{
+    GHashTable *cache;
+    ObtPropRaw raw, *cached;
+    gulong bytes_left;
+
+    v->data = NULL;
+    v->longs = TRUE;
+
+    if ((cache = cache_find(win))) {
+        if ((cached = g_hash_table_lookup(cache, GUINT_TO_POINTER(prop)))) {
+            ++cache_hits;
+            value_from_raw(cached, type, num32, v);
+            return TRUE;
+        }
+
+        ++cache_misses;
+        if (!get_raw(win, prop, &raw))
+            return FALSE;
+        value_from_raw(&raw, type, num32, v);
+        if (raw.bytes <= CACHE_MAX_BYTES) {
+            cached = g_slice_new(ObtPropRaw);
+            *cached = raw;
+            g_hash_table_insert(cache, GUINT_TO_POINTER(prop), cached);
+        }
+        else
+            g_free(raw.data);
+        return TRUE;
+    }
+
+#ifdef XCB
+    {
+        gboolean ok;
+
+        if (prefetch_take(win, prop, &ok, &raw)) {
+            if (ok) {
+                value_from_raw(&raw, type, num32, v);
+                g_free(raw.data);
+            }
+            return ok;
+        }
+    }
+#endif
+
+    return XGetWindowProperty(obt_display, win, prop, 0l, num32,
+                              FALSE, type, &v->type, &v->size,
+                              &v->items, &bytes_left, &v->data) == Success;
+}
+
+void obt_prop_cache_window(Window win, gboolean cache)
+{
+    if (cache) {
+        Window *w;
+
+        if (!prop_cache)
+            prop_cache = g_hash_table_new_full(g_int_hash, g_int_equal,
+                                               g_free, (GDestroyNotify)
+                                               g_hash_table_destroy);
+        if (cache_find(win)) return;
+
+        w = g_new(Window, 1);
+        *w = win;
+        g_hash_table_insert(prop_cache, w,
+                            g_hash_table_new_full(g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL, cache_raw_free));
+    }
+    else if (prop_cache)
+        g_hash_table_remove(prop_cache, &win);
+}
+
+void obt_prop_cache_invalidate(Window win, Atom prop)
+{
+    GHashTable *cache;
+
+    if ((cache = cache_find(win)))
+        g_hash_table_remove(cache, GUINT_TO_POINTER(prop));
+}
+
+void obt_prop_cache_stats(gulong *hits, gulong *misses)
+{
+    *hits = cache_hits;
+    *misses = cache_misses;
+}
+
+static void value_free(ObtPropValue *v)
+{
+    if (!v->data)
+        return;
+    if (v->longs)
+        XFree(v->data);
+    else
+        g_free(v->data);
+}
+
+static guint32 value_item32(ObtPropValue *v, gulong i)
+{
+    return v->longs ? ((gulong*)v->data)[i] : ((guint32*)v->data)[i];
+}
+
 static gboolean get_prealloc(Window win, Atom prop, Atom type, gint size,
                              guchar *data, gulong num)
 {
     gboolean ret = FALSE;
-    gint res;
-    guchar *xdata = NULL;
-    Atom ret_type;
-    gint ret_size;
-    gulong ret_items, bytes_left;
+    ObtPropValue v;
     glong num32 = 32 / size * num; /* num in 32-bit elements */
 
-    res = XGetWindowProperty(obt_display, win, prop, 0l, num32,
-                             FALSE, type, &ret_type, &ret_size,
-                             &ret_items, &bytes_left, &xdata);
-    if (res == Success && ret_items && xdata) {
-        if (ret_size == size && ret_items >= num) {
+    if (get_value(win, prop, type, num32, &v)) {
+        if (v.items && v.data && v.size == size && v.items >= num) {
             guint i;
             for (i = 0; i < num; ++i)
                 switch (size) {
                 case 8:
-                    data[i] = xdata[i];
+                    data[i] = v.data[i];
                     break;
                 case 16:
-                    ((guint16*)data)[i] = ((gushort*)xdata)[i];
+                    ((guint16*)data)[i] = ((gushort*)v.data)[i];
                     break;
                 case 32:
-                    ((guint32*)data)[i] = ((gulong*)xdata)[i];
+                    ((guint32*)data)[i] = value_item32(&v, i);
                     break;
                 default:
                     g_assert_not_reached(); /* unhandled size */
                 }
             ret = TRUE;
         }
-        XFree(xdata);
+        value_free(&v);
     }
     return ret;
 }
@@ -251,38 +553,31 @@ static gboolean get_all(Window win, Atom prop, Atom type, gint size,
                         guchar **data, guint *num)
 {
     gboolean ret = FALSE;
-    gint res;
-    guchar *xdata = NULL;
-    Atom ret_type;
-    gint ret_size;
-    gulong ret_items, bytes_left;
+    ObtPropValue v;
 
-    res = XGetWindowProperty(obt_display, win, prop, 0l, G_MAXLONG,
-                             FALSE, type, &ret_type, &ret_size,
-                             &ret_items, &bytes_left, &xdata);
-    if (res == Success) {
-        if (ret_size == size && ret_items > 0) {
+    if (get_value(win, prop, type, G_MAXLONG, &v)) {
+        if (v.size == size && v.items > 0) {
             guint i;
 
-            *data = g_malloc(ret_items * (size / 8));
-            for (i = 0; i < ret_items; ++i)
+            *data = g_malloc(v.items * (size / 8));
+            for (i = 0; i < v.items; ++i)
                 switch (size) {
                 case 8:
-                    (*data)[i] = xdata[i];
+                    (*data)[i] = v.data[i];
                     break;
                 case 16:
-                    ((guint16*)*data)[i] = ((gushort*)xdata)[i];
+                    ((guint16*)*data)[i] = ((gushort*)v.data)[i];
                     break;
                 case 32:
-                    ((guint32*)*data)[i] = ((gulong*)xdata)[i];
+                    ((guint32*)*data)[i] = value_item32(&v, i);
                     break;
                 default:
                     g_assert_not_reached(); /* unhandled size */
                 }
-            *num = ret_items;
+            *num = v.items;
             ret = TRUE;
         }
-        XFree(xdata);
+        value_free(&v);
     }
     return ret;
 }
@@ -291,15 +586,24 @@ static gboolean get_all(Window win, Atom prop, Atom type, gint size,
   @param win The window to read the property from.
   @param prop The atom of the property to read off the window.
   @param tprop The XTextProperty to fill out.
+  @param v Holds the value that tprop points into.  It must be freed with
+    value_free() afterwards, whether this succeeds or not.
   @param type 0 to get text of any type, or a value from
     ObtPropTextType to restrict the value to a specific type.
   @return TRUE if the text was read and validated against the @type, and FALSE
     otherwise.
 */
 static gboolean get_text_property(Window win, Atom prop,
-                                  XTextProperty *tprop, ObtPropTextType type)
+                                  XTextProperty *tprop, ObtPropValue *v,
+                                  ObtPropTextType type)
 {
-    if (!(XGetTextProperty(obt_display, win, tprop, prop) && tprop->nitems))
+    if (!get_value(win, prop, AnyPropertyType, G_MAXLONG, v))
+        return FALSE;
+    tprop->value = v->data;
+    tprop->encoding = v->type;
+    tprop->format = v->size;
+    tprop->nitems = v->items;
+    if (!(tprop->value && tprop->nitems))
         return FALSE;
     if (!type)
         return TRUE; /* no type checking */
@@ -481,14 +785,117 @@ gboolean obt_prop_get_array32(Window win, Atom prop, Atom type, guint32 **ret,
     return get_all(win, prop, type, 32, (guchar**)ret, nret);
 }
 
+gboolean obt_prop_get_array32_chunked(Window win, Atom prop, Atom type,
+                                      guint32 **ret, guint *nret)
+{
+    guint tries;
+
+    for (tries = 0; tries < CHUNK_TRIES; ++tries) {
+        guint32 *data = NULL;
+        gulong total = 0, offset = 0;
+        gboolean changed = FALSE;
+
+        do {
+            Atom ret_type;
+            gint ret_size;
+            gulong ret_items, bytes_left, i;
+            guchar *xdata;
+
+            if (XGetWindowProperty(obt_display, win, prop, offset,
+                                   CHUNK_LONGS, FALSE, type, &ret_type,
+                                   &ret_size, &ret_items, &bytes_left,
+                                   &xdata) != Success)
+            {
+                g_free(data);
+                return FALSE;
+            }
+
+            if (ret_size != 32 || ret_items == 0) {
+                /* it's gone, or not what we're looking for */
+                if (xdata) XFree(xdata);
+                changed = offset > 0;
+                break;
+            }
+
+            if (offset == 0) {
+                total = ret_items + bytes_left / 4;
+                data = g_new(guint32, total);
+            }
+            else if (offset + ret_items + bytes_left / 4 != total) {
+                /* the property changed size part way through reading it.
+                   a change that keeps the size can't be seen here, the
+                   caller gets a PropertyNotify for it and reads again */
+                XFree(xdata);
+                changed = TRUE;
+                break;
+            }
+
+            for (i = 0; i < ret_items; ++i)
+                data[offset + i] = ((gulong*)xdata)[i];
+            offset += ret_items;
+            XFree(xdata);
+        } while (offset < total);
+
+        if (!changed) {
+            if (!data) return FALSE;
+            *ret = data;
+            *nret = total;
+            return TRUE;
+        }
+        g_free(data);
+    }
+    return FALSE;
+}
+
+gboolean obt_prop_exists(Window win, Atom prop)
+{
+    Atom ret_type;
+    gint ret_size;
+    gulong ret_items, bytes_left;
+    guchar *xdata = NULL;
+
+    /* ask for none of the data, only whether it is there */
+    if (XGetWindowProperty(obt_display, win, prop, 0l, 0l, FALSE,
+                           AnyPropertyType, &ret_type, &ret_size, &ret_items,
+                           &bytes_left, &xdata) != Success)
+        return FALSE;
+    if (xdata) XFree(xdata);
+    return ret_type != None;
+}
+
+gboolean obt_prop_get_head32(Window win, Atom prop, Atom type, guint32 *ret,
+                             guint n, guint *total)
+{
+    Atom ret_type;
+    gint ret_size;
+    gulong ret_items, bytes_left, i;
+    guchar *xdata = NULL;
+
+    if (XGetWindowProperty(obt_display, win, prop, 0l, n, FALSE, type,
+                           &ret_type, &ret_size, &ret_items, &bytes_left,
+                           &xdata) != Success)
+        return FALSE;
+    if (ret_size != 32) {
+        if (xdata) XFree(xdata);
+        return FALSE;
+    }
+
+    for (i = 0; i < ret_items && i < n; ++i)
+        ret[i] = ((gulong*)xdata)[i];
+    *total = ret_items + bytes_left / 4;
+    if (xdata) XFree(xdata);
+    return TRUE;
+}
+
 gboolean obt_prop_get_text(Window win, Atom prop, ObtPropTextType type,
                            gchar **ret_string)
 {
     XTextProperty tprop;
+    ObtPropValue v;
     gchar *str;
     gboolean ret = FALSE;
 
-    if (get_text_property(win, prop, &tprop, type)) {
+    if (get_text_property(win, prop, &tprop, &v, type)) {
         str = (gchar*)convert_text_property(&tprop, type, 1);
 
         if (str) {
@@ -496,7 +903,7 @@ gboolean obt_prop_get_text(Window win, Atom prop, ObtPropTextType type,
             ret = TRUE;
         }
     }
-    XFree(tprop.value);
+    value_free(&v);
     return ret;
 }
 
@@ -505,10 +912,11 @@ gboolean obt_prop_get_array_text(Window win, Atom prop,
                                  gchar ***ret_strings)
 {
     XTextProperty tprop;
+    ObtPropValue v;
     gchar **strs;
     gboolean ret = FALSE;
 
-    if (get_text_property(win, prop, &tprop, type)) {
+    if (get_text_property(win, prop, &tprop, &v, type)) {
         strs = (gchar**)convert_text_property(&tprop, type, -1);
 
         if (strs) {
@@ -516,12 +924,13 @@ gboolean obt_prop_get_array_text(Window win, Atom prop,
             ret = TRUE;
         }
     }
-    XFree(tprop.value);
+    value_free(&v);
     return ret;
 }
 
 void obt_prop_set32(Window win, Atom prop, Atom type, gulong val)
 {
+    obt_prop_cache_invalidate(win, prop);
     XChangeProperty(obt_display, win, prop, type, 32, PropModeReplace,
                     (guchar*)&val, 1);
 }
@@ -529,12 +938,40 @@ void obt_prop_set32(Window win, Atom prop, Atom type, gulong val)
 void obt_prop_set_array32(Window win, Atom prop, Atom type, gulong *val,
                       guint num)
 {
+    obt_prop_cache_invalidate(win, prop);
     XChangeProperty(obt_display, win, prop, type, 32, PropModeReplace,
                     (guchar*)val, num);
 }
 
+gboolean obt_prop_update_array32(Window win, Atom prop, Atom type,
+                                 GArray *old, gulong *val, guint num)
+{
+    gboolean append;
+
+    /* when nothing has been set yet, replace whatever was left on the window
+       by someone else */
+    append = old->len > 0 && num >= old->len &&
+        !memcmp(old->data, val, old->len * sizeof(gulong));
+
+    if (append && num == old->len)
+        return FALSE; /* it hasn't changed */
+
+    obt_prop_cache_invalidate(win, prop);
+    if (append)
+        XChangeProperty(obt_display, win, prop, type, 32, PropModeAppend,
+                        (guchar*)(val + old->len), num - old->len);
+    else
+        XChangeProperty(obt_display, win, prop, type, 32, PropModeReplace,
+                        (guchar*)val, num);
+
+    g_array_set_size(old, 0);
+    g_array_append_vals(old, val, num);
+    return TRUE;
+}
+
 void obt_prop_set_text(Window win, Atom prop, const gchar *val)
 {
+    obt_prop_cache_invalidate(win, prop);
     XChangeProperty(obt_display, win, prop, OBT_PROP_ATOM(UTF8_STRING), 8,
                     PropModeReplace, (const guchar*)val, strlen(val));
 }
@@ -549,6 +986,7 @@ void obt_prop_set_array_text(Window win, Atom prop, const gchar *const *strs)
         str = g_string_append(str, *s);
         str = g_string_append_c(str, '\0');
     }
+    obt_prop_cache_invalidate(win, prop);
     XChangeProperty(obt_display, win, prop, OBT_PROP_ATOM(UTF8_STRING), 8,
                     PropModeReplace, (guchar*)str->str, str->len);
     g_string_free(str, TRUE);
@@ -556,6 +994,7 @@ void obt_prop_set_array_text(Window win, Atom prop, const gchar *const *strs)
 
 void obt_prop_erase(Window win, Atom prop)
 {
+    obt_prop_cache_invalidate(win, prop);
     XDeleteProperty(obt_display, win, prop);
 }
 
@@ -246,10 +246,56 @@ typedef enum {
     OBT_PROP_TEXT_UTF8_STRING = 5,
 } ObtPropTextType;
 
+/*! Send the requests to read a window's properties all at once, without
+  waiting for any replies.  The replies are collected by the obt_prop_get
+  functions when they read these properties from the window, so reading all
+  of them costs about one round trip to the X server instead of one each.
+  Only properties that are not changed before they are read should be
+  prefetched.  This does nothing when Openbox is built without XCB.
+*/
+void obt_prop_prefetch(Window win, const Atom *props, guint n);
+/*! Throw away the replies for properties prefetched from the window which
+  were not read */
+void obt_prop_prefetch_end(Window win);
+
+/*! Keep (TRUE) or stop keeping (FALSE) a cache of the window's properties,
+  so that reading one again does not go to the X server until it changes.
+  PropertyChangeMask must be selected on the window while it is cached, as
+  the PropertyNotify events are what remove changed values from the cache.
+*/
+void obt_prop_cache_window(Window win, gboolean cache);
+/*! Remove a property's value from the cache, because it has changed */
+void obt_prop_cache_invalidate(Window win, Atom prop);
+/*! Get the number of property reads that were answered from the cache, and
+  the number that had to go to the X server, for cached windows */
+void obt_prop_cache_stats(gulong *hits, gulong *misses);
+
 gboolean obt_prop_get32(Window win, Atom prop, Atom type, guint32 *ret);
 gboolean obt_prop_get_array32(Window win, Atom prop, Atom type, guint32 **ret,
                               guint *nret);
 
+/*! Like obt_prop_get_array32, but for properties which can be very large.
+  The property is read in pieces of a bounded size, so that no single request
+  ties up the X server, and without grabbing the server.  It is read straight
+  from the window, and never from the cache.  If the property changes size
+  part way through, it is read again from the start, and this gives up and
+  returns FALSE if that keeps happening.  A property replaced by one of the
+  same size is not noticed, and the value returned may mix the two, so the
+  caller must read it again when the PropertyNotify for the change arrives.
+*/
+gboolean obt_prop_get_array32_chunked(Window win, Atom prop, Atom type,
+                                      guint32 **ret, guint *nret);
+/*! Returns TRUE if the property is set on the window, asking the X server
+  directly rather than using the cache */
+gboolean obt_prop_exists(Window win, Atom prop);
+/*! Read only the start of a property, asking the X server directly rather
+  than using the cache.  Up to n 32-bit elements are placed in ret, and the
+  number of elements in the whole property is placed in total.  Returns
+  FALSE if the property is not set with the given type.
+*/
+gboolean obt_prop_get_head32(Window win, Atom prop, Atom type, guint32 *ret,
+                             guint n, guint *total);
+
 gboolean obt_prop_get_text(Window win, Atom prop, ObtPropTextType type,
                            gchar **ret);
 gboolean obt_prop_get_array_text(Window win, Atom prop,
@@ -259,6 +305,16 @@ gboolean obt_prop_get_array_text(Window win, Atom prop,
 void obt_prop_set32(Window win, Atom prop, Atom type, gulong val);
 void obt_prop_set_array32(Window win, Atom prop, Atom type, gulong *val,
                           guint num);
+/*! Changes a 32-bit array property to hold the num values in val, where old
+  holds the values that were last set on it.  When the new values only add to
+  the end of the old ones, just the new values are appended to the property,
+  and when they are the same as the old ones nothing is sent at all.  old is
+  updated to hold the new values.
+  @param old A GArray of gulongs, which is empty if nothing has been set yet
+  @return TRUE if the property was changed
+*/
+gboolean obt_prop_update_array32(Window win, Atom prop, Atom type,
+                                 GArray *old, gulong *val, guint num);
 void obt_prop_set_text(Window win, Atom prop, const gchar *str);
 void obt_prop_set_array_text(Window win, Atom prop, const gchar *const *strs);
 
@@ -301,6 +357,16 @@ void obt_prop_message_to(Window to, Window about, Atom messagetype,
 #define OBT_PROP_SETA32(win, prop, type, val, num) \
     (obt_prop_set_array32(win, OBT_PROP_ATOM(prop), OBT_PROP_ATOM(type), \
                           val, num))
+#define OBT_PROP_UPDATEA32(win, prop, type, old, val, num) \
+    (obt_prop_update_array32(win, OBT_PROP_ATOM(prop), OBT_PROP_ATOM(type), \
+                             old, val, num))
+#define OBT_PROP_GETA32_CHUNKED(win, prop, type, ret, nret) \
+    (obt_prop_get_array32_chunked(win, OBT_PROP_ATOM(prop), \
+                                  OBT_PROP_ATOM(type), ret, nret))
+#define OBT_PROP_EXISTS(win, prop) (obt_prop_exists(win, OBT_PROP_ATOM(prop)))
+#define OBT_PROP_GETHEAD32(win, prop, type, ret, n, total) \
+    (obt_prop_get_head32(win, OBT_PROP_ATOM(prop), OBT_PROP_ATOM(type), \
+                         ret, n, total))
 #define OBT_PROP_SETS(win, prop, val) \
     (obt_prop_set_text(win, OBT_PROP_ATOM(prop), val))
 #define OBT_PROP_SETSS(win, prop, strs) \
@@ -0,0 +1,103 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O2 -o ./xqueuebench `pkg-config --cflags --libs obt-3.5` \
+  xqueuebench.c && \
+./xqueuebench
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   xqueuebench.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "obt/display.h"
+#include "obt/xqueue.h"
+#include <glib.h>
+#include <stdio.h>
+
+/* pushes a burst of synthetic events through the queue, and handles them the
+   way openbox does, looking ahead in the queue for each one */
+
+#define NUM_EVENTS 100000
+#define NUM_WINDOWS 100
+
+static gboolean match_property(XEvent *e, gpointer data)
+{
+    return e->xproperty.atom == *(Atom*)data;
+}
+
+int main()
+{
+    XEvent e, ce;
+    GTimer *t;
+    gulong i, handled, skipped, collapsed;
+
+    if (!obt_display_open(NULL)) {
+        printf("unable to open the display\n");
+        return 1;
+    }
+
+    /* XPutBackEvent puts them at the front of the queue, so the first one
+       put back is the last one read */
+    for (i = 0; i < NUM_EVENTS; ++i) {
+        e.xany.type = (i % 3 == 0 ? MotionNotify : PropertyNotify);
+        e.xany.serial = i;
+        e.xany.send_event = TRUE;
+        e.xany.display = obt_display;
+        e.xany.window = 1 + i % NUM_WINDOWS;
+        if (e.type == PropertyNotify) {
+            e.xproperty.atom = 1 + i % 7;
+            e.xproperty.state = PropertyNewValue;
+        }
+        XPutBackEvent(obt_display, &e);
+    }
+
+    t = g_timer_new();
+    handled = skipped = collapsed = 0;
+    while (xqueue_next_local(&e)) {
+        ++handled;
+        if (e.type == PropertyNotify) {
+            /* look for a later change to the same property */
+            if (xqueue_exists_local_for(e.xproperty.window, PropertyNotify,
+                                        match_property, &e.xproperty.atom))
+                ++skipped;
+        }
+        else if (e.type == MotionNotify) {
+            ObtXQueueWindowType wt;
+
+            /* collapse the motion events for the window */
+            wt.window = e.xmotion.window;
+            wt.type = MotionNotify;
+            while (xqueue_remove_local(&ce, xqueue_match_window_type, &wt))
+                ++collapsed;
+        }
+    }
+    g_timer_stop(t);
+
+    printf("%lu events: %lu handled, %lu property changes skipped, "
+           "%lu motions collapsed\n",
+           (gulong)NUM_EVENTS, handled, skipped, collapsed);
+    printf("%.3f seconds, %.3f usec per event\n",
+           g_timer_elapsed(t, NULL),
+           g_timer_elapsed(t, NULL) * G_USEC_PER_SEC / NUM_EVENTS);
+
+    g_timer_destroy(t);
+    obt_display_close();
+    return 0;
+}
@@ -0,0 +1,92 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O0 -o ./xqueuetest `pkg-config --cflags --libs obt-3.5` \
+  xqueuetest.c && \
+./xqueuetest
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   xqueuetest.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "obt/xqueue.h"
+#include <string.h>
+
+static XEvent configure_request(unsigned long mask, Window above, int detail)
+{
+    XEvent e;
+
+    memset(&e, 0, sizeof(e));
+    e.xconfigurerequest.type = ConfigureRequest;
+    e.xconfigurerequest.window = 1;
+    e.xconfigurerequest.value_mask = mask;
+    e.xconfigurerequest.above = above;
+    e.xconfigurerequest.detail = detail;
+    return e;
+}
+
+int main() {
+    XEvent q, e;
+
+    /* only ever merged with the request right before it */
+    q = configure_request(CWX, None, Above);
+    e = configure_request(CWY, None, Above);
+    g_assert(!xqueue_coalesce_configure_request(&q, &e, FALSE, NULL));
+
+    /* values the new request doesn't set are kept from the old one */
+    q = configure_request(CWX | CWWidth, None, Above);
+    q.xconfigurerequest.x = 10;
+    q.xconfigurerequest.width = 20;
+    e = configure_request(CWX, None, Above);
+    e.xconfigurerequest.x = 30;
+    g_assert(xqueue_coalesce_configure_request(&q, &e, TRUE, NULL));
+    g_assert(e.xconfigurerequest.value_mask == (CWX | CWWidth));
+    g_assert(e.xconfigurerequest.x == 30);
+    g_assert(e.xconfigurerequest.width == 20);
+
+    /* the sibling and stack mode are taken from the old request when the
+       new one has neither */
+    q = configure_request(CWSibling | CWStackMode, 5, Below);
+    e = configure_request(CWX, None, Above);
+    g_assert(xqueue_coalesce_configure_request(&q, &e, TRUE, NULL));
+    g_assert(e.xconfigurerequest.value_mask ==
+             (CWX | CWSibling | CWStackMode));
+    g_assert(e.xconfigurerequest.above == 5);
+    g_assert(e.xconfigurerequest.detail == Below);
+
+    /* a stack mode alone restacks against every window, so it must not
+       pick up the sibling from the old request */
+    q = configure_request(CWSibling | CWStackMode, 5, Below);
+    e = configure_request(CWStackMode, None, Above);
+    g_assert(xqueue_coalesce_configure_request(&q, &e, TRUE, NULL));
+    g_assert(e.xconfigurerequest.value_mask == CWStackMode);
+    g_assert(e.xconfigurerequest.above == None);
+    g_assert(e.xconfigurerequest.detail == Above);
+
+    /* and the other way around */
+    q = configure_request(CWStackMode, None, Below);
+    e = configure_request(CWSibling, 7, Above);
+    g_assert(xqueue_coalesce_configure_request(&q, &e, TRUE, NULL));
+    g_assert(e.xconfigurerequest.value_mask == CWSibling);
+    g_assert(e.xconfigurerequest.above == 7);
+
+    g_print("ok\n");
+    return 0;
+}
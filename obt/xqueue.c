@@ -18,80 +18,307 @@
 
 #include "obt/xqueue.h"
 #include "obt/display.h"
+#include "obt/prop.h"
 
 #define MINSZ 16
 
-static XEvent *q = NULL;
-static gulong qsz = 0;
-static gulong qstart; /* the first event in the queue */
-static gulong qend; /* the last event in the queue */
-static gulong qnum = 0;
+/*! An event in the queue.  Events removed from the middle of the queue are
+  only marked as dead, and their slot is reused once everything before them
+  has been removed too. */
+typedef struct _ObtXQueueSlot {
+    XEvent e;
+    gboolean live;
+    ObtXQueuePriority priority;
+    /*! When the event was read from the server, in microseconds */
+    gint64 queued;
+} ObtXQueueSlot;
+
+/*! The key for the events of one type which are for one window */
+typedef struct _ObtXQueueKey {
+    Window window;
+    gint type;
+} ObtXQueueKey;
+
+/* the queue is a ring buffer indexed by sequence numbers, event number s is
+   kept in q[s & (qsz-1)] */
+static ObtXQueueSlot *q = NULL;
+static gulong qsz = 0; /* always a power of 2 */
+static gulong qhead; /* the sequence number of the first event in the queue */
+static gulong qtail; /* the sequence number the next event will get */
+static gulong qnum = 0; /* the number of live events in the queue */
+
+/* maps an ObtXQueueKey* to a GQueue of the sequence numbers of the events
+   for that window and type, in the order they are in the queue */
+static GHashTable *index_window_type = NULL;
+/* maps an event type to a GQueue of the sequence numbers of the events of
+   that type, in the order they are in the queue */
+static GHashTable *index_type = NULL;
+/* maps a Window to a GQueue of the sequence numbers of the events for that
+   window, in the order they are in the queue */
+static GHashTable *index_window = NULL;
+/* the sequence numbers of the events in each priority class above
+   OBT_XQUEUE_PRIORITY_NORMAL, in the order they are in the queue */
+static GQueue *index_priority[OBT_XQUEUE_NUM_PRIORITIES];
+
+/* the priority class of each event type */
+#define NUM_TYPES 128
+static ObtXQueuePriority type_priority[NUM_TYPES];
+static ObtXQueueWaitStats wait_stats[OBT_XQUEUE_NUM_PRIORITIES];
+
+#define SLOT(s) (&q[(s) & (qsz - 1)])
+#define SEQ_TO_POINTER(s) GSIZE_TO_POINTER(s)
+#define POINTER_TO_SEQ(p) ((gulong)GPOINTER_TO_SIZE(p))
+
+static guint key_hash(gconstpointer k)
+{
+    const ObtXQueueKey *key = k;
+    return (guint)key->window * 31 + key->type;
+}
 
-static inline void shrink(void) {
-    if (qsz > MINSZ && qnum < qsz / 4) {
-        const gulong newsz = qsz/2;
-        gulong i;
+static gboolean key_equal(gconstpointer a, gconstpointer b)
+{
+    const ObtXQueueKey *ka = a, *kb = b;
+    return ka->window == kb->window && ka->type == kb->type;
+}
 
-        if (qnum == 0) {
-            qstart = 0;
-            qend = -1;
-        }
+static void key_free(gpointer k)
+{
+    g_slice_free(ObtXQueueKey, k);
+}
 
-        /* all in the shinking part, move it to pos 0 */
-        else if (qstart >= newsz && qend >= newsz) {
-            for (i = 0; i < qnum; ++i)
-                q[i] = q[qstart+i];
-            qstart = 0;
-            qend = qnum - 1;
-        }
+static void list_free(gpointer l)
+{
+    g_queue_free(l);
+}
 
-        /* it wraps around to 0 right now, move the part between newsz and qsz
-           to be before newsz */
-        else if (qstart >= newsz) {
-            const gulong n = qsz - qstart;
-            for (i = 0; i < n; ++i)
-                q[newsz-n+i] = q[qstart+i];
-            qstart = newsz-n;
-        }
+static inline gboolean seq_live(gulong s)
+{
+    return s - qhead < qtail - qhead && SLOT(s)->live;
+}
+
+/*! The window an event is about, which may be different from the window it
+  was delivered to, such as a child window unmapping for an UnmapNotify
+  delivered to its parent */
+static Window event_subject(const XEvent *e)
+{
+    switch (e->type) {
+    case CreateNotify:     return e->xcreatewindow.window;
+    case DestroyNotify:    return e->xdestroywindow.window;
+    case UnmapNotify:      return e->xunmap.window;
+    case MapNotify:        return e->xmap.window;
+    case MapRequest:       return e->xmaprequest.window;
+    case ReparentNotify:   return e->xreparent.window;
+    case ConfigureNotify:  return e->xconfigure.window;
+    case ConfigureRequest: return e->xconfigurerequest.window;
+    case GravityNotify:    return e->xgravity.window;
+    case CirculateNotify:  return e->xcirculate.window;
+    case CirculateRequest: return e->xcirculaterequest.window;
+    default:               return e->xany.window;
+    }
+}
 
-        /* it needs to wrap around to 0, move the stuff after newsz to pos 0 */
-        else if (qend >= newsz) {
-            const gulong n = qend + 1 - newsz;
-            for (i = 0; i < n; ++i)
-                q[i] = q[newsz+i];
-            qend = n - 1;
+static void index_add(GHashTable *t, gpointer key, gulong s)
+{
+    GQueue *l;
+
+    if (!(l = g_hash_table_lookup(t, key))) {
+        l = g_queue_new();
+        if (t == index_window_type) {
+            ObtXQueueKey *k = g_slice_new(ObtXQueueKey);
+            *k = *(ObtXQueueKey*)key;
+            key = k;
         }
+        g_hash_table_insert(t, key, l);
+    }
+    g_queue_push_tail(l, SEQ_TO_POINTER(s));
+}
 
-        q = g_renew(XEvent, q, newsz);
-        qsz = newsz;
+/*! Drop the removed events from the front of the list */
+static void list_trim(GQueue *l)
+{
+    while (!g_queue_is_empty(l) &&
+           !seq_live(POINTER_TO_SEQ(g_queue_peek_head(l))))
+        g_queue_pop_head(l);
+}
+
+/*! Find the list in the index, after dropping the removed events from its
+  front.  Lists that become empty are removed from the index. */
+static GQueue* index_lookup(GHashTable *t, gconstpointer key)
+{
+    GQueue *l;
+
+    if (!(l = g_hash_table_lookup(t, key)))
+        return NULL;
+    list_trim(l);
+    if (g_queue_is_empty(l)) {
+        g_hash_table_remove(t, key);
+        return NULL;
     }
+    return l;
+}
+
+/*! Call @func for each index list that the event is in */
+static void index_foreach_key(const XEvent *e,
+                              void (*func)(GHashTable *t, gpointer key,
+                                           gulong s),
+                              gulong s)
+{
+    ObtXQueueKey k;
+    Window subject;
+
+    k.window = e->xany.window;
+    k.type = e->type;
+    func(index_window_type, &k, s);
+    func(index_window, GSIZE_TO_POINTER(k.window), s);
+    if ((subject = event_subject(e)) != k.window) {
+        k.window = subject;
+        func(index_window_type, &k, s);
+        func(index_window, GSIZE_TO_POINTER(k.window), s);
+    }
+    func(index_type, GINT_TO_POINTER(e->type), s);
+}
+
+static void index_trim(GHashTable *t, gpointer key, gulong s)
+{
+    index_lookup(t, key);
+}
+
+/*! Copy the events into a new buffer of the given size */
+static void resize(gulong newsz)
+{
+    ObtXQueueSlot *newq = g_new(ObtXQueueSlot, newsz);
+    gulong s;
+
+    for (s = qhead; s != qtail; ++s)
+        newq[s & (newsz - 1)] = *SLOT(s);
+    g_free(q);
+    q = newq;
+    qsz = newsz;
+}
+
+static inline void shrink(void) {
+    if (qsz > MINSZ && qtail - qhead < qsz / 4)
+        resize(qsz / 2);
 }
 
 static inline void grow(void) {
-    if (qnum == qsz) {
-        const gulong newsz = qsz*2;
-        gulong i;
- 
-        q = g_renew(XEvent, q, newsz);
-
-        g_assert(qnum > 0);
-
-        if (qend < qstart) { /* it wraps around to 0 right now */
-            for (i = 0; i <= qend; ++i)
-                q[qsz+i] = q[i];
-            qend = qsz + qend;
+    if (qtail - qhead == qsz)
+        resize(qsz * 2);
+}
+
+typedef struct _ObtXQueueCoalesce {
+    gint type;
+    /*! Only the last event in the queue can be replaced */
+    gboolean adjacent;
+    ObtXQueueCoalesceFunc func;
+    gpointer data;
+    gulong dropped;
+} ObtXQueueCoalesce;
+
+static ObtXQueueCoalesce *coalesce = NULL;
+static guint n_coalesce = 0;
+
+static void pop(const gulong s);
+
+/*! Look for an event still in the queue which the new event makes redundant,
+  and remove it.  The new event may be changed to carry over anything from
+  the event it replaces. */
+static void coalesce_event(XEvent *e)
+{
+    ObtXQueueCoalesce *c = NULL;
+    ObtXQueueKey k;
+    GQueue *l;
+    GList *it;
+    guint i;
+
+    for (i = 0; i < n_coalesce && !c; ++i)
+        if (coalesce[i].type == e->type)
+            c = &coalesce[i];
+    if (!c) return;
+
+    k.window = event_subject(e);
+    k.type = e->type;
+
+    if (c->adjacent) {
+        /* only the event at the end of the queue can be replaced, so don't
+           look any further back */
+        const gulong s = qtail - 1;
+        XEvent *queued = &SLOT(s)->e;
+
+        if (qtail != qhead && seq_live(s) && queued->type == e->type &&
+            queued->xany.window == e->xany.window &&
+            event_subject(queued) == k.window &&
+            c->func(queued, e, TRUE, c->data))
+        {
+            ++c->dropped;
+            pop(s);
         }
+        return;
+    }
 
-        qsz = newsz;
+    if (!(l = index_lookup(index_window_type, &k)))
+        return;
+
+    /* look back through the window's events of the type until one can be
+       replaced.  coalescing keeps at most one queued event for each thing a
+       rule matches on, such as each property, so this doesn't go far */
+    for (it = l->tail; it; it = g_list_previous(it)) {
+        const gulong s = POINTER_TO_SEQ(it->data);
+        XEvent *queued = &SLOT(s)->e;
+
+        if (!seq_live(s) ||
+            queued->xany.window != e->xany.window ||
+            event_subject(queued) != k.window)
+            continue;
+        if (c->func(queued, e, s + 1 == qtail, c->data)) {
+            ++c->dropped;
+            pop(s);
+            break;
+        }
     }
 }
 
-/* Grab all pending X events */
-static gboolean read_events(gboolean block)
+static gint64 now_usec(void)
+{
+    GTimeVal now;
+
+    g_get_current_time(&now);
+    return (gint64)now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+}
+
+static void push(XEvent *e)
+{
+    ObtXQueueSlot *slot;
+
+    /* the property cache must not give out the old value once the change
+       has been seen */
+    if (e->type == PropertyNotify)
+        obt_prop_cache_invalidate(e->xproperty.window, e->xproperty.atom);
+
+    coalesce_event(e);
+
+    grow(); /* make sure there is room */
+
+    slot = SLOT(qtail);
+    slot->e = *e;
+    slot->live = TRUE;
+    slot->priority = (e->type >= 0 && e->type < NUM_TYPES ?
+                      type_priority[e->type] : OBT_XQUEUE_PRIORITY_NORMAL);
+    slot->queued = now_usec();
+    index_foreach_key(e, index_add, qtail);
+    if (slot->priority != OBT_XQUEUE_PRIORITY_NORMAL)
+        g_queue_push_tail(index_priority[slot->priority],
+                          SEQ_TO_POINTER(qtail));
+    ++qtail;
+    ++qnum;
+}
+
+/* Grab the pending X events, mode is passed to XEventsQueued */
+static gboolean read_events_mode(gboolean block, gint mode)
 {
     gint sth, n;
 
-    n = XEventsQueued(obt_display, QueuedAfterFlush) > 0;
+    n = XEventsQueued(obt_display, mode);
     sth = FALSE;
 
     while ((block && !sth) || n > 0) {
@@ -100,11 +327,7 @@ static gboolean read_events(gboolean block)
         if (XNextEvent(obt_display, &e) != Success)
             return FALSE;
 
-        grow(); /* make sure there is room */
-
-        ++qnum;
-        qend = (qend + 1) % qsz; /* move the end */
-        q[qend] = e; /* stick the event at the end */
+        push(&e); /* stick the event at the end */
 
         --n;
         sth = TRUE;
@@ -113,64 +336,146 @@ static gboolean read_events(gboolean block)
     return sth; /* return if we read anything */
 }
 
-static void pop(const gulong p)
+/* Grab all pending X events */
+static gboolean read_events(gboolean block)
 {
-    /* remove the event */
+    return read_events_mode(block, QueuedAfterFlush);
+}
+
+static void pop(const gulong s)
+{
+    ObtXQueueSlot *slot = SLOT(s);
+
+    /* remove the event, leaving a tombstone if it is not at the front */
+    slot->live = FALSE;
     --qnum;
-    if (qnum == 0) {
-        qstart = 0;
-        qend = -1;
-    }
-    else if (p == qstart)
-        qstart = (qstart + 1) % qsz;
-    else {
-        gulong pi;
-
-        /* is it cheaper to move the start or the end ? */
-        if ((p >= qstart && p < qstart + qnum/2) ||
-            (p < qstart && p < (qstart + qnum/2) % qsz))
-        {
-            /* move the start */
-            pi = p;
-            while (pi != qstart) {
-                const gulong pi_next = (pi == 0 ? qsz-1 : pi-1);
+    while (qhead != qtail && !SLOT(qhead)->live)
+        ++qhead;
 
-                q[pi] = q[pi_next];
-                pi = pi_next;
+    /* drop it from the front of the index lists, if it is there */
+    index_foreach_key(&slot->e, index_trim, s);
+    if (slot->priority != OBT_XQUEUE_PRIORITY_NORMAL)
+        list_trim(index_priority[slot->priority]);
+
+    shrink(); /* shrink the q if too little in it */
+}
+
+/*! Returns TRUE if event number a comes before event number b */
+static inline gboolean seq_before(gulong a, gulong b)
+{
+    return (glong)(a - b) < 0;
+}
+
+/*! Find the first event in the index list which matches, skipping the events
+  before *@from, which have already been looked at.  *@from is set to where
+  the search stopped. */
+static gboolean index_find(GHashTable *t, gconstpointer key,
+                           xqueue_match_func match, gpointer data,
+                           gulong *from, gulong *seq_return)
+{
+    GQueue *l;
+    GList *it;
+
+    if ((l = index_lookup(t, key)))
+        for (it = l->head; it; it = g_list_next(it)) {
+            const gulong s = POINTER_TO_SEQ(it->data);
+
+            if (seq_before(s, *from) || !seq_live(s))
+                continue;
+            if (!match || match(&SLOT(s)->e, data)) {
+                *from = s + 1;
+                *seq_return = s;
+                return TRUE;
             }
-            qstart = (qstart + 1) % qsz;
         }
-        else {
-            /* move the end */
-            pi = p;
-            while (pi != qend) {
-                const gulong pi_next = (pi + 1) % qsz;
-
-                q[pi] = q[pi_next];
-                pi = pi_next;
-            }
-            qend = (qend == 0 ? qsz-1 : qend-1);
+    *from = qtail;
+    return FALSE;
+}
+
+/*! Find the first event in the queue which matches, skipping the events
+  before *@from, which have already been looked at.  *@from is set to where
+  the search stopped. */
+static gboolean find_from(xqueue_match_func match, gpointer data,
+                          gulong *from, gulong *seq_return)
+{
+    gulong s;
+
+    s = seq_before(*from, qhead) ? qhead : *from;
+    for (; s != qtail; ++s)
+        if (SLOT(s)->live && match(&SLOT(s)->e, data)) {
+            *from = s + 1;
+            *seq_return = s;
+            return TRUE;
         }
+    *from = qtail;
+    return FALSE;
+}
+
+/*! Like find_from, but uses the indexes when the match function is one that
+  they can answer */
+static gboolean find(xqueue_match_func match, gpointer data,
+                     gulong *from, gulong *seq_return)
+{
+    ObtXQueueKey k;
+
+    if (match == xqueue_match_type)
+        return index_find(index_type, data, NULL, NULL, from, seq_return);
+    if (match == xqueue_match_window_type) {
+        const ObtXQueueWindowType *x = data;
+
+        k.window = x->window;
+        k.type = x->type;
+        /* the list also holds events whose subject is the window, so they
+           still need to be matched */
+        return index_find(index_window_type, &k, match, data,
+                          from, seq_return);
     }
+    if (match == xqueue_match_window_message) {
+        const ObtXQueueWindowMessage *x = data;
 
-    shrink(); /* shrink the q if too little in it */
+        k.window = x->window;
+        k.type = ClientMessage;
+        return index_find(index_window_type, &k, match, data,
+                          from, seq_return);
+    }
+    return find_from(match, data, from, seq_return);
 }
 
 void xqueue_init(void)
 {
+    gint i;
+
     if (q != NULL) return;
     qsz = MINSZ;
-    q = g_new(XEvent, qsz);
-    qstart = 0;
-    qend = -1;
+    q = g_new(ObtXQueueSlot, qsz);
+    qhead = qtail = 0;
+    qnum = 0;
+    index_window_type = g_hash_table_new_full(key_hash, key_equal,
+                                              key_free, list_free);
+    index_type = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                       NULL, list_free);
+    index_window = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                         NULL, list_free);
+    for (i = 0; i < OBT_XQUEUE_NUM_PRIORITIES; ++i)
+        index_priority[i] = g_queue_new();
 }
 
 void xqueue_destroy(void)
 {
+    gint i;
+
     if (q == NULL) return;
     g_free(q);
     q = NULL;
     qsz = 0;
+    g_hash_table_destroy(index_window_type);
+    g_hash_table_destroy(index_type);
+    g_hash_table_destroy(index_window);
+    index_window_type = index_type = index_window = NULL;
+    for (i = 0; i < OBT_XQUEUE_NUM_PRIORITIES; ++i) {
+        g_queue_free(index_priority[i]);
+        index_priority[i] = NULL;
+    }
 }
 
 gboolean xqueue_match_window(XEvent *e, gpointer data)
@@ -204,7 +509,7 @@ gboolean xqueue_peek(XEvent *event_return)
 
     if (!qnum) read_events(TRUE);
     if (!qnum) return FALSE;
-    *event_return = q[qstart]; /* get the head */
+    *event_return = SLOT(qhead)->e; /* get the head */
     return TRUE;
 }
 
@@ -215,7 +520,7 @@ gboolean xqueue_peek_local(XEvent *event_return)
 
     if (!qnum) read_events(FALSE);
     if (!qnum) return FALSE;
-    *event_return = q[qstart]; /* get the head */
+    *event_return = SLOT(qhead)->e; /* get the head */
     return TRUE;
 }
 
@@ -226,8 +531,8 @@ gboolean xqueue_next(XEvent *event_return)
 
     if (!qnum) read_events(TRUE);
     if (qnum) {
-        *event_return = q[qstart]; /* get the head */
-        pop(qstart);
+        *event_return = SLOT(qhead)->e; /* get the head */
+        pop(qhead);
         return TRUE;
     }
 
@@ -241,8 +546,8 @@ gboolean xqueue_next_local(XEvent *event_return)
 
     if (!qnum) read_events(FALSE);
     if (qnum) {
-        *event_return = q[qstart]; /* get the head */
-        pop(qstart);
+        *event_return = SLOT(qhead)->e; /* get the head */
+        pop(qhead);
         return TRUE;
     }
 
@@ -251,18 +556,15 @@ gboolean xqueue_next_local(XEvent *event_return)
 
 gboolean xqueue_exists(xqueue_match_func match, gpointer data)
 {
-    gulong i, checked;
+    gulong from, s;
 
     g_return_val_if_fail(q != NULL, FALSE);
     g_return_val_if_fail(match != NULL, FALSE);
 
-    checked = 0;
+    from = qhead;
     while (TRUE) {
-        for (i = checked; i < qnum; ++i, ++checked) {
-            const gulong p = (qstart + i) % qsz;
-            if (match(&q[p], data))
-                return TRUE;
-        }
+        if (find_from(match, data, &from, &s))
+            return TRUE;
         if (!read_events(TRUE)) break; /* error */
     }
     return FALSE;
@@ -270,18 +572,39 @@ gboolean xqueue_exists(xqueue_match_func match, gpointer data)
 
 gboolean xqueue_exists_local(xqueue_match_func match, gpointer data)
 {
-    gulong i, checked;
+    gulong from, s;
 
     g_return_val_if_fail(q != NULL, FALSE);
     g_return_val_if_fail(match != NULL, FALSE);
 
-    checked = 0;
+    from = qhead;
+    while (TRUE) {
+        if (find(match, data, &from, &s))
+            return TRUE;
+        if (!read_events(FALSE)) break;
+    }
+    return FALSE;
+}
+
+gboolean xqueue_exists_local_for(Window window, gint type,
+                                 xqueue_match_func match, gpointer data)
+{
+    gulong from, s;
+    ObtXQueueKey k;
+
+    g_return_val_if_fail(q != NULL, FALSE);
+
+    k.window = window;
+    k.type = type;
+    from = qhead;
     while (TRUE) {
-        for (i = checked; i < qnum; ++i, ++checked) {
-            const gulong p = (qstart + i) % qsz;
-            if (match(&q[p], data))
+        if (window == None) {
+            if (index_find(index_type, GINT_TO_POINTER(type),
+                           match, data, &from, &s))
                 return TRUE;
         }
+        else if (index_find(index_window_type, &k, match, data, &from, &s))
+            return TRUE;
         if (!read_events(FALSE)) break;
     }
     return FALSE;
@@ -290,21 +613,18 @@ gboolean xqueue_exists_local(xqueue_match_func match, gpointer data)
 gboolean xqueue_remove_local(XEvent *event_return,
                              xqueue_match_func match, gpointer data)
 {
-    gulong i, checked;
+    gulong from, s;
 
     g_return_val_if_fail(q != NULL, FALSE);
     g_return_val_if_fail(event_return != NULL, FALSE);
     g_return_val_if_fail(match != NULL, FALSE);
 
-    checked = 0;
+    from = qhead;
     while (TRUE) {
-        for (i = checked; i < qnum; ++i, ++checked) {
-            const gulong p = (qstart + i) % qsz;
-            if (match(&q[p], data)) {
-                *event_return = q[p];
-                pop(p);
-                return TRUE;
-            }
+        if (find(match, data, &from, &s)) {
+            *event_return = SLOT(s)->e;
+            pop(s);
+            return TRUE;
         }
         if (!read_events(FALSE)) break;
     }
@@ -319,6 +639,174 @@ gboolean xqueue_pending_local(void)
     return qnum != 0;
 }
 
+gboolean xqueue_coalesce_property(const XEvent *queued, XEvent *e,
+                                  gboolean adjacent, gpointer data)
+{
+    /* the property is read when the event is handled, so only the latest
+       change matters */
+    return queued->xproperty.atom == e->xproperty.atom;
+}
+
+gboolean xqueue_coalesce_configure_request(const XEvent *queued, XEvent *e,
+                                           gboolean adjacent, gpointer data)
+{
+    const XConfigureRequestEvent *q = &queued->xconfigurerequest;
+    XConfigureRequestEvent *c = &e->xconfigurerequest;
+
+    /* don't move the request past anything else, the window may be mapped
+       in between and it should be mapped with the earlier request applied */
+    if (!adjacent) return FALSE;
+
+    /* keep the values from the earlier request which the new one does not
+       replace */
+    if ((q->value_mask & CWX) && !(c->value_mask & CWX))
+        c->x = q->x;
+    if ((q->value_mask & CWY) && !(c->value_mask & CWY))
+        c->y = q->y;
+    if ((q->value_mask & CWWidth) && !(c->value_mask & CWWidth))
+        c->width = q->width;
+    if ((q->value_mask & CWHeight) && !(c->value_mask & CWHeight))
+        c->height = q->height;
+    if ((q->value_mask & CWBorderWidth) && !(c->value_mask & CWBorderWidth))
+        c->border_width = q->border_width;
+    /* the sibling and stack mode go together, a stack mode without a
+       sibling means something else than with one */
+    if (!(c->value_mask & (CWSibling | CWStackMode))) {
+        c->above = q->above;
+        c->detail = q->detail;
+        c->value_mask |= q->value_mask & (CWSibling | CWStackMode);
+    }
+    c->value_mask |= q->value_mask & (CWX | CWY | CWWidth | CWHeight |
+                                      CWBorderWidth);
+    return TRUE;
+}
+
+gboolean xqueue_coalesce_motion(const XEvent *queued, XEvent *e,
+                                gboolean adjacent, gpointer data)
+{
+    /* a button or key press in between would see the pointer in the wrong
+       place */
+    return adjacent && queued->xmotion.state == e->xmotion.state &&
+        queued->xmotion.subwindow == e->xmotion.subwindow &&
+        queued->xmotion.root == e->xmotion.root;
+}
+
+gboolean xqueue_coalesce_expose(const XEvent *queued, XEvent *e,
+                                gboolean adjacent, gpointer data)
+{
+    const XExposeEvent *q = &queued->xexpose;
+    XExposeEvent *x = &e->xexpose;
+    const gint r = MAX(q->x + q->width, x->x + x->width);
+    const gint b = MAX(q->y + q->height, x->y + x->height);
+
+    /* draw the area covering both */
+    x->x = MIN(q->x, x->x);
+    x->y = MIN(q->y, x->y);
+    x->width = r - x->x;
+    x->height = b - x->y;
+    return TRUE;
+}
+
+void xqueue_add_coalesce(gint type, gboolean adjacent,
+                         ObtXQueueCoalesceFunc func, gpointer data)
+{
+    guint i;
+
+    g_return_if_fail(func != NULL);
+
+    for (i = 0; i < n_coalesce; ++i)
+        if (coalesce[i].type == type) {
+            coalesce[i].adjacent = adjacent;
+            coalesce[i].func = func;
+            coalesce[i].data = data;
+            return;
+        }
+
+    coalesce = g_renew(ObtXQueueCoalesce, coalesce, n_coalesce + 1);
+    coalesce[n_coalesce].type = type;
+    coalesce[n_coalesce].adjacent = adjacent;
+    coalesce[n_coalesce].func = func;
+    coalesce[n_coalesce].data = data;
+    coalesce[n_coalesce].dropped = 0;
+    ++n_coalesce;
+}
+
+void xqueue_remove_coalesce(gint type)
+{
+    guint i;
+
+    for (i = 0; i < n_coalesce; ++i) {
+        if (coalesce[i].type == type) {
+            /* remove it */
+            for (; i < n_coalesce - 1; ++i)
+                coalesce[i] = coalesce[i+1];
+            coalesce = g_renew(ObtXQueueCoalesce, coalesce, n_coalesce - 1);
+            --n_coalesce;
+            break;
+        }
+    }
+}
+
+gulong xqueue_coalesced(gint type)
+{
+    guint i;
+
+    for (i = 0; i < n_coalesce; ++i)
+        if (coalesce[i].type == type)
+            return coalesce[i].dropped;
+    return 0;
+}
+
+void xqueue_set_priority(gint type, ObtXQueuePriority priority)
+{
+    g_return_if_fail(type >= 0 && type < NUM_TYPES);
+    g_return_if_fail(priority < OBT_XQUEUE_NUM_PRIORITIES);
+
+    type_priority[type] = priority;
+}
+
+void xqueue_wait_stats(ObtXQueuePriority priority, ObtXQueueWaitStats *stats)
+{
+    g_return_if_fail(priority < OBT_XQUEUE_NUM_PRIORITIES);
+    g_return_if_fail(stats != NULL);
+
+    *stats = wait_stats[priority];
+}
+
+/*! Returns TRUE if an event is the first one in the queue for the window */
+static gboolean first_for_window(Window w, gulong s)
+{
+    GQueue *l = index_lookup(index_window, GSIZE_TO_POINTER(w));
+    return l && POINTER_TO_SEQ(g_queue_peek_head(l)) == s;
+}
+
+/*! Pick the next event to dispatch.  This is the first event in the highest
+  priority class which can go ahead of the events before it.  An event can't
+  go ahead of any events for the same window, and events in the same class
+  are never reordered. */
+static gulong next_dispatch(void)
+{
+    gint p;
+
+    for (p = OBT_XQUEUE_NUM_PRIORITIES - 1; p > OBT_XQUEUE_PRIORITY_NORMAL;
+         --p)
+    {
+        GQueue *l = index_priority[p];
+        gulong s;
+        const XEvent *e;
+
+        list_trim(l);
+        if (g_queue_is_empty(l)) continue;
+
+        s = POINTER_TO_SEQ(g_queue_peek_head(l));
+        e = &SLOT(s)->e;
+        if (first_for_window(e->xany.window, s) &&
+            first_for_window(event_subject(e), s))
+            return s;
+    }
+    return qhead;
+}
+
 typedef struct _ObtXQueueCB {
     ObtXQueueFunc func;
     gpointer data;
@@ -327,13 +815,45 @@ typedef struct _ObtXQueueCB {
 static ObtXQueueCB *callbacks = NULL;
 static guint n_callbacks = 0;
 
+/*! The most events to dispatch before flushing the requests made for them */
+#define FLUSH_EVENTS 32
+
 static gboolean event_read(GSource *source, GSourceFunc callback,
                            gpointer data)
 {
     XEvent ev;
+    guint unflushed = 0;
 
-    while (xqueue_next_local(&ev)) {
+    /* read everything waiting each time, so that input which arrives while
+       other events are being handled can go ahead of them.  flushing the
+       output each time would cost a write for every event, so only flush
+       when the queue runs out, or every so often while it doesn't */
+    while (TRUE) {
+        gulong s;
+        ObtXQueueSlot *slot;
+        ObtXQueueWaitStats *st;
+        guint64 wait;
         guint i;
+
+        if (!qnum || unflushed >= FLUSH_EVENTS) {
+            read_events(FALSE);
+            unflushed = 0;
+        }
+        else
+            read_events_mode(FALSE, QueuedAfterReading);
+        if (!qnum) break;
+        ++unflushed;
+
+        s = next_dispatch();
+        slot = SLOT(s);
+        st = &wait_stats[slot->priority];
+        wait = MAX(now_usec() - slot->queued, 0);
+        ++st->events;
+        st->total_usec += wait;
+        st->max_usec = MAX(st->max_usec, wait);
+
+        ev = slot->e;
+        pop(s);
         for (i = 0; i < n_callbacks; ++i)
             callbacks[i].func(&ev, callbacks[i].data);
     }
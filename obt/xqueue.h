@@ -81,12 +81,91 @@ gboolean xqueue_exists(xqueue_match_func match, gpointer data);
   from the queue. */
 gboolean xqueue_exists_local(xqueue_match_func match, gpointer data);
 
+/*! Like xqueue_exists_local(), but only looks at events of the given type
+  for the window.  These are found without searching through the whole
+  queue.  An event is for the window if it was delivered to it, or if it is
+  about it, such as an UnmapNotify for it delivered to its parent.  If the
+  window is None, then all the events of the given type are looked at.  If
+  match is NULL, then any event found matches. */
+gboolean xqueue_exists_local_for(Window window, gint type,
+                                 xqueue_match_func match, gpointer data);
+
 /*! Returns TRUE if xqueue_match_func returns TRUE for some event in the
   current event queue, and passes the matching event while removing it
   from the queue. */
 gboolean xqueue_remove_local(XEvent *event_return,
                              xqueue_match_func match, gpointer data);
 
+/*! Decides if a new event makes an earlier one in the queue redundant, so
+  that the earlier one can be dropped before it is handled.
+  @param queued An earlier event of the same type for the same window, which
+    is still in the queue.
+  @param e The new event, which may be changed to carry over anything needed
+    from the queued event.
+  @param adjacent TRUE if no other events came between the two.
+  @return TRUE to remove the queued event from the queue.
+*/
+typedef gboolean (*ObtXQueueCoalesceFunc)(const XEvent *queued, XEvent *e,
+                                          gboolean adjacent, gpointer data);
+
+/*! Coalesces PropertyNotify events for the same property */
+gboolean xqueue_coalesce_property(const XEvent *queued, XEvent *e,
+                                  gboolean adjacent, gpointer data);
+/*! Coalesces ConfigureRequest events that come one after another, merging
+  their values together */
+gboolean xqueue_coalesce_configure_request(const XEvent *queued, XEvent *e,
+                                           gboolean adjacent, gpointer data);
+/*! Coalesces MotionNotify events that come one after another, with the same
+  buttons and modifiers held down */
+gboolean xqueue_coalesce_motion(const XEvent *queued, XEvent *e,
+                                gboolean adjacent, gpointer data);
+/*! Coalesces Expose events, into one covering the area of both */
+gboolean xqueue_coalesce_expose(const XEvent *queued, XEvent *e,
+                                gboolean adjacent, gpointer data);
+
+/*! Coalesce events of the given type as they are read from the server.
+  When an event arrives, the func is called with the latest queued events of
+  the same type for the same window, until it returns TRUE or none are left.
+  There is one rule for each type, and this replaces any rule for the type
+  that was added before.
+  @param adjacent If TRUE, the func is only called with the last event in the
+    queue, for rules that can only replace an event when no other events came
+    between the two.  xqueue_coalesce_configure_request and
+    xqueue_coalesce_motion are such rules.
+*/
+void xqueue_add_coalesce(gint type, gboolean adjacent,
+                         ObtXQueueCoalesceFunc func, gpointer data);
+void xqueue_remove_coalesce(gint type);
+
+/*! Returns the number of events of the type that were dropped by
+  coalescing */
+gulong xqueue_coalesced(gint type);
+
+/*! The classes of events, in the order they are dispatched in */
+typedef enum {
+    OBT_XQUEUE_PRIORITY_NORMAL,
+    /*! Input from the user, which is dispatched ahead of other events */
+    OBT_XQUEUE_PRIORITY_INPUT,
+    OBT_XQUEUE_NUM_PRIORITIES
+} ObtXQueuePriority;
+
+/*! How long the events in a priority class waited in the queue before they
+  were dispatched */
+typedef struct _ObtXQueueWaitStats {
+    gulong events;
+    guint64 total_usec;
+    guint64 max_usec;
+} ObtXQueueWaitStats;
+
+/*! Set the priority class for an event type.  Events are dispatched to the
+  callbacks from the highest class first, but an event never goes ahead of
+  an earlier event for the same window, or of an earlier event in the same
+  class.  All types are OBT_XQUEUE_PRIORITY_NORMAL to begin with. */
+void xqueue_set_priority(gint type, ObtXQueuePriority priority);
+
+/*! Get the wait times for the events dispatched from a priority class */
+void xqueue_wait_stats(ObtXQueuePriority priority, ObtXQueueWaitStats *stats);
+
 typedef void (*ObtXQueueFunc)(const XEvent *ev, gpointer data);
 
 /*! Begin listening for X events in the default GMainContext, and feed them
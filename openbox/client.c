@@ -33,6 +33,7 @@
 #include "focus.h"
 #include "focus_cycle.h"
 #include "stacking.h"
+#include "spatial.h"
 #include "openbox.h"
 #include "group.h"
 #include "config.h"
@@ -54,6 +55,7 @@
 #endif
 
 #include <glib.h>
+#include <string.h>
 #include <X11/Xutil.h>
 
 /*! The event mask to grab on client windows */
@@ -63,6 +65,11 @@
 #define CLIENT_NOPROPAGATEMASK (ButtonPressMask | ButtonReleaseMask | \
                                 ButtonMotionMask)
 
+/*! How long a client's budget for expensive updates lasts, in milliseconds */
+#define CLIENT_UPDATE_PERIOD 100
+/*! How many expensive updates a client gets in each period */
+#define CLIENT_UPDATE_BUDGET 4
+
 typedef struct
 {
     ObClientCallback func;
@@ -72,6 +79,13 @@ typedef struct
 GList          *client_list             = NULL;
 
 static GSList  *client_destroy_notifies = NULL;
+/* clients with updates put off, in the order they were put off */
+static GList   *client_deferred         = NULL;
+static guint    client_deferred_timer   = 0;
+/* the _NET_CLIENT_LIST last set on the root window, gulongs */
+static GArray  *client_published        = NULL;
+static guint    client_list_idle        = 0;
+static gboolean client_list_dirty       = FALSE;
 static RrImage *client_default_icon     = NULL;
 
 static void client_get_all(ObClient *self, gboolean real);
@@ -132,6 +146,14 @@ void client_shutdown(gboolean reconfig)
     client_default_icon = NULL;
 
     if (reconfig) return;
+
+    if (client_deferred_timer) g_source_remove(client_deferred_timer);
+    client_deferred_timer = 0;
+
+    /* publish the empty list, and drop the pending stacking list */
+    client_flush_list();
+    if (client_published) g_array_free(client_published, TRUE);
+    client_published = NULL;
 }
 
 static void client_call_notifies(ObClient *self, GSList *list)
@@ -182,28 +204,55 @@ void client_remove_destroy_notify_data(ObClientCallback func, gpointer data)
     }
 }
 
+static gboolean client_list_idle_func(gpointer data)
+{
+    client_list_idle = 0;
+    client_flush_list();
+    return FALSE; /* don't repeat */
+}
+
 void client_set_list(void)
 {
-    Window *windows, *win_it;
+    client_list_dirty = TRUE;
+    if (!client_list_idle)
+        client_list_idle = g_idle_add_full(G_PRIORITY_DEFAULT,
+                                           client_list_idle_func, NULL, NULL);
+
+    stacking_set_list();
+}
+
+void client_flush_list(void)
+{
+    gulong *windows, *win_it;
     GList *it;
-    guint size = g_list_length(client_list);
+    guint size;
 
-    /* create an array of the window ids */
-    if (size > 0) {
-        windows = g_new(Window, size);
-        win_it = windows;
+    if (client_list_idle) {
+        g_source_remove(client_list_idle);
+        client_list_idle = 0;
+    }
+
+    if (client_list_dirty) {
+        client_list_dirty = FALSE;
+
+        if (!client_published)
+            client_published = g_array_new(FALSE, FALSE, sizeof(gulong));
+
+        /* create an array of the window ids */
+        size = g_list_length(client_list);
+        windows = win_it = g_new(gulong, size);
         for (it = client_list; it; it = g_list_next(it), ++win_it)
             *win_it = ((ObClient*)it->data)->window;
-    } else
-        windows = NULL;
 
-    OBT_PROP_SETA32(obt_root(ob_screen), NET_CLIENT_LIST, WINDOW,
-                    (gulong*)windows, size);
+        /* new clients go on the end of the list, so managing windows only
+           needs them to be appended */
+        OBT_PROP_UPDATEA32(obt_root(ob_screen), NET_CLIENT_LIST, WINDOW,
+                           client_published, windows, size);
 
-    if (windows)
         g_free(windows);
+    }
 
-    stacking_set_list();
+    stacking_flush_list();
 }
 
 void client_manage(Window window, ObPrompt *prompt)
@@ -229,6 +278,9 @@ void client_manage(Window window, ObPrompt *prompt)
     attrib_set.do_not_propagate_mask = CLIENT_NOPROPAGATEMASK;
     XChangeWindowAttributes(obt_display, window,
                             CWEventMask|CWDontPropagate, &attrib_set);
+    /* PropertyNotify events are selected now, so the window's properties
+       can be cached */
+    obt_prop_cache_window(window, TRUE);
 
     /* create the ObClient struct, and populate it from the hints on the
        window */
@@ -524,6 +576,7 @@ void client_manage(Window window, ObPrompt *prompt)
 
     /* add to client list/map */
     client_list = g_list_append(client_list, self);
+    spatial_add(self);
     window_add(&self->window, CLIENT_AS_WINDOW(self));
 
     /* this has to happen after we're in the client_list */
@@ -587,12 +640,15 @@ void client_unmanage(ObClient *self)
     ob_debug("Unmanaging window: 0x%x plate 0x%x (%s) (%s)",
              self->window, self->frame->window,
              self->class, self->title ? self->title : "");
+    ob_debug("  handled %lu events, put off %lu updates",
+             self->event_count, self->deferred_count);
 
     g_assert(self != NULL);
 
     /* we dont want events no more. do this before hiding the frame so we
        don't generate more events */
     XSelectInput(obt_display, self->window, NoEventMask);
+    obt_prop_cache_window(self->window, FALSE);
 
     /* ignore enter events from the unmap so it doesnt mess with the focus */
     if (!config_focus_under_mouse)
@@ -626,6 +682,9 @@ void client_unmanage(ObClient *self)
     self->kill_prompt = NULL;
 
     client_list = g_list_remove(client_list, self);
+    spatial_remove(self);
+    if (self->deferred)
+        client_deferred = g_list_remove(client_deferred, self);
     stacking_remove(self);
     window_remove(self->window);
 
@@ -1204,6 +1263,35 @@ gboolean client_find_onscreen(ObClient *self, gint *x, gint *y, gint w, gint h,
 
 static void client_get_all(ObClient *self, gboolean real)
 {
+    /* the properties which are read from the window below, they are all
+       requested at once so that the replies only need one round trip */
+    const Atom props[] = {
+        OBT_PROP_ATOM(MOTIF_WM_HINTS),
+        OBT_PROP_ATOM(NET_WM_WINDOW_TYPE),
+        OBT_PROP_ATOM(WM_TRANSIENT_FOR),
+        OBT_PROP_ATOM(NET_WM_STATE),
+        OBT_PROP_ATOM(WM_CLIENT_LEADER),
+        OBT_PROP_ATOM(SM_CLIENT_ID),
+        OBT_PROP_ATOM(WM_CLASS),
+        OBT_PROP_ATOM(WM_WINDOW_ROLE),
+        OBT_PROP_ATOM(WM_COMMAND),
+        OBT_PROP_ATOM(WM_CLIENT_MACHINE),
+        OBT_PROP_ATOM(NET_WM_PID),
+        OBT_PROP_ATOM(NET_WM_NAME),
+        OBT_PROP_ATOM(WM_NAME),
+        OBT_PROP_ATOM(NET_WM_ICON_NAME),
+        OBT_PROP_ATOM(WM_ICON_NAME),
+        OBT_PROP_ATOM(WM_PROTOCOLS),
+        OBT_PROP_ATOM(NET_STARTUP_ID),
+        OBT_PROP_ATOM(NET_WM_DESKTOP),
+        OBT_PROP_ATOM(NET_WM_SYNC_REQUEST_COUNTER),
+        OBT_PROP_ATOM(NET_WM_STRUT_PARTIAL),
+        OBT_PROP_ATOM(NET_WM_STRUT),
+        OBT_PROP_ATOM(NET_WM_ICON_GEOMETRY)
+    };
+
+    obt_prop_prefetch(self->window, props, G_N_ELEMENTS(props));
+
     /* this is needed for the frame to set itself up */
     client_get_area(self);
 
@@ -1229,8 +1317,10 @@ static void client_get_all(ObClient *self, gboolean real)
 
     /* now we got everything that can affect the decorations or app rule
        matching */
-    if (!real)
+    if (!real) {
+        obt_prop_prefetch_end(self->window);
         return;
+    }
 
     /* save the values of the variables used for app rule matching */
     client_save_app_rule_values(self);
@@ -1263,6 +1353,8 @@ static void client_get_all(ObClient *self, gboolean real)
     client_update_strut(self);
     client_update_icons(self);
     client_update_icon_geometry(self);
+
+    obt_prop_prefetch_end(self->window);
 }
 
 static void client_get_startup_id(ObClient *self)
@@ -1569,7 +1661,7 @@ void client_get_type_and_transientness(ObClient *self)
 {
     guint num, i;
     guint32 *val;
-    Window t;
+    guint32 t;
 
     self->type = -1;
     self->transient = FALSE;
@@ -1608,7 +1700,7 @@ void client_get_type_and_transientness(ObClient *self)
         g_free(val);
     }
 
-    if (XGetTransientForHint(obt_display, self->window, &t))
+    if (OBT_PROP_GET32(self->window, WM_TRANSIENT_FOR, WINDOW, &t))
         self->transient = TRUE;
 
     if (self->type == (ObClientType) -1) {
@@ -2221,51 +2313,33 @@ void client_update_strut(ObClient *self)
     }
 }
 
+/*! How many elements from the start of a client's icon property are kept to
+  see if it has changed since it was read */
+#define ICON_HEAD 16
+
 void client_update_icons(ObClient *self)
 {
     guint num;
     guint32 *data;
-    guint w, h, i, j;
+    guint w, h, i;
     RrImage *img;
+    gboolean had_icon;
+    guint32 head[ICON_HEAD];
 
     img = NULL;
 
-    /* grab the server, because we might be setting the window's icon and
-       we don't want them to set it in between and we overwrite their own
-       icon */
-    grab_server(TRUE);
-
-    if (OBT_PROP_GETA32(self->window, NET_WM_ICON, CARDINAL, &data, &num)) {
-        /* figure out how many valid icons are in here */
-        i = 0;
-        while (i + 2 < num) { /* +2 is to make sure there is a w and h */
-            w = data[i++];
-            h = data[i++];
-            /* watch for the data being too small for the specified size,
-               or for zero sized icons. */
-            if (i + w*h > num || w == 0 || h == 0) {
-                i += w*h;
-                continue;
-            }
-
-            /* convert it to the right bit order for ObRender */
-            for (j = 0; j < w*h; ++j)
-                data[i+j] =
-                    (((data[i+j] >> 24) & 0xff) << RrDefaultAlphaOffset) +
-                    (((data[i+j] >> 16) & 0xff) << RrDefaultRedOffset)   +
-                    (((data[i+j] >>  8) & 0xff) << RrDefaultGreenOffset) +
-                    (((data[i+j] >>  0) & 0xff) << RrDefaultBlueOffset);
-
-            /* add it to the image cache as an original */
-            if (!img)
-                img = RrImageNewFromData(ob_rr_icons, &data[i], w, h);
-            else
-                RrImageAddFromData(img, &data[i], w, h);
-
-            i += w*h;
-        }
-
-        g_free(data);
+    /* the icons can be megabytes, so read them a piece at a time and without
+       grabbing the server.  if they change while we're reading them, another
+       PropertyNotify is on its way and they will be read again. */
+    had_icon = OBT_PROP_GETA32_CHUNKED(self->window, NET_WM_ICON, CARDINAL,
+                                       &data, &num);
+    if (had_icon) {
+        /* remember how the property started, the image takes the data */
+        memcpy(head, data, MIN(num, ICON_HEAD) * sizeof(guint32));
+        /* the values are ARGB, which is already the right bit order for
+           ObRender.  only the sizes are read now, and the image takes the
+           data. */
+        img = RrImageNewFromPacked(ob_rr_icons, data, num);
     }
 
     /* if we didn't find an image from the NET_WM_ICON stuff, then try the
@@ -2320,14 +2394,34 @@ void client_update_icons(ObClient *self)
                 (((icon[i] >> RrDefaultRedOffset) & 0xff) << 16) +
                 (((icon[i] >> RrDefaultGreenOffset) & 0xff) << 8) +
                 (((icon[i] >> RrDefaultBlueOffset) & 0xff) << 0);
-        OBT_PROP_SETA32(self->window, NET_WM_ICON, CARDINAL, ldata, w*h+2);
+
+        /* grab the server to check that they haven't set an icon since we
+           looked, because we don't want to overwrite their own icon.  an
+           icon that was there already had nothing usable in it, so it is
+           only replaced if it still has the same length and starts the
+           same way as when it was read. */
+        grab_server(TRUE);
+        if (!had_icon) {
+            if (!OBT_PROP_EXISTS(self->window, NET_WM_ICON))
+                OBT_PROP_SETA32(self->window, NET_WM_ICON, CARDINAL, ldata,
+                                w*h+2);
+        } else {
+            guint32 now[ICON_HEAD];
+            guint total;
+
+            if (OBT_PROP_GETHEAD32(self->window, NET_WM_ICON, CARDINAL,
+                                   now, ICON_HEAD, &total) &&
+                total == num &&
+                !memcmp(now, head, MIN(num, ICON_HEAD) * sizeof(guint32)))
+                OBT_PROP_SETA32(self->window, NET_WM_ICON, CARDINAL, ldata,
+                                w*h+2);
+        }
+        grab_server(FALSE);
         g_free(ldata);
     } else if (self->frame)
         /* don't draw the icon empty if we're just setting one now anyways,
            we'll get the property change any second */
         frame_adjust_icon(self->frame);
-
-    grab_server(FALSE);
 }
 
 void client_update_icon_geometry(ObClient *self)
@@ -2348,6 +2442,85 @@ void client_update_icon_geometry(ObClient *self)
     }
 }
 
+/*! Take one update from the client's budget, returns FALSE if there is none
+  left in the current period */
+static gboolean client_budget_spend(ObClient *self)
+{
+    GTimeVal now;
+    gint64 t;
+
+    g_get_current_time(&now);
+    t = (gint64)now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+    /* start a new period, also if the clock went backwards */
+    if (t - self->budget_start >= CLIENT_UPDATE_PERIOD * 1000 ||
+        t < self->budget_start)
+    {
+        self->budget_start = t;
+        self->budget_used = 0;
+    }
+    if (self->budget_used >= CLIENT_UPDATE_BUDGET)
+        return FALSE;
+    ++self->budget_used;
+    return TRUE;
+}
+
+static void client_run_updates(ObClient *self, guint what)
+{
+    if (what & OB_CLIENT_UPDATE_TITLE)
+        client_update_title(self);
+    if (what & OB_CLIENT_UPDATE_ICONS)
+        client_update_icons(self);
+}
+
+static gboolean client_deferred_func(gpointer data)
+{
+    GList *it, *next;
+
+    /* give each client a turn, in the order they were put off */
+    for (it = client_deferred; it; it = next) {
+        ObClient *c = it->data;
+
+        next = g_list_next(it);
+        if (client_budget_spend(c)) {
+            const guint what = c->deferred;
+
+            c->deferred = 0;
+            client_deferred = g_list_delete_link(client_deferred, it);
+            client_run_updates(c, what);
+        }
+    }
+
+    if (client_deferred)
+        return TRUE; /* repeat */
+    client_deferred_timer = 0;
+    return FALSE; /* don't repeat */
+}
+
+void client_update_budgeted(ObClient *self, guint what)
+{
+    /* wait behind the updates already put off, so they keep their turn */
+    if (!self->deferred && client_budget_spend(self)) {
+        client_run_updates(self, what);
+        return;
+    }
+
+    if (!self->deferred) {
+        client_deferred = g_list_append(client_deferred, self);
+        ob_debug_type(OB_DEBUG_APP_BUGS,
+                      "Putting off updates for window 0x%x (%s), it has "
+                      "sent %lu events", self->window, self->title,
+                      self->event_count);
+    }
+    /* an update that was already put off will pick up this change too */
+    self->deferred |= what;
+    ++self->deferred_count;
+
+    if (!client_deferred_timer)
+        client_deferred_timer =
+            g_timeout_add_full(G_PRIORITY_DEFAULT, CLIENT_UPDATE_PERIOD,
+                               client_deferred_func, NULL, NULL);
+}
+
 static void client_get_session_ids(ObClient *self)
 {
     guint32 leader;
@@ -3748,6 +3921,7 @@ static void client_set_desktop_recursive(ObClient *self,
 
         old = self->desktop;
         self->desktop = target;
+        spatial_update(self);
         OBT_PROP_SET32(self->window, NET_WM_DESKTOP, CARDINAL, target);
         /* the frame can display the current desktop state */
         frame_adjust_state(self->frame);
@@ -3828,7 +4002,10 @@ gboolean client_validate(ObClient *self)
 
     find.window = self->window;
     find.ignore_unmaps = self->ignore_unmaps;
-    if (xqueue_exists_local(find_destroy_unmap, &find))
+    if (xqueue_exists_local_for(self->window, DestroyNotify,
+                                find_destroy_unmap, &find) ||
+        xqueue_exists_local_for(self->window, UnmapNotify,
+                                find_destroy_unmap, &find))
         return FALSE;
 
     return TRUE;
@@ -4020,6 +4197,8 @@ gboolean client_can_focus(ObClient *self)
 
 gboolean client_focus(ObClient *self)
 {
+    gboolean error;
+
     if (!client_validate(self)) return FALSE;
 
     /* we might not focus this window, so if we have modal children which would
@@ -4072,9 +4251,9 @@ gboolean client_focus(ObClient *self)
 
     obt_display_ignore_errors(FALSE);
 
-    ob_debug_type(OB_DEBUG_FOCUS, "Error focusing? %d",
-                  obt_display_error_occured);
-    return !obt_display_error_occured;
+    error = obt_display_ignored_error();
+    ob_debug_type(OB_DEBUG_FOCUS, "Error focusing? %d", error);
+    return !error;
 }
 
 static void client_present(ObClient *self, gboolean here, gboolean raise,
@@ -4406,11 +4585,11 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
                                   gint my_edge_start, gint my_edge_size,
                                   gint *dest, gboolean *near_edge)
 {
-    GList *it;
+    GSList *it, *near;
     Rect *a;
-    Rect dock_area;
+    Rect dock_area, strip;
     gint edge;
-    guint i;
+    guint i, desktop;
 
     a = screen_area(self->desktop, SCREEN_AREA_ALL_MONITORS,
                     &self->frame->area);
@@ -4443,8 +4622,36 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
         g_slice_free(Rect, area);
     }
 
-    /* search for edges of clients */
-    for (it = client_list; it; it = g_list_next(it)) {
+    /* only the clients between the far edge and the back of our window, and
+       in line with it, can have an edge for us to stop at */
+    switch (dir) {
+    case OB_DIRECTION_NORTH:
+        RECT_SET(strip, my_edge_start, edge,
+                 my_edge_size, my_head + my_size - edge + 1);
+        break;
+    case OB_DIRECTION_SOUTH:
+        RECT_SET(strip, my_edge_start, my_head - my_size,
+                 my_edge_size, edge - (my_head - my_size) + 1);
+        break;
+    case OB_DIRECTION_WEST:
+        RECT_SET(strip, edge, my_edge_start,
+                 my_head + my_size - edge + 1, my_edge_size);
+        break;
+    case OB_DIRECTION_EAST:
+        RECT_SET(strip, my_head - my_size, my_edge_start,
+                 edge - (my_head - my_size) + 1, my_edge_size);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    /* search for edges of clients on our desktop and the one being shown */
+    desktop = (self->desktop == DESKTOP_ALL ? screen_desktop : self->desktop);
+    near = spatial_find_range(desktop, TRUE, &strip);
+    if (desktop != screen_desktop)
+        near = g_slist_concat(near, spatial_find_range(screen_desktop, FALSE,
+                                                       &strip));
+    for (it = near; it; it = g_slist_next(it)) {
         ObClient *cur = it->data;
 
         /* skip windows to not bump into */
@@ -4452,15 +4659,13 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
             continue;
         if (cur->iconic)
             continue;
-        if (self->desktop != cur->desktop && cur->desktop != DESKTOP_ALL &&
-            cur->desktop != screen_desktop)
-            continue;
 
         ob_debug("trying window %s", cur->title);
 
         detect_edge(cur->frame->area, dir, my_head, my_size, my_edge_start,
                     my_edge_size, dest, near_edge);
     }
+    g_slist_free(near);
     dock_get_area(&dock_area);
     detect_edge(dock_area, dir, my_head, my_size, my_edge_start,
                 my_edge_size, dest, near_edge);
@@ -4620,28 +4825,37 @@ ObClient* client_under_pointer(void)
 {
     gint x, y;
     GList *it;
+    GSList *sit, *under;
+    gboolean any;
     ObClient *ret = NULL;
 
-    if (screen_pointer_pos(&x, &y)) {
-        for (it = stacking_list; it; it = g_list_next(it)) {
-            if (WINDOW_IS_CLIENT(it->data)) {
-                ObClient *c = WINDOW_AS_CLIENT(it->data);
-                if (c->frame->visible &&
-                    /* check the desktop, this is done during desktop
-                       switching and windows are shown/hidden status is not
-                       reliable */
-                    (c->desktop == screen_desktop ||
-                     c->desktop == DESKTOP_ALL) &&
-                    /* ignore all animating windows */
-                    !frame_iconify_animating(c->frame) &&
-                    RECT_CONTAINS(c->frame->area, x, y))
-                {
-                    ret = c;
-                    break;
-                }
-            }
+    if (!screen_pointer_pos(&x, &y))
+        return NULL;
+
+    /* check the desktop, this is done during desktop switching and windows
+       are shown/hidden status is not reliable */
+    under = spatial_find_point(screen_desktop, TRUE, x, y);
+    any = FALSE;
+    for (sit = under; sit; sit = g_slist_next(sit)) {
+        ObClient *c = sit->data;
+
+        if (c->frame->visible &&
+            /* ignore all animating windows */
+            !frame_iconify_animating(c->frame))
+            any = TRUE;
+        else
+            sit->data = NULL;
+    }
+
+    /* find the highest one, only going down the stacking order until it is
+       found */
+    for (it = stacking_list; it && any; it = g_list_next(it)) {
+        if (WINDOW_IS_CLIENT(it->data) && g_slist_find(under, it->data)) {
+            ret = WINDOW_AS_CLIENT(it->data);
+            break;
         }
     }
+    g_slist_free(under);
     return ret;
 }
 
@@ -316,6 +316,18 @@ struct _ObClient
 
     /*! A boolean used for algorithms which need to mark clients as visited */
     gboolean visited;
+
+    /*! The number of X events handled for the client */
+    gulong event_count;
+    /*! The number of updates which were put off because the client was over
+      its budget */
+    gulong deferred_count;
+    /*! The ObClientUpdate flags for the updates which have been put off */
+    guint deferred;
+    /*! The number of updates done in the current budget period */
+    guint budget_used;
+    /*! When the current budget period began, in microseconds */
+    gint64 budget_start;
 };
 
 extern GList      *client_list;
@@ -350,8 +362,12 @@ ObClient *client_fake_manage(Window win);
 /*! Free the stuff created by client_fake_manage() */
 void client_fake_unmanage(ObClient *self);
 
-/*! Sets the client list on the root window from the client_list */
+/*! Marks the client lists on the root window as out of date, they will be
+  set from the client_list and stacking_list once the pending events have
+  been handled */
 void client_set_list(void);
+/*! Sets the client lists on the root window now, if they are out of date */
+void client_flush_list(void);
 
 /*! Determines if the client should be shown or hidden currently.
   @return TRUE if it should be visible; otherwise, FALSE.
@@ -645,6 +661,21 @@ void client_update_icons(ObClient *self);
 /*! Updates the window's icon geometry (where to iconify to/from) */
 void client_update_icon_geometry(ObClient *self);
 
+/*! Expensive updates which are done within a budget for each client */
+typedef enum {
+    OB_CLIENT_UPDATE_TITLE = 1 << 0, /*!< client_update_title */
+    OB_CLIENT_UPDATE_ICONS = 1 << 1  /*!< client_update_icons */
+} ObClientUpdate;
+
+/*! Does the updates for the client right away, unless it has used up its
+  budget for updates recently.  Then they are put off until a later budget
+  period, taking turns with the other clients that are over budget.  The
+  updates read the window's properties when they are done, so only the
+  latest state is used.
+  @param what A mask of ObClientUpdate values
+*/
+void client_update_budgeted(ObClient *self, guint what);
+
 /*! Helper function to convert the ->type member to string representation */
 const gchar *client_type_to_string(ObClient *self);
 
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "screen.h"
 #include "frame.h"
+#include "framerender.h"
 #include "grab.h"
 #include "menu.h"
 #include "prompt.h"
@@ -99,6 +100,16 @@ static gboolean unfocus_delay_func(gpointer data);
 static void focus_delay_client_dest(ObClient *client, gpointer data);
 
 Time event_last_user_time = CurrentTime;
+/*! The time of the last input event handled */
+static Time event_last_input_time = CurrentTime;
+
+/*! The event types which are handled ahead of the events for clients */
+static const gint input_types[] = {
+    KeyPress, KeyRelease, ButtonPress, ButtonRelease, MotionNotify,
+    EnterNotify, LeaveNotify,
+    /* these are in the same class so they stay in order with the input */
+    FocusIn, FocusOut
+};
 
 /*! The time of the current X event (if it had a timestamp) */
 static Time event_curtime = CurrentTime;
@@ -146,10 +157,23 @@ static void ice_watch(IceConn conn, IcePointer data, Bool opening,
 
 void event_startup(gboolean reconfig)
 {
+    guint i;
+
     if (reconfig) return;
 
     xqueue_add_callback(event_process, NULL);
 
+    /* drop the events that later ones make redundant, before handling them */
+    xqueue_add_coalesce(PropertyNotify, FALSE,
+                        xqueue_coalesce_property, NULL);
+    xqueue_add_coalesce(ConfigureRequest, TRUE,
+                        xqueue_coalesce_configure_request, NULL);
+    xqueue_add_coalesce(MotionNotify, TRUE, xqueue_coalesce_motion, NULL);
+
+    /* handle input ahead of the housekeeping for clients */
+    for (i = 0; i < G_N_ELEMENTS(input_types); ++i)
+        xqueue_set_priority(input_types[i], OBT_XQUEUE_PRIORITY_INPUT);
+
 #ifdef USE_SM
     IceAddConnectionWatch(ice_watch, NULL);
 #endif
@@ -161,6 +185,40 @@ void event_shutdown(gboolean reconfig)
 {
     if (reconfig) return;
 
+    ob_debug("Coalesced %lu PropertyNotify, %lu ConfigureRequest and "
+             "%lu MotionNotify events",
+             xqueue_coalesced(PropertyNotify),
+             xqueue_coalesced(ConfigureRequest),
+             xqueue_coalesced(MotionNotify));
+    xqueue_remove_coalesce(PropertyNotify);
+    xqueue_remove_coalesce(ConfigureRequest);
+    xqueue_remove_coalesce(MotionNotify);
+
+    {
+        gulong hits, misses;
+
+        obt_prop_cache_stats(&hits, &misses);
+        ob_debug("Read %lu client properties from the cache, %lu from the "
+                 "server", hits, misses);
+    }
+
+    {
+        ObtXQueueWaitStats input, normal;
+
+        xqueue_wait_stats(OBT_XQUEUE_PRIORITY_INPUT, &input);
+        xqueue_wait_stats(OBT_XQUEUE_PRIORITY_NORMAL, &normal);
+        ob_debug("Input events waited %lu usec on average, %lu at most",
+                 input.events ? (gulong)(input.total_usec / input.events) : 0,
+                 (gulong)input.max_usec);
+        ob_debug("Other events waited %lu usec on average, %lu at most",
+                 normal.events ?
+                 (gulong)(normal.total_usec / normal.events) : 0,
+                 (gulong)normal.max_usec);
+    }
+
+    ob_debug("Skipped %u frame renders that were already queued",
+             framerender_coalesced());
+
 #ifdef USE_SM
     IceRemoveConnectionWatch(ice_watch, NULL);
 #endif
@@ -265,14 +323,34 @@ static inline Time event_get_timestamp(const XEvent *e)
     return t;
 }
 
+static gboolean event_is_input(XEvent *e)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(input_types); ++i)
+        if (e->type == input_types[i]) return TRUE;
+    return FALSE;
+}
+
 static void event_set_curtime(XEvent *e)
 {
     Time t = event_get_timestamp(e);
+    gboolean overtaken = FALSE;
+
+    /* input is handled ahead of other events that came before it, so those
+       can be earlier than the last input without the clock going backwards */
+    if (event_is_input(e)) {
+        if (t) event_last_input_time = t;
+    }
+    else if (t && event_last_input_time &&
+             event_time_after(event_last_input_time, t))
+        overtaken = TRUE;
 
     /* watch that if we get an event earlier than the last specified user_time,
        which can happen if the clock goes backwards, we erase the last
        specified user_time */
-    if (t && event_last_user_time && event_time_after(event_last_user_time, t))
+    if (t && event_last_user_time && !overtaken &&
+        event_time_after(event_last_user_time, t))
         event_reset_user_time();
 
     event_sourcetime = CurrentTime;
@@ -473,6 +551,7 @@ static void event_process(const XEvent *ec, gpointer data)
             break;
         case OB_WINDOW_CLASS_CLIENT:
             client = WINDOW_AS_CLIENT(obwin);
+            ++client->event_count;
             /* events on clients can be events on prompt windows too */
             prompt = client->prompt;
             break;
@@ -548,7 +627,8 @@ static void event_process(const XEvent *ec, gpointer data)
                But if the other focus in is something like PointerRoot then we
                still want to fall back.
             */
-            if (xqueue_exists_local(event_look_for_focusin_client, NULL)) {
+            if (xqueue_exists_local_for(None, FocusIn,
+                                        event_look_for_focusin_client, NULL)) {
                 ob_debug_type(OB_DEBUG_FOCUS,
                               "  but another FocusIn is coming");
             } else {
@@ -588,7 +668,8 @@ static void event_process(const XEvent *ec, gpointer data)
         if (!wanted_focusevent(e, FALSE))
             ; /* skip this one */
         /* Look for the followup FocusIn */
-        else if (!xqueue_exists_local(event_look_for_focusin, NULL)) {
+        else if (!xqueue_exists_local_for(None, FocusIn,
+                                          event_look_for_focusin, NULL)) {
             /* There is no FocusIn, this means focus went to a window that
                is not being managed, or a window on another screen. */
             Window win, root;
@@ -1605,7 +1686,8 @@ static void event_handle_client(ObClient *client, XEvent *e)
             struct ObSkipPropertyChange s;
             s.window = client->window;
             s.prop = msgtype;
-            if (xqueue_exists_local(skip_property_change, &s))
+            if (xqueue_exists_local_for(client->window, PropertyNotify,
+                                        skip_property_change, &s))
                 break;
         }
 
@@ -1657,7 +1739,7 @@ static void event_handle_client(ObClient *client, XEvent *e)
                    msgtype == OBT_PROP_ATOM(WM_NAME) ||
                    msgtype == OBT_PROP_ATOM(NET_WM_ICON_NAME) ||
                    msgtype == OBT_PROP_ATOM(WM_ICON_NAME)) {
-            client_update_title(client);
+            client_update_budgeted(client, OB_CLIENT_UPDATE_TITLE);
         } else if (msgtype == OBT_PROP_ATOM(WM_PROTOCOLS)) {
             client_update_protocols(client);
         }
@@ -1666,7 +1748,7 @@ static void event_handle_client(ObClient *client, XEvent *e)
             client_update_strut(client);
         }
         else if (msgtype == OBT_PROP_ATOM(NET_WM_ICON)) {
-            client_update_icons(client);
+            client_update_budgeted(client, OB_CLIENT_UPDATE_ICONS);
         }
         else if (msgtype == OBT_PROP_ATOM(NET_WM_ICON_GEOMETRY)) {
             client_update_icon_geometry(client);
@@ -2036,7 +2118,8 @@ static void event_handle_menu(ObMenuFrame *frame, XEvent *ev)
         if ((e = g_hash_table_lookup(menu_frame_map, &ev->xcrossing.window))) {
             /* check if an EnterNotify event is coming, and if not, then select
                nothing in the menu */
-            if (!xqueue_exists_local(event_look_for_menu_enter, e->frame))
+            if (!xqueue_exists_local_for(None, EnterNotify,
+                                         event_look_for_menu_enter, e->frame))
                 menu_frame_select(e->frame, NULL, FALSE);
         }
         break;
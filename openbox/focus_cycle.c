@@ -23,6 +23,7 @@
 #include "frame.h"
 #include "focus.h"
 #include "screen.h"
+#include "spatial.h"
 #include "openbox.h"
 #include "debug.h"
 
@@ -172,99 +173,108 @@ done_cycle:
     return ret;
 }
 
+typedef struct {
+    ObClient *client;
+    ObDirection dir;
+    gint cx, cy;
+} ObFocusDirectional;
+
 /* this be mostly ripped from fvwm */
-static ObClient *focus_find_directional(ObClient *c, ObDirection dir,
-                                        gboolean dock_windows,
-                                        gboolean desktop_windows)
+static gint focus_directional_score(ObClient *cur, gpointer data)
 {
-    gint my_cx, my_cy, his_cx, his_cy;
+    ObFocusDirectional *d = data;
+    const ObDirection dir = d->dir;
+    gint his_cx, his_cy;
     gint offset = 0;
     gint distance = 0;
-    gint score, best_score;
-    ObClient *best_client, *cur;
-    GList *it;
+    gint score;
+
+    /* the currently selected window isn't interesting */
+    if (cur == d->client)
+        return -1;
+    if (!focus_cycle_valid(cur))
+        return -1;
+
+    /* find the centre coords of this window, from the
+     * currently focused window's point of view */
+    his_cx = (cur->frame->area.x - d->cx)
+        + cur->frame->area.width / 2;
+    his_cy = (cur->frame->area.y - d->cy)
+        + cur->frame->area.height / 2;
+
+    if (dir == OB_DIRECTION_NORTHEAST || dir == OB_DIRECTION_SOUTHEAST ||
+        dir == OB_DIRECTION_SOUTHWEST || dir == OB_DIRECTION_NORTHWEST)
+    {
+        gint tx;
+        /* Rotate the diagonals 45 degrees counterclockwise.
+         * To do this, multiply the matrix /+h +h\ with the
+         * vector (x y).                   \-h +h/
+         * h = sqrt(0.5). We can set h := 1 since absolute
+         * distance doesn't matter here. */
+        tx = his_cx + his_cy;
+        his_cy = -his_cx + his_cy;
+        his_cx = tx;
+    }
 
-    if (!client_list)
-        return NULL;
+    switch (dir) {
+    case OB_DIRECTION_NORTH:
+    case OB_DIRECTION_SOUTH:
+    case OB_DIRECTION_NORTHEAST:
+    case OB_DIRECTION_SOUTHWEST:
+        offset = (his_cx < 0) ? -his_cx : his_cx;
+        distance = ((dir == OB_DIRECTION_NORTH ||
+                     dir == OB_DIRECTION_NORTHEAST) ?
+                    -his_cy : his_cy);
+        break;
+    case OB_DIRECTION_EAST:
+    case OB_DIRECTION_WEST:
+    case OB_DIRECTION_SOUTHEAST:
+    case OB_DIRECTION_NORTHWEST:
+        offset = (his_cy < 0) ? -his_cy : his_cy;
+        distance = ((dir == OB_DIRECTION_WEST ||
+                     dir == OB_DIRECTION_NORTHWEST) ?
+                    -his_cx : his_cx);
+        break;
+    }
 
-    /* first, find the centre coords of the currently focused window */
-    my_cx = c->frame->area.x + c->frame->area.width / 2;
-    my_cy = c->frame->area.y + c->frame->area.height / 2;
-
-    best_score = -1;
-    best_client = c;
-
-    for (it = g_list_first(client_list); it; it = g_list_next(it)) {
-        cur = it->data;
-
-        /* the currently selected window isn't interesting */
-        if (cur == c)
-            continue;
-        if (!focus_cycle_valid(it->data))
-            continue;
-
-        /* find the centre coords of this window, from the
-         * currently focused window's point of view */
-        his_cx = (cur->frame->area.x - my_cx)
-            + cur->frame->area.width / 2;
-        his_cy = (cur->frame->area.y - my_cy)
-            + cur->frame->area.height / 2;
-
-        if (dir == OB_DIRECTION_NORTHEAST || dir == OB_DIRECTION_SOUTHEAST ||
-            dir == OB_DIRECTION_SOUTHWEST || dir == OB_DIRECTION_NORTHWEST)
-        {
-            gint tx;
-            /* Rotate the diagonals 45 degrees counterclockwise.
-             * To do this, multiply the matrix /+h +h\ with the
-             * vector (x y).                   \-h +h/
-             * h = sqrt(0.5). We can set h := 1 since absolute
-             * distance doesn't matter here. */
-            tx = his_cx + his_cy;
-            his_cy = -his_cx + his_cy;
-            his_cx = tx;
-        }
+    /* the target must be in the requested direction */
+    if (distance <= 0)
+        return -1;
 
-        switch (dir) {
-        case OB_DIRECTION_NORTH:
-        case OB_DIRECTION_SOUTH:
-        case OB_DIRECTION_NORTHEAST:
-        case OB_DIRECTION_SOUTHWEST:
-            offset = (his_cx < 0) ? -his_cx : his_cx;
-            distance = ((dir == OB_DIRECTION_NORTH ||
-                         dir == OB_DIRECTION_NORTHEAST) ?
-                        -his_cy : his_cy);
-            break;
-        case OB_DIRECTION_EAST:
-        case OB_DIRECTION_WEST:
-        case OB_DIRECTION_SOUTHEAST:
-        case OB_DIRECTION_NORTHWEST:
-            offset = (his_cy < 0) ? -his_cy : his_cy;
-            distance = ((dir == OB_DIRECTION_WEST ||
-                         dir == OB_DIRECTION_NORTHWEST) ?
-                        -his_cx : his_cx);
-            break;
-        }
+    /* Calculate score for this window.  The smaller the better.  It is never
+       less than how far away the window's centre is along either axis, which
+       spatial_find_nearest needs. */
+    score = distance + offset;
 
-        /* the target must be in the requested direction */
-        if (distance <= 0)
-            continue;
+    /* windows more than 45 degrees off the direction are
+     * heavily penalized and will only be chosen if nothing
+     * else within a million pixels */
+    if (offset > distance)
+        score += 1000000;
 
-        /* Calculate score for this window.  The smaller the better. */
-        score = distance + offset;
+    return score;
+}
 
-        /* windows more than 45 degrees off the direction are
-         * heavily penalized and will only be chosen if nothing
-         * else within a million pixels */
-        if (offset > distance)
-            score += 1000000;
+static ObClient *focus_find_directional(ObClient *c, ObDirection dir,
+                                        gboolean dock_windows,
+                                        gboolean desktop_windows)
+{
+    ObFocusDirectional d;
+    ObClient *best_client;
 
-        if (best_score == -1 || score < best_score) {
-            best_client = cur;
-            best_score = score;
-        }
-    }
+    if (!client_list)
+        return NULL;
 
-    return best_client;
+    /* first, find the centre coords of the currently focused window */
+    d.client = c;
+    d.dir = dir;
+    d.cx = c->frame->area.x + c->frame->area.width / 2;
+    d.cy = c->frame->area.y + c->frame->area.height / 2;
+
+    /* directional cycling doesn't go to other desktops */
+    best_client = spatial_find_nearest(screen_desktop, TRUE, d.cx, d.cy,
+                                       focus_directional_score, &d);
+    return best_client ? best_client : c;
 }
 
 ObClient* focus_directional_cycle(ObDirection dir, gboolean dock_windows,
@@ -24,6 +24,8 @@
 #include "debug.h"
 #include "config.h"
 #include "framerender.h"
+#include "spatial.h"
+#include "resist.h"
 #include "focus_cycle.h"
 #include "focus_cycle_indicator.h"
 #include "moveresize.h"
@@ -228,6 +230,7 @@ static void free_theme_statics(ObFrame *self)
 
 void frame_free(ObFrame *self)
 {
+    framerender_dequeue(self);
     free_theme_statics(self);
 
     XDestroyWindow(obt_display, self->window);
@@ -834,6 +837,10 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
         frame_client_gravity(self, &self->area.x, &self->area.y);
     }
 
+    spatial_update(self->client);
+    if (moved || resized)
+        resist_edges_invalidate(self->client);
+
     if (!fake) {
         if (!frame_iconify_animating(self))
             /* move and resize the top level frame.
@@ -856,8 +863,7 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
                     self->size.left, self->size.top);
 
         if (resized) {
-            self->need_render = TRUE;
-            framerender_frame(self);
+            framerender_queue(self);
             frame_adjust_shape(self);
         }
 
@@ -962,8 +968,7 @@ void frame_adjust_client_area(ObFrame *self)
 
 void frame_adjust_state(ObFrame *self)
 {
-    self->need_render = TRUE;
-    framerender_frame(self);
+    framerender_queue(self);
 }
 
 void frame_adjust_focus(ObFrame *self, gboolean hilite)
@@ -972,21 +977,17 @@ void frame_adjust_focus(ObFrame *self, gboolean hilite)
                   "Frame for 0x%x has focus: %d",
                   self->client->window, hilite);
     self->focused = hilite;
-    self->need_render = TRUE;
-    framerender_frame(self);
-    XFlush(obt_display);
+    framerender_queue(self);
 }
 
 void frame_adjust_title(ObFrame *self)
 {
-    self->need_render = TRUE;
-    framerender_frame(self);
+    framerender_queue(self);
 }
 
 void frame_adjust_icon(ObFrame *self)
 {
-    self->need_render = TRUE;
-    framerender_frame(self);
+    framerender_queue(self);
 }
 
 void frame_grab_client(ObFrame *self)
@@ -1077,7 +1078,9 @@ void frame_release_client(ObFrame *self)
         g_source_remove(self->iconify_animation_timer);
 
     /* check if the app has already reparented its window away */
-    if (!xqueue_exists_local(find_reparent, self)) {
+    if (!xqueue_exists_local_for(self->client->window, ReparentNotify,
+                                 find_reparent, self))
+    {
         /* according to the ICCCM - if the client doesn't reparent itself,
            then we will reparent the window to root for them */
         XReparentWindow(obt_display, self->client->window, obt_root(ob_screen),
@@ -1685,6 +1688,8 @@ static gboolean flash_timeout(gpointer data)
     self->flash_on = !self->flash_on;
     if (!self->focused) {
         frame_adjust_focus(self, self->flash_on);
+        /* draw it now, while focused says how it should look */
+        framerender_frame(self);
         self->focused = FALSE;
     }
 
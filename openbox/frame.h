@@ -188,6 +188,8 @@ struct _ObFrame
 
     gboolean  focused;
     gboolean  need_render;
+    /*! The frame is in the render queue, see framerender_queue() */
+    gboolean  render_queued;
 
     gboolean  flashing;
     gboolean  flash_on;
@@ -32,6 +32,61 @@ static void framerender_desk(ObFrame *self, RrAppearance *a);
 static void framerender_shade(ObFrame *self, RrAppearance *a);
 static void framerender_close(ObFrame *self, RrAppearance *a);
 
+/*! Frames waiting to be rendered, ObFrame*s */
+static GSList *render_queue = NULL;
+static guint   render_idle = 0;
+static guint   render_coalesced = 0;
+
+static gboolean render_queue_idle(gpointer data)
+{
+    render_idle = 0;
+    framerender_flush();
+    XFlush(obt_display);
+    return FALSE; /* don't repeat */
+}
+
+void framerender_queue(ObFrame *self)
+{
+    self->need_render = TRUE;
+    if (self->render_queued) {
+        ++render_coalesced;
+        return;
+    }
+    self->render_queued = TRUE;
+    render_queue = g_slist_prepend(render_queue, self);
+
+    /* the X events source has the same priority and drains all of the events
+       it has read before returning, so this runs once they are handled, before
+       the main loop goes back to sleep */
+    if (!render_idle)
+        render_idle = g_idle_add_full(G_PRIORITY_DEFAULT, render_queue_idle,
+                                      NULL, NULL);
+}
+
+void framerender_dequeue(ObFrame *self)
+{
+    if (self->render_queued) {
+        render_queue = g_slist_remove(render_queue, self);
+        self->render_queued = FALSE;
+    }
+}
+
+void framerender_flush(void)
+{
+    while (render_queue) {
+        ObFrame *f = render_queue->data;
+
+        render_queue = g_slist_delete_link(render_queue, render_queue);
+        f->render_queued = FALSE;
+        framerender_frame(f);
+    }
+}
+
+guint framerender_coalesced(void)
+{
+    return render_coalesced;
+}
+
 void framerender_frame(ObFrame *self)
 {
     if (frame_iconify_animating(self))
@@ -244,37 +299,40 @@ void framerender_frame(ObFrame *self)
         }
         clear = ob_rr_theme->a_clear;
 
-        RrPaint(t, self->title, self->width, ob_rr_theme->title_height);
+        RrPaintCached(t, self->title,
+                      self->width, ob_rr_theme->title_height);
 
         clear->surface.parent = t;
         clear->surface.parenty = 0;
 
         clear->surface.parentx = ob_rr_theme->grip_width;
 
-        RrPaint(clear, self->topresize,
-                self->width - ob_rr_theme->grip_width * 2,
-                ob_rr_theme->paddingy + 1);
+        RrPaintCached(clear, self->topresize,
+                      self->width - ob_rr_theme->grip_width * 2,
+                      ob_rr_theme->paddingy + 1);
 
         clear->surface.parentx = 0;
 
         if (ob_rr_theme->grip_width > 0)
-            RrPaint(clear, self->tltresize,
-                    ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+            RrPaintCached(clear, self->tltresize,
+                          ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
         if (ob_rr_theme->title_height > 0)
-            RrPaint(clear, self->tllresize,
-                    ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+            RrPaintCached(clear, self->tllresize,
+                          ob_rr_theme->paddingx + 1,
+                          ob_rr_theme->title_height);
 
         clear->surface.parentx = self->width - ob_rr_theme->grip_width;
 
         if (ob_rr_theme->grip_width > 0)
-            RrPaint(clear, self->trtresize,
-                    ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+            RrPaintCached(clear, self->trtresize,
+                          ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
 
         clear->surface.parentx = self->width - (ob_rr_theme->paddingx + 1);
 
         if (ob_rr_theme->title_height > 0)
-            RrPaint(clear, self->trrresize,
-                    ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+            RrPaintCached(clear, self->trrresize,
+                          ob_rr_theme->paddingx + 1,
+                          ob_rr_theme->title_height);
 
         /* set parents for any parent relative guys */
         l->surface.parent = t;
@@ -322,7 +380,8 @@ void framerender_frame(ObFrame *self)
         h = (self->focused ?
              ob_rr_theme->a_focused_handle : ob_rr_theme->a_unfocused_handle);
 
-        RrPaint(h, self->handle, self->width, ob_rr_theme->handle_height);
+        RrPaintCached(h, self->handle,
+                      self->width, ob_rr_theme->handle_height);
 
         if (self->decorations & OB_FRAME_DECOR_GRIPS) {
             g = (self->focused ?
@@ -334,14 +393,14 @@ void framerender_frame(ObFrame *self)
             g->surface.parentx = 0;
             g->surface.parenty = 0;
 
-            RrPaint(g, self->lgrip,
-                    ob_rr_theme->grip_width, ob_rr_theme->handle_height);
+            RrPaintCached(g, self->lgrip,
+                          ob_rr_theme->grip_width, ob_rr_theme->handle_height);
 
             g->surface.parentx = self->width - ob_rr_theme->grip_width;
             g->surface.parenty = 0;
 
-            RrPaint(g, self->rgrip,
-                    ob_rr_theme->grip_width, ob_rr_theme->handle_height);
+            RrPaintCached(g, self->rgrip,
+                          ob_rr_theme->grip_width, ob_rr_theme->handle_height);
         }
     }
 
@@ -353,7 +412,9 @@ static void framerender_label(ObFrame *self, RrAppearance *a)
     if (!self->label_on) return;
     /* set the texture's text! */
     a->texture[0].data.text.string = self->client->title;
-    RrPaint(a, self->label, self->label_width, ob_rr_theme->label_height);
+    /* titles change often, so only repaint the text that changed */
+    RrPaintRegion(a, self->label,
+                  self->label_width, ob_rr_theme->label_height, NULL);
 }
 
 static void framerender_icon(ObFrame *self, RrAppearance *a)
@@ -374,39 +435,41 @@ static void framerender_icon(ObFrame *self, RrAppearance *a)
         a->texture[0].type = RR_TEXTURE_NONE;
     }
 
-    RrPaint(a, self->icon,
-            ob_rr_theme->button_size + 2, ob_rr_theme->button_size + 2);
+    RrPaintCached(a, self->icon,
+                  ob_rr_theme->button_size + 2, ob_rr_theme->button_size + 2);
 }
 
 static void framerender_max(ObFrame *self, RrAppearance *a)
 {
     if (!self->max_on) return;
-    RrPaint(a, self->max, ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintCached(a, self->max,
+                  ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
 static void framerender_iconify(ObFrame *self, RrAppearance *a)
 {
     if (!self->iconify_on) return;
-    RrPaint(a, self->iconify,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintCached(a, self->iconify,
+                  ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
 static void framerender_desk(ObFrame *self, RrAppearance *a)
 {
     if (!self->desk_on) return;
-    RrPaint(a, self->desk, ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintCached(a, self->desk,
+                  ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
 static void framerender_shade(ObFrame *self, RrAppearance *a)
 {
     if (!self->shade_on) return;
-    RrPaint(a, self->shade,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintCached(a, self->shade,
+                  ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
 static void framerender_close(ObFrame *self, RrAppearance *a)
 {
     if (!self->close_on) return;
-    RrPaint(a, self->close,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintCached(a, self->close,
+                  ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
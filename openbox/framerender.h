@@ -23,4 +23,16 @@ struct _ObFrame;
 
 void framerender_frame(struct _ObFrame *self);
 
+/*! Mark the frame as needing to be rendered, and render it once the events
+  that are waiting have been handled.  Queueing a frame again before then
+  does not render it again. */
+void framerender_queue(struct _ObFrame *self);
+/*! Take the frame out of the render queue, for when it is being freed */
+void framerender_dequeue(struct _ObFrame *self);
+/*! Render all of the frames in the render queue now */
+void framerender_flush(void);
+/*! Returns how many times a frame was queued for rendering while it was
+  already in the queue */
+guint framerender_coalesced(void);
+
 #endif
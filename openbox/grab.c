@@ -195,8 +195,6 @@ void grab_button_full(guint button, guint state, Window win, guint mask,
         XGrabButton(obt_display, button, state | mask_list[i], win, False,
                     mask, pointer_mode, GrabModeAsync, None, ob_cursor(cur));
     obt_display_ignore_errors(FALSE);
-    if (obt_display_error_occured)
-        ob_debug("Failed to grab button %d modifiers %d", button, state);
 }
 
 void ungrab_button(guint button, guint state, Window win)
@@ -217,8 +215,6 @@ void grab_key(guint keycode, guint state, Window win, gint keyboard_mode)
         XGrabKey(obt_display, keycode, state | mask_list[i], win, FALSE,
                  GrabModeAsync, keyboard_mode);
     obt_display_ignore_errors(FALSE);
-    if (obt_display_error_occured)
-        ob_debug("Failed to grab keycode %d modifiers %d", keycode, state);
 }
 
 void ungrab_all_keys(Window win)
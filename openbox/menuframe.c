@@ -401,7 +401,7 @@ static void menu_entry_frame_render(ObMenuEntryFrame *self)
     item_a->surface.parent = self->frame->a_items;
     item_a->surface.parentx = self->area.x;
     item_a->surface.parenty = self->area.y;
-    RrPaint(item_a, self->window, self->area.width, self->area.height);
+    RrPaintCached(item_a, self->window, self->area.width, self->area.height);
 
     switch (self->entry->type) {
     case OB_MENU_ENTRY_TYPE_NORMAL:
@@ -464,8 +464,8 @@ static void menu_entry_frame_render(ObMenuEntryFrame *self)
         text_a->surface.parent = item_a;
         text_a->surface.parentx = self->frame->text_x;
         text_a->surface.parenty = PADDING;
-        RrPaint(text_a, self->text, self->frame->text_w,
-                ITEM_HEIGHT - 2*PADDING);
+        RrPaintRegion(text_a, self->text, self->frame->text_w,
+                      ITEM_HEIGHT - 2*PADDING, NULL);
         break;
     case OB_MENU_ENTRY_TYPE_SUBMENU:
         XMoveResizeWindow(obt_display, self->text,
@@ -475,8 +475,8 @@ static void menu_entry_frame_render(ObMenuEntryFrame *self)
         text_a->surface.parent = item_a;
         text_a->surface.parentx = self->frame->text_x;
         text_a->surface.parenty = PADDING;
-        RrPaint(text_a, self->text, self->frame->text_w - ITEM_HEIGHT,
-                ITEM_HEIGHT - 2*PADDING);
+        RrPaintRegion(text_a, self->text, self->frame->text_w - ITEM_HEIGHT,
+                      ITEM_HEIGHT - 2*PADDING, NULL);
         break;
     case OB_MENU_ENTRY_TYPE_SEPARATOR:
         if (self->entry->data.separator.label != NULL) {
@@ -489,10 +489,10 @@ static void menu_entry_frame_render(ObMenuEntryFrame *self)
             text_a->surface.parent = item_a;
             text_a->surface.parentx = ob_rr_theme->paddingx;
             text_a->surface.parenty = ob_rr_theme->paddingy;
-            RrPaint(text_a, self->text,
-                    self->area.width - 2*ob_rr_theme->paddingx,
-                    ob_rr_theme->menu_title_height -
-                    2*ob_rr_theme->paddingy);
+            RrPaintRegion(text_a, self->text,
+                          self->area.width - 2*ob_rr_theme->paddingx,
+                          ob_rr_theme->menu_title_height -
+                          2*ob_rr_theme->paddingy, NULL);
         } else {
             gint i;
 
@@ -828,7 +828,7 @@ void menu_frame_render(ObMenuFrame *self)
 
     self->inner_w = w;
 
-    RrPaint(self->a_items, self->window, w, h);
+    RrPaintCached(self->a_items, self->window, w, h);
 
     for (it = self->entries; it; it = g_list_next(it))
         menu_entry_frame_render(it->data);
@@ -265,6 +265,8 @@ void moveresize_start(ObClient *c, gint x, gint y, guint b, guint32 cnr)
     cur_w = start_cw;
     cur_h = start_ch;
 
+    resist_edges_start(c);
+
     moveresize_in_progress = TRUE;
     waiting_for_sync = 0;
 
@@ -366,6 +368,8 @@ void moveresize_end(gboolean cancel)
     /* dont edge warp after its ended */
     cancel_edge_warp();
 
+    resist_edges_end();
+
     moveresize_in_progress = FALSE;
     moveresize_client = NULL;
 }
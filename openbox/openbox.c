@@ -25,6 +25,7 @@
 #include "menu.h"
 #include "client.h"
 #include "screen.h"
+#include "spatial.h"
 #include "actions.h"
 #include "startupnotify.h"
 #include "focus.h"
@@ -320,6 +321,7 @@ gint main(gint argc, gchar **argv)
             grab_startup(reconfigure);
             group_startup(reconfigure);
             ping_startup(reconfigure);
+            spatial_startup(reconfigure);
             client_startup(reconfigure);
             dock_startup(reconfigure);
             moveresize_startup(reconfigure);
@@ -399,6 +401,7 @@ gint main(gint argc, gchar **argv)
             moveresize_shutdown(reconfigure);
             dock_shutdown(reconfigure);
             client_shutdown(reconfigure);
+            spatial_shutdown(reconfigure);
             ping_shutdown(reconfigure);
             group_shutdown(reconfigure);
             grab_shutdown(reconfigure);
@@ -20,6 +20,7 @@
 #include "client.h"
 #include "group.h"
 #include "screen.h"
+#include "spatial.h"
 #include "frame.h"
 #include "focus.h"
 #include "config.h"
@@ -408,27 +409,23 @@ static gboolean place_least_overlap(ObClient *c, Rect *head, int *x, int *y,
 
     /* if we're "showing desktop", ignore all existing windows */
     if (!screen_showing_desktop) {
-        GList* it;
-        for (it = client_list; it != NULL; it = g_list_next(it)) {
+        GSList* it, *next;
+
+        /* windows outside of the monitor can't overlap with a place on it */
+        potential_overlap_clients =
+            spatial_find_range(c->desktop != DESKTOP_ALL ?
+                               c->desktop : screen_desktop, TRUE, head);
+        for (it = potential_overlap_clients; it != NULL; it = next) {
             ObClient* maybe_client = (ObClient*)it->data;
-            if (maybe_client == c)
-                continue;
-            if (maybe_client->iconic)
-                continue;
-            if (!client_occupies_space(maybe_client))
+
+            next = g_slist_next(it);
+            if (maybe_client == c || maybe_client->iconic ||
+                !client_occupies_space(maybe_client))
+            {
+                potential_overlap_clients = g_slist_delete_link(
+                    potential_overlap_clients, it);
                 continue;
-            if (c->desktop != DESKTOP_ALL) {
-                if (maybe_client->desktop != c->desktop &&
-                    maybe_client->desktop != DESKTOP_ALL)
-                    continue;
-            } else {
-                if (maybe_client->desktop != screen_desktop &&
-                    maybe_client->desktop != DESKTOP_ALL)
-                    continue;
             }
-
-            potential_overlap_clients = g_slist_prepend(
-                potential_overlap_clients, maybe_client);
             n_client_rects += 1;
         }
     }
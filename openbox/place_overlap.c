@@ -21,6 +21,7 @@
 #include "place_overlap.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 static void make_grid(const Rect* client_rects,
                       int n_client_rects,
@@ -49,22 +50,99 @@ static void center_in_field(Point* grid_point,
                             const int* y_edges,
                             int max_edges);
 
+#define NUM_DIRECTIONS 4
+
+/* The directions from a grid point in which a window can be placed, as the
+   multiple of the window's size to move its top left corner by */
+static const Size directions[NUM_DIRECTIONS] = {
+    {0, 0}, {0, -1}, {-1, 0}, {-1, -1}
+};
+
+static int least_overlap_exhaustive(const Rect* client_rects,
+                                    int n_client_rects,
+                                    const Rect* monitor,
+                                    const Size* req_size,
+                                    const int* x_edges,
+                                    const int* y_edges,
+                                    int max_edges,
+                                    Point* result);
+
+static int least_overlap_sweep(const Rect* client_rects,
+                               int n_client_rects,
+                               const Rect* monitor,
+                               const Size* req_size,
+                               const int* x_edges,
+                               const int* y_edges,
+                               int max_edges,
+                               Point* result);
+
 /* Choose the placement on a grid with least overlap */
 
-void place_overlap_find_least_placement(const Rect* client_rects,
-                                        int n_client_rects,
-                                        const Rect *monitor,
-                                        const Size* req_size,
-                                        Point* result)
+static void find_least_placement(const Rect* client_rects,
+                                 int n_client_rects,
+                                 const Rect *monitor,
+                                 const Size* req_size,
+                                 Point* result,
+                                 gboolean exhaustive)
 {
     POINT_SET(*result, monitor->x, monitor->y);
-    int overlap = G_MAXINT;
     int max_edges = 2 * (n_client_rects + 1);
 
     int x_edges[max_edges];
     int y_edges[max_edges];
     make_grid(client_rects, n_client_rects, monitor,
             x_edges, y_edges, max_edges);
+    int overlap = exhaustive ?
+        least_overlap_exhaustive(client_rects, n_client_rects, monitor,
+                                 req_size, x_edges, y_edges, max_edges,
+                                 result) :
+        least_overlap_sweep(client_rects, n_client_rects, monitor,
+                            req_size, x_edges, y_edges, max_edges,
+                            result);
+    if (config_place_center && overlap == 0) {
+        center_in_field(result,
+                        req_size,
+                        monitor,
+                        client_rects,
+                        n_client_rects,
+                        x_edges,
+                        y_edges,
+                        max_edges);
+    }
+}
+
+void place_overlap_find_least_placement(const Rect* client_rects,
+                                        int n_client_rects,
+                                        const Rect *monitor,
+                                        const Size* req_size,
+                                        Point* result)
+{
+    find_least_placement(client_rects, n_client_rects, monitor, req_size,
+                         result, FALSE);
+}
+
+void place_overlap_find_least_placement_exhaustive(const Rect* client_rects,
+                                                   int n_client_rects,
+                                                   const Rect *monitor,
+                                                   const Size* req_size,
+                                                   Point* result)
+{
+    find_least_placement(client_rects, n_client_rects, monitor, req_size,
+                         result, TRUE);
+}
+
+/* Try every grid point in every direction, and find the overlap of each
+   placement by looking at every client rect.  This is O(n^3). */
+static int least_overlap_exhaustive(const Rect* client_rects,
+                                    int n_client_rects,
+                                    const Rect* monitor,
+                                    const Size* req_size,
+                                    const int* x_edges,
+                                    const int* y_edges,
+                                    int max_edges,
+                                    Point* result)
+{
+    int overlap = G_MAXINT;
     int i;
     for (i = 0; i < max_edges; ++i) {
         if (x_edges[i] == G_MAXINT)
@@ -88,16 +166,7 @@ void place_overlap_find_least_placement(const Rect* client_rects,
         if (overlap == 0)
             break;
     }
-    if (config_place_center && overlap == 0) {
-        center_in_field(result,
-                        req_size,
-                        monitor,
-                        client_rects,
-                        n_client_rects,
-                        x_edges,
-                        y_edges,
-                        max_edges);
-    }
+    return overlap;
 }
 
 static int compare_ints(const void* a,
@@ -108,8 +177,8 @@ static int compare_ints(const void* a,
     return *ia - *ib;
 }
 
-static void uniquify(int* edges,
-                     int n_edges)
+static int uniquify(int* edges,
+                    int n_edges)
 {
     int i = 0;
     int j = 0;
@@ -120,9 +189,11 @@ static void uniquify(int* edges,
         while (j < n_edges && edges[j] == last)
             ++j;
     }
+    int n_unique = i;
     /* fill the rest with nonsense */
     for (; i < n_edges; ++i)
         edges[i] = G_MAXINT;
+    return n_unique;
 }
 
 static void make_grid(const Rect* client_rects,
@@ -301,8 +372,6 @@ static void center_in_field(Point* top_left,
    Point of such rectangle and the resulting overlap amount.  Only
    consider placements within BOUNDS. */
 
-#define NUM_DIRECTIONS 4
-
 static int best_direction(const Point* grid_point,
                           const Rect* client_rects,
                           int n_client_rects,
@@ -310,9 +379,6 @@ static int best_direction(const Point* grid_point,
                           const Size* req_size,
                           Point* best_top_left)
 {
-    static const Size directions[NUM_DIRECTIONS] = {
-        {0, 0}, {0, -1}, {-1, 0}, {-1, -1}
-    };
     int overlap = G_MAXINT;
     int i;
     for (i = 0; i < NUM_DIRECTIONS; ++i) {
@@ -334,3 +400,188 @@ static int best_direction(const Point* grid_point,
     }
     return overlap;
 }
+
+static int coord_index(int value,
+                       const int* coords,
+                       int n_coords)
+{
+    const int* found =
+        bsearch(&value, coords, n_coords, sizeof(int), compare_ints);
+    g_assert(found != NULL);
+    return found - coords;
+}
+
+/* Fill INTEGRAL with the total overlap between the client RECTS and the
+   column from LEFT to LEFT + WIDTH, above each of the y COORDS.  RECT_TOP
+   and RECT_BOTTOM hold the index in COORDS of each rect's top and bottom
+   edge.  DENSITY is space for n_coords values. */
+static void column_integral(int left,
+                            int width,
+                            const Rect* rects,
+                            const int* rect_top,
+                            const int* rect_bottom,
+                            int n_rects,
+                            const int* coords,
+                            int n_coords,
+                            gint64* density,
+                            gint64* integral)
+{
+    int i;
+    memset(density, 0, n_coords * sizeof(gint64));
+    for (i = 0; i < n_rects; ++i) {
+        int overlap_width = MIN(left + width, rects[i].x + rects[i].width) -
+            MAX(left, rects[i].x);
+        if (overlap_width <= 0)
+            continue;
+        density[rect_top[i]] += overlap_width;
+        density[rect_bottom[i]] -= overlap_width;
+    }
+    gint64 d = 0;
+    integral[0] = 0;
+    for (i = 1; i < n_coords; ++i) {
+        d += density[i - 1];
+        integral[i] = integral[i - 1] + d * (coords[i] - coords[i - 1]);
+    }
+}
+
+/* Find the same placement as least_overlap_exhaustive(), trying the grid
+   points and directions in the same order.  The overlap of a placement is the
+   integral over it of the number of client rects covering each point.  So for
+   each column that a placement can be in, the widths of the client rects
+   inside the column are summed along the y axis, and integrated, once.  The
+   overlap of every placement in the column is then one subtraction.  This is
+   O(n) for each of the O(n) columns, so O(n^2). */
+static int least_overlap_sweep(const Rect* client_rects,
+                               int n_client_rects,
+                               const Rect* monitor,
+                               const Size* req_size,
+                               const int* x_edges,
+                               const int* y_edges,
+                               int max_edges,
+                               Point* result)
+{
+    int n_x_edges = 0, n_y_edges = 0;
+    while (n_x_edges < max_edges && x_edges[n_x_edges] != G_MAXINT)
+        ++n_x_edges;
+    while (n_y_edges < max_edges && y_edges[n_y_edges] != G_MAXINT)
+        ++n_y_edges;
+
+    /* placements are inside the monitor, so only the parts of the client
+       rects inside it can overlap them */
+    Rect* rects = g_new(Rect, n_client_rects);
+    int n_rects = 0;
+    int i, j;
+    for (i = 0; i < n_client_rects; ++i) {
+        if (!RECT_INTERSECTS_RECT(client_rects[i], *monitor))
+            continue;
+        RECT_SET_INTERSECTION(rects[n_rects], client_rects[i], *monitor);
+        ++n_rects;
+    }
+
+    /* the y coordinates of the placements in each row that fit on the
+       monitor, and of the client rects, are where the overlap changes */
+    int* coords = g_new(int, 4 * n_y_edges + 2 * n_rects);
+    int n_coords = 0;
+    for (j = 0; j < n_y_edges; ++j) {
+        int dir;
+        for (dir = 0; dir < 2; ++dir) {
+            int top = y_edges[j] - dir * req_size->height;
+            if (top < monitor->y ||
+                top + req_size->height > monitor->y + monitor->height)
+                continue;
+            coords[n_coords++] = top;
+            coords[n_coords++] = top + req_size->height;
+        }
+    }
+    for (i = 0; i < n_rects; ++i) {
+        coords[n_coords++] = rects[i].y;
+        coords[n_coords++] = rects[i].y + rects[i].height;
+    }
+
+    if (n_coords == 0) {
+        /* the window doesn't fit on the monitor anywhere */
+        g_free(coords);
+        g_free(rects);
+        return G_MAXINT;
+    }
+    qsort(coords, n_coords, sizeof(int), compare_ints);
+    n_coords = uniquify(coords, n_coords);
+
+    /* the index in coords of the top and bottom of each row's placements, or
+       -1 if they don't fit on the monitor */
+    int* row_top = g_new(int, 2 * n_y_edges);
+    int* row_bottom = g_new(int, 2 * n_y_edges);
+    for (j = 0; j < n_y_edges; ++j) {
+        int dir;
+        for (dir = 0; dir < 2; ++dir) {
+            int top = y_edges[j] - dir * req_size->height;
+            if (top < monitor->y ||
+                top + req_size->height > monitor->y + monitor->height)
+            {
+                row_top[2 * j + dir] = row_bottom[2 * j + dir] = -1;
+                continue;
+            }
+            row_top[2 * j + dir] = coord_index(top, coords, n_coords);
+            row_bottom[2 * j + dir] =
+                coord_index(top + req_size->height, coords, n_coords);
+        }
+    }
+    int* rect_top = g_new(int, n_rects);
+    int* rect_bottom = g_new(int, n_rects);
+    for (i = 0; i < n_rects; ++i) {
+        rect_top[i] = coord_index(rects[i].y, coords, n_coords);
+        rect_bottom[i] =
+            coord_index(rects[i].y + rects[i].height, coords, n_coords);
+    }
+
+    gint64 overlap = G_MAXINT;
+    gint64* density = g_new(gint64, n_coords);
+    gint64* integral[2] = {
+        g_new(gint64, n_coords), g_new(gint64, n_coords)
+    };
+    for (i = 0; i < n_x_edges && overlap != 0; ++i) {
+        /* the columns to the right and to the left of the grid point */
+        gboolean column_fits[2];
+        int dir;
+        for (dir = 0; dir < 2; ++dir) {
+            int left = x_edges[i] - dir * req_size->width;
+            column_fits[dir] = left >= monitor->x &&
+                left + req_size->width <= monitor->x + monitor->width;
+            if (column_fits[dir])
+                column_integral(left, req_size->width,
+                                rects, rect_top, rect_bottom, n_rects,
+                                coords, n_coords, density, integral[dir]);
+        }
+        if (!column_fits[0] && !column_fits[1])
+            continue;
+
+        for (j = 0; j < n_y_edges && overlap != 0; ++j) {
+            int d;
+            for (d = 0; d < NUM_DIRECTIONS && overlap != 0; ++d) {
+                int dx = -directions[d].width;
+                int dy = -directions[d].height;
+                int top = row_top[2 * j + dy];
+                int bottom = row_bottom[2 * j + dy];
+                if (!column_fits[dx] || top < 0)
+                    continue;
+                gint64 this_overlap = integral[dx][bottom] - integral[dx][top];
+                if (this_overlap < overlap) {
+                    overlap = this_overlap;
+                    result->x = x_edges[i] - dx * req_size->width;
+                    result->y = y_edges[j] - dy * req_size->height;
+                }
+            }
+        }
+    }
+
+    g_free(integral[0]);
+    g_free(integral[1]);
+    g_free(density);
+    g_free(rect_top);
+    g_free(rect_bottom);
+    g_free(row_top);
+    g_free(row_bottom);
+    g_free(coords);
+    g_free(rects);
+    return (int)MIN(overlap, G_MAXINT);
+}
@@ -18,8 +18,21 @@
 
 #include "geom.h"
 
+/* Find the place inside BOUNDS for a window of REQ_SIZE which overlaps the
+   CLIENT_RECTS least, by trying each corner of the window at each point on
+   the grid made by the rects' edges. */
 void place_overlap_find_least_placement(const Rect* client_rects,
                                         int n_client_rects,
                                         const Rect* bounds,
                                         const Size* req_size,
                                         Point* result);
+
+/* The same as place_overlap_find_least_placement(), but it adds up the
+   overlap with every client rect for every place it tries, so it takes
+   O(n^3) time instead of O(n^2).  It gives the same result, and is kept to
+   check against. */
+void place_overlap_find_least_placement_exhaustive(const Rect* client_rects,
+                                                   int n_client_rects,
+                                                   const Rect* bounds,
+                                                   const Size* req_size,
+                                                   Point* result);
@@ -27,6 +27,150 @@
 
 #include <glib.h>
 
+typedef struct _ObResistEdge ObResistEdge;
+
+struct _ObResistEdge {
+    /*! The x or y coordinate of the edge */
+    gint pos;
+    /*! The index in edges_targets of the window the edge belongs to */
+    guint target;
+};
+
+/*! The window that the edge index was built for, which is left out of it */
+static ObClient  *edges_client = NULL;
+static gboolean   edges_valid = FALSE;
+/*! The ObClient*s in the index, from the top of the stacking order down */
+static GPtrArray *edges_targets = NULL;
+/*! The left and right edges of the windows, as ObResistEdges sorted by their
+  position */
+static GArray    *edges_x = NULL;
+/*! The top and bottom edges of the windows, as ObResistEdges sorted by their
+  position */
+static GArray    *edges_y = NULL;
+/*! The indexes of the windows found by edges_find, sorted */
+static GArray    *edges_found = NULL;
+
+static gint edge_cmp(gconstpointer a, gconstpointer b)
+{
+    const ObResistEdge *ea = a, *eb = b;
+
+    return ea->pos < eb->pos ? -1 : (ea->pos > eb->pos);
+}
+
+static gint target_cmp(gconstpointer a, gconstpointer b)
+{
+    const guint *ta = a, *tb = b;
+
+    return *ta < *tb ? -1 : (*ta > *tb);
+}
+
+static void edges_build(ObClient *c)
+{
+    GList *it;
+
+    if (!edges_targets) {
+        edges_targets = g_ptr_array_new();
+        edges_x = g_array_new(FALSE, FALSE, sizeof(ObResistEdge));
+        edges_y = g_array_new(FALSE, FALSE, sizeof(ObResistEdge));
+        edges_found = g_array_new(FALSE, FALSE, sizeof(guint));
+    }
+    g_ptr_array_set_size(edges_targets, 0);
+    g_array_set_size(edges_x, 0);
+    g_array_set_size(edges_y, 0);
+
+    /* windows which are not visible are still put in the index, and skipped
+       when they are found, so that it doesn't change when they are shown or
+       hidden */
+    for (it = stacking_list; it; it = g_list_next(it)) {
+        ObClient *target;
+        ObResistEdge e;
+
+        if (!WINDOW_IS_CLIENT(it->data) || it->data == c)
+            continue;
+        target = it->data;
+
+        e.target = edges_targets->len;
+        e.pos = target->frame->area.x;
+        g_array_append_val(edges_x, e);
+        e.pos = target->frame->area.x + target->frame->area.width;
+        g_array_append_val(edges_x, e);
+        e.pos = target->frame->area.y;
+        g_array_append_val(edges_y, e);
+        e.pos = target->frame->area.y + target->frame->area.height;
+        g_array_append_val(edges_y, e);
+        g_ptr_array_add(edges_targets, target);
+    }
+    g_array_sort(edges_x, edge_cmp);
+    g_array_sort(edges_y, edge_cmp);
+
+    edges_client = c;
+    edges_valid = TRUE;
+}
+
+/*! Add the windows with an edge from @lo to @hi to edges_found */
+static void edges_find_axis(GArray *edges, gint lo, gint hi)
+{
+    guint l, r;
+
+    /* find the first edge at or after lo */
+    l = 0;
+    r = edges->len;
+    while (l < r) {
+        const guint m = l + (r - l) / 2;
+
+        if (g_array_index(edges, ObResistEdge, m).pos < lo)
+            l = m + 1;
+        else
+            r = m;
+    }
+
+    for (; l < edges->len; ++l) {
+        const ObResistEdge *e = &g_array_index(edges, ObResistEdge, l);
+
+        if (e->pos > hi) break;
+        g_array_append_val(edges_found, e->target);
+    }
+}
+
+/*! Find the windows with an edge inside the @area, leaving their indexes in
+  edges_found in the order they are stacked, from the top down */
+static void edges_find(ObClient *c, const Rect *area)
+{
+    if (!edges_valid || edges_client != c)
+        edges_build(c);
+
+    g_array_set_size(edges_found, 0);
+    edges_find_axis(edges_x, area->x, area->x + area->width - 1);
+    edges_find_axis(edges_y, area->y, area->y + area->height - 1);
+    g_array_sort(edges_found, target_cmp);
+}
+
+void resist_edges_start(ObClient *c)
+{
+    edges_build(c);
+}
+
+void resist_edges_end(void)
+{
+    if (edges_targets) {
+        g_ptr_array_free(edges_targets, TRUE);
+        g_array_free(edges_x, TRUE);
+        g_array_free(edges_y, TRUE);
+        g_array_free(edges_found, TRUE);
+        edges_targets = NULL;
+        edges_x = edges_y = edges_found = NULL;
+    }
+    edges_client = NULL;
+    edges_valid = FALSE;
+}
+
+void resist_edges_invalidate(ObClient *c)
+{
+    /* the window being moved isn't in the index, so it can move freely */
+    if (!c || c != edges_client)
+        edges_valid = FALSE;
+}
+
 static gboolean resist_move_window(Rect window,
                                    Rect target, gint resist,
                                    gint *x, gint *y)
@@ -101,20 +245,33 @@ static gboolean resist_move_window(Rect window,
 
 void resist_move_windows(ObClient *c, gint resist, gint *x, gint *y)
 {
-    GList *it;
-    Rect dock_area;
+    Rect dock_area, reach;
+    guint i;
 
     if (!resist) return;
 
     frame_client_gravity(c->frame, x, y);
 
-
-    for (it = stacking_list; it; it = g_list_next(it)) {
+    /* snapping only ever moves the window back towards where it is, so a
+       window can only be snapped to if it has an edge between where the
+       window is and where it is going */
+    RECT_SET(reach, MIN(*x, c->frame->area.x) - resist - 1,
+             MIN(*y, c->frame->area.y) - resist - 1,
+             ABS(*x - c->frame->area.x) + c->frame->area.width +
+             2 * (resist + 1),
+             ABS(*y - c->frame->area.y) + c->frame->area.height +
+             2 * (resist + 1));
+    edges_find(c, &reach);
+
+    /* go through them from the top of the stacking order down */
+    for (i = 0; i < edges_found->len; ++i) {
+        const guint t = g_array_index(edges_found, guint, i);
         ObClient *target;
 
-        if (!WINDOW_IS_CLIENT(it->data))
+        /* a window with edges on both axes is found twice */
+        if (i > 0 && t == g_array_index(edges_found, guint, i - 1))
             continue;
-        target = it->data;
+        target = g_ptr_array_index(edges_targets, t);
 
         /* don't snap to self or non-visibles */
         if (!target->frame->visible || target == c)
@@ -292,16 +449,30 @@ static gboolean resist_size_window(Rect window, Rect target, gint resist,
 void resist_size_windows(ObClient *c, gint resist, gint *w, gint *h,
                          ObDirection dir)
 {
-    GList *it;
     ObClient *target; /* target */
-    Rect dock_area;
+    Rect dock_area, reach;
+    gint dw, dh;
+    guint i;
 
     if (!resist) return;
 
-    for (it = stacking_list; it; it = g_list_next(it)) {
-        if (!WINDOW_IS_CLIENT(it->data))
+    /* snapping only ever moves the edge being dragged back towards where it
+       is, so a window can only be snapped to if it has an edge between
+       there and where the edge is going.  the window's size can change on
+       either side of it */
+    dw = ABS(*w - c->frame->area.width) + resist + 2;
+    dh = ABS(*h - c->frame->area.height) + resist + 2;
+    RECT_SET(reach, c->frame->area.x - dw, c->frame->area.y - dh,
+             c->frame->area.width + 2 * dw, c->frame->area.height + 2 * dh);
+    edges_find(c, &reach);
+
+    for (i = 0; i < edges_found->len; ++i) {
+        const guint t = g_array_index(edges_found, guint, i);
+
+        /* a window with edges on both axes is found twice */
+        if (i > 0 && t == g_array_index(edges_found, guint, i - 1))
             continue;
-        target = it->data;
+        target = g_ptr_array_index(edges_targets, t);
 
         /* don't snap to invisibles or ourself */
         if (!target->frame->visible || target == c)
@@ -25,6 +25,17 @@
 
 struct _ObClient;
 
+/*! Build an index of the edges of the windows that @c can be snapped to, so
+  that resist_move_windows and resist_size_windows don't have to look at
+  every window while @c is moved or resized */
+void resist_edges_start(struct _ObClient *c);
+/*! Free the index built by resist_edges_start */
+void resist_edges_end(void);
+/*! Tell the edge index that @c has moved or changed size, or that the
+  stacking order has changed if @c is NULL.  The index is built again the next
+  time it is used, unless @c is the window it was built for. */
+void resist_edges_invalidate(struct _ObClient *c);
+
 /*! @x The client's x destination (in the client's coordinates, not the frame's
     @y The client's y destination (in the client's coordinates, not the frame's
 */
@@ -0,0 +1,397 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   spatial.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "spatial.h"
+#include "client.h"
+#include "frame.h"
+#include "screen.h"
+
+/* the width and height of each cell in the grid, in pixels */
+#define CELL_SIZE 256
+
+typedef struct _ObSpatialKey   ObSpatialKey;
+typedef struct _ObSpatialEntry ObSpatialEntry;
+typedef struct _ObSpatialRange ObSpatialRange;
+
+struct _ObSpatialKey {
+    guint desktop;
+    gint x, y;
+};
+
+struct _ObSpatialEntry {
+    ObClient *client;
+    /*! Where the client is in the index, which may be out of date with the
+      client until spatial_update is called */
+    Rect area;
+    guint desktop;
+    /*! Entries are numbered in the order they are added, which is the order
+      of the client_list */
+    gulong serial;
+};
+
+/*! A search for the entries that meet a rectangle, for
+  g_hash_table_foreach */
+struct _ObSpatialRange {
+    guint desktop;
+    gboolean sticky;
+    const Rect *r;
+    GSList *found;
+};
+
+/*! Maps an ObSpatialKey* to a GSList of the ObSpatialEntry*s whose area
+  touches that cell */
+static GHashTable *cells = NULL;
+/*! Maps an ObClient* to its ObSpatialEntry* */
+static GHashTable *entries = NULL;
+static gulong      next_serial = 0;
+/*! The range of cells which have ever held an entry, the search for the
+  nearest client doesn't look beyond them */
+static gint        min_x, min_y, max_x, max_y;
+
+static guint key_hash(const ObSpatialKey *k)
+{
+    return k->desktop * 31 * 31 + (guint)k->x * 31 + (guint)k->y;
+}
+
+static gboolean key_equal(const ObSpatialKey *a, const ObSpatialKey *b)
+{
+    return a->desktop == b->desktop && a->x == b->x && a->y == b->y;
+}
+
+static void cell_list_free(GSList *list)
+{
+    g_slist_free(list);
+}
+
+/*! Returns the cell that a coordinate is in, rounding down for negative
+  coordinates too */
+static gint cell_of(gint v)
+{
+    return v >= 0 ? v / CELL_SIZE : -((-v - 1) / CELL_SIZE) - 1;
+}
+
+void spatial_startup(gboolean reconfig)
+{
+    if (reconfig) return;
+
+    cells = g_hash_table_new_full((GHashFunc)key_hash,
+                                  (GEqualFunc)key_equal,
+                                  g_free, (GDestroyNotify)cell_list_free);
+    entries = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                    NULL, g_free);
+    next_serial = 0;
+    min_x = min_y = G_MAXINT;
+    max_x = max_y = G_MININT;
+}
+
+void spatial_shutdown(gboolean reconfig)
+{
+    if (reconfig) return;
+
+    g_hash_table_destroy(cells);
+    cells = NULL;
+    g_hash_table_destroy(entries);
+    entries = NULL;
+}
+
+static void entry_insert(ObSpatialEntry *e)
+{
+    ObSpatialKey k, *nk;
+    gint x1, y1, x2, y2;
+
+    x1 = cell_of(e->area.x);
+    y1 = cell_of(e->area.y);
+    x2 = cell_of(e->area.x + MAX(e->area.width, 1) - 1);
+    y2 = cell_of(e->area.y + MAX(e->area.height, 1) - 1);
+
+    min_x = MIN(min_x, x1);
+    min_y = MIN(min_y, y1);
+    max_x = MAX(max_x, x2);
+    max_y = MAX(max_y, y2);
+
+    k.desktop = e->desktop;
+    for (k.y = y1; k.y <= y2; ++k.y)
+        for (k.x = x1; k.x <= x2; ++k.x) {
+            GSList *list;
+
+            if ((list = g_hash_table_lookup(cells, &k)))
+                /* the list's head doesn't change, so the cell keeps it */
+                list->next = g_slist_prepend(list->next, e);
+            else {
+                nk = g_memdup(&k, sizeof(ObSpatialKey));
+                g_hash_table_insert(cells, nk, g_slist_prepend(NULL, e));
+            }
+        }
+}
+
+static void entry_erase(ObSpatialEntry *e)
+{
+    ObSpatialKey k;
+    gint x1, y1, x2, y2;
+
+    x1 = cell_of(e->area.x);
+    y1 = cell_of(e->area.y);
+    x2 = cell_of(e->area.x + MAX(e->area.width, 1) - 1);
+    y2 = cell_of(e->area.y + MAX(e->area.height, 1) - 1);
+
+    k.desktop = e->desktop;
+    for (k.y = y1; k.y <= y2; ++k.y)
+        for (k.x = x1; k.x <= x2; ++k.x) {
+            GSList *list, *nlist;
+
+            list = g_hash_table_lookup(cells, &k);
+            g_assert(list != NULL);
+            if (list->data == e && !list->next)
+                g_hash_table_remove(cells, &k);
+            else if (list->data == e) {
+                /* keep the head so the cell's list stays the same */
+                nlist = list->next;
+                list->data = nlist->data;
+                list->next = g_slist_delete_link(nlist, nlist);
+            }
+            else
+                list->next = g_slist_remove(list->next, e);
+        }
+}
+
+void spatial_add(ObClient *c)
+{
+    ObSpatialEntry *e;
+
+    g_assert(g_hash_table_lookup(entries, c) == NULL);
+
+    e = g_new(ObSpatialEntry, 1);
+    e->client = c;
+    e->area = c->frame->area;
+    e->desktop = c->desktop;
+    e->serial = next_serial++;
+    g_hash_table_insert(entries, c, e);
+    entry_insert(e);
+}
+
+void spatial_update(ObClient *c)
+{
+    ObSpatialEntry *e;
+
+    if (!entries || !(e = g_hash_table_lookup(entries, c)))
+        return;
+    if (RECT_EQUAL(e->area, c->frame->area) && e->desktop == c->desktop)
+        return;
+
+    entry_erase(e);
+    e->area = c->frame->area;
+    e->desktop = c->desktop;
+    entry_insert(e);
+}
+
+void spatial_remove(ObClient *c)
+{
+    ObSpatialEntry *e;
+
+    if ((e = g_hash_table_lookup(entries, c))) {
+        entry_erase(e);
+        g_hash_table_remove(entries, c);
+    }
+    if (g_hash_table_size(entries) == 0) {
+        min_x = min_y = G_MAXINT;
+        max_x = max_y = G_MININT;
+    }
+}
+
+static gint entry_cmp(gconstpointer a, gconstpointer b)
+{
+    const ObSpatialEntry *ea = a, *eb = b;
+
+    return ea->serial < eb->serial ? -1 : (ea->serial > eb->serial);
+}
+
+/*! Turns a list of ObSpatialEntry*s into a list of their clients, in the order
+  of the client_list */
+static GSList* entries_to_clients(GSList *list)
+{
+    GSList *it;
+
+    list = g_slist_sort(list, entry_cmp);
+    for (it = list; it; it = g_slist_next(it))
+        it->data = ((ObSpatialEntry*)it->data)->client;
+    return list;
+}
+
+static void find_range_entry(gpointer key, gpointer val, gpointer data)
+{
+    ObSpatialEntry *e = val;
+    ObSpatialRange *s = data;
+
+    if ((e->desktop == s->desktop ||
+         (s->sticky && e->desktop == DESKTOP_ALL)) &&
+        RECT_INTERSECTS_RECT(e->area, *s->r))
+        s->found = g_slist_prepend(s->found, e);
+}
+
+GSList* spatial_find_range(guint desktop, gboolean sticky, const Rect *r)
+{
+    ObSpatialKey k;
+    GSList *found = NULL;
+    gint x1, y1, x2, y2, i;
+
+    if (r->width <= 0 || r->height <= 0)
+        return NULL;
+
+    x1 = cell_of(r->x);
+    y1 = cell_of(r->y);
+    x2 = cell_of(r->x + r->width - 1);
+    y2 = cell_of(r->y + r->height - 1);
+
+    /* don't look at more cells than there are clients to look at */
+    if ((gdouble)(x2 - x1 + 1) * (y2 - y1 + 1) >
+        g_hash_table_size(entries))
+    {
+        ObSpatialRange s;
+
+        s.desktop = desktop;
+        s.sticky = sticky;
+        s.r = r;
+        s.found = NULL;
+        g_hash_table_foreach(entries, find_range_entry, &s);
+        return entries_to_clients(s.found);
+    }
+
+    for (i = 0; i < 2; ++i) {
+        if (i == 0)
+            k.desktop = desktop;
+        else if (sticky && desktop != DESKTOP_ALL)
+            k.desktop = DESKTOP_ALL;
+        else
+            break;
+
+        for (k.y = y1; k.y <= y2; ++k.y)
+            for (k.x = x1; k.x <= x2; ++k.x) {
+                GSList *it;
+
+                for (it = g_hash_table_lookup(cells, &k); it;
+                     it = g_slist_next(it))
+                {
+                    ObSpatialEntry *e = it->data;
+
+                    /* an entry that spans several cells is only taken from
+                       the first cell where it meets the rectangle */
+                    if (k.x == MAX(cell_of(e->area.x), x1) &&
+                        k.y == MAX(cell_of(e->area.y), y1) &&
+                        RECT_INTERSECTS_RECT(e->area, *r))
+                        found = g_slist_prepend(found, e);
+                }
+            }
+    }
+    return entries_to_clients(found);
+}
+
+GSList* spatial_find_point(guint desktop, gboolean sticky, gint x, gint y)
+{
+    ObSpatialKey k;
+    GSList *found = NULL;
+    gint i;
+
+    k.x = cell_of(x);
+    k.y = cell_of(y);
+    for (i = 0; i < 2; ++i) {
+        GSList *it;
+
+        if (i == 0)
+            k.desktop = desktop;
+        else if (sticky && desktop != DESKTOP_ALL)
+            k.desktop = DESKTOP_ALL;
+        else
+            break;
+
+        for (it = g_hash_table_lookup(cells, &k); it; it = g_slist_next(it)) {
+            ObSpatialEntry *e = it->data;
+
+            if (RECT_CONTAINS(e->area, x, y))
+                found = g_slist_prepend(found, e);
+        }
+    }
+    return entries_to_clients(found);
+}
+
+ObClient* spatial_find_nearest(guint desktop, gboolean sticky,
+                               gint x, gint y,
+                               ObSpatialScoreFunc score, gpointer data)
+{
+    ObSpatialEntry *best = NULL;
+    gint best_score = -1;
+    gint ox, oy, ring, last_ring, i;
+
+    if (g_hash_table_size(entries) == 0)
+        return NULL;
+
+    ox = cell_of(x);
+    oy = cell_of(y);
+    /* the ring of cells past which there is nothing */
+    last_ring = MAX(MAX(ox - min_x, max_x - ox), MAX(oy - min_y, max_y - oy));
+
+    /* look at rings of cells around the point, further out each time.  the
+       clients are looked at in the cell which their centre is in, and the
+       centres in a ring are at least this far away */
+    for (ring = 0; ring <= last_ring; ++ring) {
+        if (best && ring > 0 && (ring - 1) * CELL_SIZE >= best_score)
+            break;
+
+        for (i = 0; i < 2; ++i) {
+            ObSpatialKey k;
+
+            if (i == 0)
+                k.desktop = desktop;
+            else if (sticky && desktop != DESKTOP_ALL)
+                k.desktop = DESKTOP_ALL;
+            else
+                break;
+
+            for (k.y = oy - ring; k.y <= oy + ring; ++k.y) {
+                /* only the outside of the ring, so skip over the middle of
+                   the rows between its top and bottom */
+                const gint step = (ring == 0 || k.y == oy - ring ||
+                                   k.y == oy + ring) ? 1 : ring * 2;
+
+                for (k.x = ox - ring; k.x <= ox + ring; k.x += step) {
+                    GSList *it;
+
+                    for (it = g_hash_table_lookup(cells, &k); it;
+                         it = g_slist_next(it))
+                    {
+                        ObSpatialEntry *e = it->data;
+                        gint s;
+
+                        if (cell_of(e->area.x + e->area.width / 2) != k.x ||
+                            cell_of(e->area.y + e->area.height / 2) != k.y)
+                            continue;
+
+                        s = score(e->client, data);
+                        if (s < 0) continue;
+                        if (!best || s < best_score ||
+                            (s == best_score && e->serial < best->serial))
+                        {
+                            best = e;
+                            best_score = s;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return best ? best->client : NULL;
+}
@@ -0,0 +1,80 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   spatial.h for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __spatial_h
+#define __spatial_h
+
+#include "geom.h"
+
+#include <glib.h>
+
+struct _ObClient;
+
+/*! Scores a client for spatial_find_nearest.  The smaller the score the
+  better, and a negative score means the client can't be chosen.  The score
+  must be no less than the distance from the point being searched from to the
+  centre of the client's frame, measured along whichever axis it is furthest
+  on, so that the search knows when it can stop. */
+typedef gint (*ObSpatialScoreFunc)(struct _ObClient *c, gpointer data);
+
+/* The spatial index keeps the frame area of every managed client in a grid of
+   cells, one grid for each desktop, so that the clients in some part of the
+   screen can be found without looking at all of them.  Clients on all
+   desktops have a grid of their own. */
+
+void spatial_startup(gboolean reconfig);
+void spatial_shutdown(gboolean reconfig);
+
+/*! Add a client to the index, at its frame's area and its desktop */
+void spatial_add(struct _ObClient *c);
+/*! Move a client in the index, when its frame's area or its desktop has
+  changed.  Clients which are not in the index are ignored. */
+void spatial_update(struct _ObClient *c);
+/*! Remove a client from the index */
+void spatial_remove(struct _ObClient *c);
+
+/*! Find the clients whose frames intersect a rectangle.
+  @param desktop The desktop to look on
+  @param sticky Also look at the clients that are on all desktops
+  @return A list of ObClient*s, in the order they are in the client_list.  It
+    must be freed by the caller.
+*/
+GSList* spatial_find_range(guint desktop, gboolean sticky, const Rect *r);
+
+/*! Find the clients whose frames contain a point.
+  @param desktop The desktop to look on
+  @param sticky Also look at the clients that are on all desktops
+  @return A list of ObClient*s, in the order they are in the client_list.  It
+    must be freed by the caller.
+*/
+GSList* spatial_find_point(guint desktop, gboolean sticky, gint x, gint y);
+
+/*! Find the client with the best (smallest) score, looking outwards from a
+  point.  Clients with the same score are chosen in the order they are in the
+  client_list.
+  @param desktop The desktop to look on
+  @param sticky Also look at the clients that are on all desktops
+  @return The chosen client, or NULL if every client was given a negative
+    score
+*/
+struct _ObClient* spatial_find_nearest(guint desktop, gboolean sticky,
+                                       gint x, gint y,
+                                       ObSpatialScoreFunc score,
+                                       gpointer data);
+
+#endif
@@ -25,43 +25,408 @@
 #include "frame.h"
 #include "window.h"
 #include "event.h"
+#include "resist.h"
 #include "debug.h"
 #include "obt/prop.h"
 
 GList  *stacking_list = NULL;
 GList  *stacking_list_tail = NULL;
+
+typedef struct _ObStackingEntry ObStackingEntry;
+
+struct _ObStackingEntry {
+    /*! The window's link in the stacking_list, or NULL while it is taken out
+      to be restacked */
+    GList *link;
+    /*! The layer the window was in when it was put in the stacking_list.  A
+      client's layer can change before it is taken out to be restacked. */
+    ObStackingLayer layer;
+    /*! Where the window is in the stacking order on the server, windows
+      higher up have a higher rank.  This is only valid if ranked is TRUE. */
+    gint64 rank;
+    gboolean ranked;
+};
+
+/* the ranks are kept between these, so that the difference between any two
+   of them fits in a gint64 */
+#define RANK_TOP     (G_GINT64_CONSTANT(1) << 61)
+#define RANK_BOTTOM  (-RANK_TOP)
+/* the space between windows' ranks when they are all given new ones */
+#define RANK_SPACING (G_GINT64_CONSTANT(1) << 32)
+
+/*! Maps an ObWindow* to its ObStackingEntry*, so that its place in the
+  stacking_list can be found without searching for it */
+static GHashTable *stacking_entries = NULL;
+/*! The highest link in the stacking_list for each layer, or NULL if the layer
+  is empty */
+static GList *layer_top[OB_NUM_STACKING_LAYERS] = {NULL};
 /*! When true, stacking changes will not be reflected on the screen.  This is
   to freeze the on-screen stacking order while a window is being temporarily
   raised during focus cycling */
 static gboolean pause_changes = FALSE;
 
+/*! The _NET_CLIENT_LIST_STACKING last set on the root window, gulongs */
+static GArray *stacking_published = NULL;
+static guint   stacking_list_idle = 0;
+static gboolean stacking_list_dirty = FALSE;
+
+/*! The number of windows which have been restacked */
+static gulong restack_windows_total = 0;
+/*! The number of restacked windows which were out of order on the server, and
+  had to be moved there */
+static gulong restack_windows_moved = 0;
+
+static gboolean stacking_list_idle_func(gpointer data)
+{
+    stacking_list_idle = 0;
+    stacking_flush_list();
+    return FALSE; /* don't repeat */
+}
+
 void stacking_set_list(void)
 {
-    Window *windows = NULL;
+    /* windows snap to the ones highest in the stacking order first */
+    resist_edges_invalidate(NULL);
+
+    /* restacks come in bunches, so publish the result once they have all
+       been handled */
+    stacking_list_dirty = TRUE;
+    if (!stacking_list_idle)
+        stacking_list_idle = g_idle_add_full(G_PRIORITY_DEFAULT,
+                                             stacking_list_idle_func,
+                                             NULL, NULL);
+}
+
+void stacking_flush_list(void)
+{
+    gulong *windows = NULL;
     GList *it;
     guint i = 0;
 
+    if (stacking_list_idle) {
+        g_source_remove(stacking_list_idle);
+        stacking_list_idle = 0;
+    }
+
     /* on shutdown, don't update the properties, so that we can read it back
        in on startup and re-stack the windows as they were before we shut down
     */
-    if (ob_state() == OB_STATE_EXITING) return;
+    if (ob_state() == OB_STATE_EXITING) {
+        if (stacking_published) g_array_free(stacking_published, TRUE);
+        stacking_published = NULL;
+        stacking_list_dirty = FALSE;
+        return;
+    }
+
+    if (!stacking_list_dirty) return;
+    stacking_list_dirty = FALSE;
+
+    if (!stacking_published)
+        stacking_published = g_array_new(FALSE, FALSE, sizeof(gulong));
 
     /* create an array of the window ids (from bottom to top,
        reverse order!) */
     if (stacking_list) {
-        windows = g_new(Window, g_list_length(stacking_list));
-        for (it = g_list_last(stacking_list); it; it = g_list_previous(it)) {
+        windows = g_new(gulong, g_list_length(stacking_list));
+        for (it = stacking_list_tail; it; it = g_list_previous(it)) {
             if (WINDOW_IS_CLIENT(it->data))
                 windows[i++] = WINDOW_AS_CLIENT(it->data)->window;
         }
     }
 
-    OBT_PROP_SETA32(obt_root(ob_screen), NET_CLIENT_LIST_STACKING, WINDOW,
-                    (gulong*)windows, i);
+    /* a new window mapped on top of everything only needs to be appended */
+    OBT_PROP_UPDATEA32(obt_root(ob_screen), NET_CLIENT_LIST_STACKING, WINDOW,
+                       stacking_published, windows, i);
 
     g_free(windows);
 }
 
+static void entry_free(ObStackingEntry *e)
+{
+    g_slice_free(ObStackingEntry, e);
+}
+
+static GList* find_link(ObWindow *win)
+{
+    ObStackingEntry *e;
+
+    e = stacking_entries ? g_hash_table_lookup(stacking_entries, win) : NULL;
+    return e ? e->link : NULL;
+}
+
+static ObStackingLayer link_layer(GList *link)
+{
+    ObStackingEntry *e = g_hash_table_lookup(stacking_entries, link->data);
+    return e->layer;
+}
+
+/*! Returns the highest link in the layer, or in the highest layer below it
+  which has any windows in it.  This is where a window would go to be at the
+  top of the layer. */
+static GList* layer_first(gint layer)
+{
+    for (; layer >= 0; --layer)
+        if (layer_top[layer])
+            return layer_top[layer];
+    return NULL;
+}
+
+/*! Put a window into the stacking_list above the before link, or at the bottom
+  if before is NULL */
+static void list_insert(ObWindow *win, GList *before)
+{
+    ObStackingEntry *e;
+    GList *link;
+
+    if (!stacking_entries)
+        stacking_entries = g_hash_table_new_full(
+            g_direct_hash, g_direct_equal,
+            NULL, (GDestroyNotify)entry_free);
+    e = g_hash_table_lookup(stacking_entries, win);
+    g_assert(e == NULL || e->link == NULL);
+
+    if (before) {
+        stacking_list = g_list_insert_before(stacking_list, before, win);
+        link = g_list_previous(before);
+    }
+    else if (stacking_list_tail) {
+        /* append after the tail, so it doesn't walk the whole list */
+        g_list_append(stacking_list_tail, win);
+        link = stacking_list_tail = g_list_next(stacking_list_tail);
+    }
+    else
+        link = stacking_list = stacking_list_tail = g_list_append(NULL, win);
+
+    /* a window being restacked keeps its entry, and so its rank */
+    if (!e) {
+        e = g_slice_new(ObStackingEntry);
+        e->ranked = FALSE;
+        g_hash_table_insert(stacking_entries, win, e);
+    }
+    e->link = link;
+    e->layer = window_layer(win);
+
+    /* it is the top of its layer if the layer was empty, or if it went right
+       above the window that was on top.  anywhere else, the layer has a
+       higher window already, even when it is put at the bottom of the list
+       for a moment by stacking_add() */
+    if (!layer_top[e->layer] || g_list_next(link) == layer_top[e->layer])
+        layer_top[e->layer] = link;
+}
+
+#ifdef DEBUG
+/*! Check that the index of the stacking_list matches the list */
+static void check_index(void)
+{
+    GList *top[OB_NUM_STACKING_LAYERS] = {NULL};
+    GList *it;
+    gint i;
+
+    for (it = stacking_list; it; it = g_list_next(it)) {
+        ObStackingEntry *e = g_hash_table_lookup(stacking_entries, it->data);
+
+        g_assert(e && e->link == it);
+        if (!top[e->layer])
+            top[e->layer] = it;
+        if (!g_list_next(it))
+            g_assert(stacking_list_tail == it);
+    }
+    if (!stacking_list)
+        g_assert(stacking_list_tail == NULL);
+    for (i = 0; i < OB_NUM_STACKING_LAYERS; ++i)
+        g_assert(layer_top[i] == top[i]);
+}
+#endif
+
+/*! Take a window out of the stacking_list to restack it, if it is in it.  It
+  keeps its rank, since it is still in the same place on the server. */
+static void list_remove(ObWindow *win)
+{
+    ObStackingEntry *e;
+    GList *link, *next;
+
+    if (!stacking_entries ||
+        !(e = g_hash_table_lookup(stacking_entries, win)) || !e->link)
+        return;
+    link = e->link;
+    next = g_list_next(link);
+
+    if (layer_top[e->layer] == link)
+        layer_top[e->layer] =
+            (next && link_layer(next) == e->layer) ? next : NULL;
+    if (stacking_list_tail == link)
+        stacking_list_tail = g_list_previous(link);
+    stacking_list = g_list_delete_link(stacking_list, link);
+    e->link = NULL;
+}
+
+void stacking_remove(gpointer win)
+{
+    list_remove(win);
+    if (stacking_entries)
+        g_hash_table_remove(stacking_entries, win);
+}
+
+static void entry_unrank(gpointer key, gpointer val, gpointer data)
+{
+    ObStackingEntry *e = val;
+    e->ranked = FALSE;
+}
+
+/*! Give every window in the stacking_list a new rank, after the server has
+  been given their whole stacking order */
+static void rank_all(void)
+{
+    ObStackingEntry *e;
+    GList *it;
+    gint64 rank;
+
+    if (!stacking_entries) return;
+
+    /* windows taken out of the stacking_list weren't part of it */
+    g_hash_table_foreach(stacking_entries, entry_unrank, NULL);
+
+    rank = RANK_TOP;
+    for (it = stacking_list; it; it = g_list_next(it)) {
+        e = g_hash_table_lookup(stacking_entries, it->data);
+        rank -= RANK_SPACING;
+        e->rank = rank;
+        e->ranked = TRUE;
+    }
+}
+
+/*! Send the whole stacking order to the server */
+static void restack_all(void)
+{
+    Window *win;
+    GList *it;
+    gint i;
+
+    win = g_new(Window, g_list_length(stacking_list) + 1);
+    win[0] = screen_support_win;
+    for (i = 1, it = stacking_list; it; ++i, it = g_list_next(it))
+        win[i] = window_top(it->data);
+    XRestackWindows(obt_display, win, i);
+    g_free(win);
+    rank_all();
+}
+
+/*! Restack the windows on the server, after they have been put together in
+  the stacking_list.  Windows which are already in the right order between
+  the windows around them are left alone, and the rest are moved one at a
+  time to below the window above them.
+  @param wins The windows, from the top down
+  @param win The window above them, followed by each of their top-level
+             windows
+  @param n The number of windows in wins
+  @return The number of windows moved
+*/
+static gint restack_server(GList *wins, Window *win, gint n)
+{
+    ObStackingEntry **e, *above, *below;
+    GList *it;
+    gint64 hi, lo, p, q, step;
+    gint *tails, *prev;
+    gboolean *keep, rerank = FALSE;
+    gint i, j, k, len, moved;
+
+    e = g_new(ObStackingEntry*, n);
+    for (i = 0, it = wins; it; ++i, it = g_list_next(it))
+        e[i] = g_hash_table_lookup(stacking_entries, it->data);
+
+    /* the windows the restacked ones go between, which are not moving */
+    above = g_list_previous(e[0]->link) ?
+        g_hash_table_lookup(stacking_entries,
+                            g_list_previous(e[0]->link)->data) : NULL;
+    below = g_list_next(e[n-1]->link) ?
+        g_hash_table_lookup(stacking_entries,
+                            g_list_next(e[n-1]->link)->data) : NULL;
+
+    if ((above && !above->ranked) || (below && !below->ranked)) {
+        /* don't know where the windows around them are on the server, so
+           restack everything */
+        restack_all();
+        g_free(e);
+        return n;
+    }
+    hi = above ? above->rank : RANK_TOP;
+    lo = below ? below->rank : RANK_BOTTOM;
+
+    /* find the longest run of windows which are between the windows above
+       and below, and are already in order, by their rank going down.  those
+       ones can stay where they are */
+    tails = g_new(gint, n);
+    prev = g_new(gint, n);
+    keep = g_new0(gboolean, n);
+    len = 0;
+    for (i = 0; i < n; ++i) {
+        gint l, r;
+
+        if (!e[i]->ranked || e[i]->rank >= hi || e[i]->rank <= lo)
+            continue;
+
+        /* tails[l] is the last window of the best run of length l+1 found so
+           far, the one with the highest rank */
+        l = 0;
+        r = len;
+        while (l < r) {
+            const gint m = l + (r - l) / 2;
+
+            if (e[tails[m]]->rank > e[i]->rank)
+                l = m + 1;
+            else
+                r = m;
+        }
+        prev[i] = l > 0 ? tails[l-1] : -1;
+        tails[l] = i;
+        if (l == len) ++len;
+    }
+    for (i = len > 0 ? tails[len-1] : -1; i >= 0; i = prev[i])
+        keep[i] = TRUE;
+
+    /* move the others, from the top down, to below the window above them,
+       and give them ranks between the windows around them */
+    moved = 0;
+    p = hi;
+    for (i = 0; i < n; i = j) {
+        if (keep[i]) {
+            p = e[i]->rank;
+            j = i + 1;
+            continue;
+        }
+
+        for (j = i; j < n && !keep[j]; ++j) {
+            XWindowChanges changes;
+
+            changes.sibling = win[j];
+            changes.stack_mode = Below;
+            XConfigureWindow(obt_display, win[j+1], CWSibling | CWStackMode,
+                             &changes);
+        }
+        moved += j - i;
+
+        q = j < n ? e[j]->rank : lo;
+        if (p - q <= j - i)
+            /* there's no room between them */
+            rerank = TRUE;
+        else {
+            step = (p - q) / (j - i + 1);
+            for (k = i; k < j; ++k) {
+                e[k]->rank = p - step * (k - i + 1);
+                e[k]->ranked = TRUE;
+            }
+        }
+    }
+    if (rerank)
+        rank_all();
+
+    g_free(keep);
+    g_free(prev);
+    g_free(tails);
+    g_free(e);
+    return moved;
+}
+
 static void do_restack(GList *wins, GList *before)
 {
     GList *it;
@@ -87,7 +452,7 @@ static void do_restack(GList *wins, GList *before)
     if (before == stacking_list)
         win[0] = screen_support_win;
     else if (!before)
-        win[0] = window_top(g_list_last(stacking_list)->data);
+        win[0] = window_top(stacking_list_tail->data);
     else
         win[0] = window_top(g_list_previous(before)->data);
 
@@ -95,7 +460,7 @@ static void do_restack(GList *wins, GList *before)
         win[i] = window_top(it->data);
         g_assert(win[i] != None); /* better not call stacking shit before
                                      setting your top level window value */
-        stacking_list = g_list_insert_before(stacking_list, before, it->data);
+        list_insert(it->data, before);
     }
 
 #ifdef DEBUG
@@ -105,10 +470,18 @@ static void do_restack(GList *wins, GList *before)
         if (!next) break;
         g_assert(window_layer(it->data) >= window_layer(next->data));
     }
+    check_index();
 #endif
 
-    if (!pause_changes)
-        XRestackWindows(obt_display, win, i);
+    if (!pause_changes) {
+        gint moved = restack_server(wins, win, i - 1);
+
+        restack_windows_total += i - 1;
+        restack_windows_moved += moved;
+        ob_debug("Restacked %d windows, %d were out of order "
+                 "(%lu of %lu so far)", i - 1, moved,
+                 restack_windows_moved, restack_windows_total);
+    }
     g_free(win);
 
     stacking_set_list();
@@ -143,19 +516,11 @@ void stacking_temp_raise(ObWindow *window)
 
 void stacking_restore(void)
 {
-    Window *win;
-    GList *it;
-    gint i;
     gulong start;
 
-    win = g_new(Window, g_list_length(stacking_list) + 1);
-    win[0] = screen_support_win;
-    for (i = 1, it = stacking_list; it; ++i, it = g_list_next(it))
-        win[i] = window_top(it->data);
     start = event_start_ignore_all_enters();
-    XRestackWindows(obt_display, win, i);
+    restack_all();
     event_end_ignore_all_enters(start);
-    g_free(win);
 
     pause_changes = FALSE;
 }
@@ -173,14 +538,10 @@ static void do_raise(GList *wins)
         layer[l] = g_list_append(layer[l], it->data);
     }
 
-    it = stacking_list;
     for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
         if (layer[i]) {
-            for (; it; it = g_list_next(it)) {
-                /* look for the top of the layer */
-                if (window_layer(it->data) <= (ObStackingLayer) i)
-                    break;
-            }
+            /* the top of the layer */
+            it = layer_first(i);
             do_restack(layer[i], it);
             g_list_free(layer[i]);
         }
@@ -200,14 +561,10 @@ static void do_lower(GList *wins)
         layer[l] = g_list_append(layer[l], it->data);
     }
 
-    it = stacking_list;
     for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
         if (layer[i]) {
-            for (; it; it = g_list_next(it)) {
-                /* look for the top of the next layer down */
-                if (window_layer(it->data) < (ObStackingLayer) i)
-                    break;
-            }
+            /* the top of the next layer down */
+            it = layer_first(i - 1);
             do_restack(layer[i], it);
             g_list_free(layer[i]);
         }
@@ -216,7 +573,7 @@ static void do_lower(GList *wins)
 
 static void restack_windows(ObClient *selected, gboolean raise)
 {
-    GList *it, *last, *below, *above, *next;
+    GList *it, *below, *above, *next;
     GList *wins = NULL;
 
     GList *group_helpers = NULL;
@@ -235,14 +592,17 @@ static void restack_windows(ObClient *selected, gboolean raise)
     }
 
     /* remove first so we can't run into ourself */
-    it = g_list_find(stacking_list, selected);
-    g_assert(it);
-    stacking_list = g_list_delete_link(stacking_list, it);
-
-    /* go from the bottom of the stacking list up. don't move any other windows
-       when lowering, we call this for each window independently */
-    if (raise) {
-        for (it = g_list_last(stacking_list); it; it = next) {
+    g_assert(find_link(CLIENT_AS_WINDOW(selected)));
+    list_remove(CLIENT_AS_WINDOW(selected));
+
+    /* go from the bottom of the selected window's layer up. don't move any
+       other windows when lowering, we call this for each window
+       independently.  only its transients can be moved, so don't look if it
+       has none */
+    if (raise && selected->transients) {
+        it = layer_first(selected->layer - 1);
+        it = it ? g_list_previous(it) : stacking_list_tail;
+        for (; it && link_layer(it) <= selected->layer; it = next) {
             next = g_list_previous(it);
 
             if (WINDOW_IS_CLIENT(it->data)) {
@@ -273,7 +633,7 @@ static void restack_windows(ObClient *selected, gboolean raise)
                         else
                             group_trans = g_list_prepend(group_trans, ch);
                     }
-                    stacking_list = g_list_delete_link(stacking_list, it);
+                    list_remove(it->data);
                 }
             }
         }
@@ -299,33 +659,14 @@ static void restack_windows(ObClient *selected, gboolean raise)
         group_trans = NULL;
     }
 
-    /* find where to put the selected window, start from bottom of list,
-       this is the window below everything we are re-adding to the list */
-    last = NULL;
-    for (it = g_list_last(stacking_list); it; it = g_list_previous(it))
-    {
-        if (window_layer(it->data) < selected->layer) {
-            last = it;
-            continue;
-        }
-        /* if lowering, stop at the beginning of the layer */
-        if (!raise)
-            break;
-        /* if raising, stop at the end of the layer */
-        if (window_layer(it->data) > selected->layer)
-            break;
-
-        last = it;
-    }
-
-    /* save this position in the stacking list */
-    below = last;
+    /* find where to put the selected window, this is the window below
+       everything we are re-adding to the list.  if raising, it is the top of
+       the layer, and if lowering, it is the top of the layer below */
+    below = layer_first(raise ? selected->layer : selected->layer - 1);
 
-    /* find where to put the group transients, start from the top of list */
-    for (it = stacking_list; it; it = g_list_next(it)) {
-        /* skip past higher layers */
-        if (window_layer(it->data) > selected->layer)
-            continue;
+    /* find where to put the group transients, start from the top of the
+       layer, past the higher layers */
+    for (it = layer_first(selected->layer); it; it = g_list_next(it)) {
         /* if we reach the end of the layer (how?) then don't go further */
         if (window_layer(it->data) < selected->layer)
             break;
@@ -348,17 +689,17 @@ static void restack_windows(ObClient *selected, gboolean raise)
        we actually want to save 1 position _above_ that, for for loops to work
        nicely, so move back one position in the list while saving it
     */
-    above = it ? g_list_previous(it) : g_list_last(stacking_list);
+    above = it ? g_list_previous(it) : stacking_list_tail;
 
     /* put the windows inside the gap to the other windows we're stacking
        into the restacking list, go from the bottom up so that we can use
        g_list_prepend */
     if (below) it = g_list_previous(below);
-    else       it = g_list_last(stacking_list);
+    else       it = stacking_list_tail;
     for (; it != above; it = next) {
         next = g_list_previous(it);
         wins = g_list_prepend(wins, it->data);
-        stacking_list = g_list_delete_link(stacking_list, it);
+        list_remove(it->data);
     }
 
     /* group transients go above the rest of the stuff acquired to now */
@@ -377,7 +718,7 @@ static void restack_windows(ObClient *selected, gboolean raise)
         parents_copy = g_slist_copy(selected->parents);
 
         /* go thru stacking list backwards so we can use g_slist_prepend */
-        for (it = g_list_last(stacking_list); it && parents_copy;
+        for (it = stacking_list_tail; it && parents_copy;
              it = g_list_previous(it))
             if ((sit = g_slist_find(parents_copy, it->data))) {
                 reorder = g_slist_prepend(reorder, sit->data);
@@ -400,11 +741,10 @@ void stacking_raise(ObWindow *window)
     } else {
         GList *wins;
         wins = g_list_append(NULL, window);
-        stacking_list = g_list_remove(stacking_list, window);
+        list_remove(window);
         do_raise(wins);
         g_list_free(wins);
     }
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_lower(ObWindow *window)
@@ -416,11 +756,10 @@ void stacking_lower(ObWindow *window)
     } else {
         GList *wins;
         wins = g_list_append(NULL, window);
-        stacking_list = g_list_remove(stacking_list, window);
+        list_remove(window);
         do_lower(wins);
         g_list_free(wins);
     }
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_below(ObWindow *window, ObWindow *below)
@@ -431,11 +770,10 @@ void stacking_below(ObWindow *window, ObWindow *below)
         return;
 
     wins = g_list_append(NULL, window);
-    stacking_list = g_list_remove(stacking_list, window);
-    before = g_list_next(g_list_find(stacking_list, below));
+    list_remove(window);
+    before = g_list_next(find_link(below));
     do_restack(wins, before);
     g_list_free(wins);
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_add(ObWindow *win)
@@ -445,10 +783,9 @@ void stacking_add(ObWindow *win)
     /* don't add windows that are being unmanaged ! */
     if (WINDOW_IS_CLIENT(win)) g_assert(WINDOW_AS_CLIENT(win)->managed);
 
-    stacking_list = g_list_append(stacking_list, win);
+    list_insert(win, NULL);
 
     stacking_raise(win);
-    /* stacking_list_tail set by stacking_raise() */
 }
 
 static GList *find_highest_relative(ObClient *client)
@@ -462,8 +799,11 @@ static GList *find_highest_relative(ObClient *client)
         /* get all top level relatives of this client */
         top = client_search_all_top_parents_layer(client);
 
-        /* go from the top of the stacking order down */
-        for (it = stacking_list; !ret && it; it = g_list_next(it)) {
+        /* go from the top of the client's layer down */
+        for (it = layer_top[client->layer];
+             !ret && it && link_layer(it) == client->layer;
+             it = g_list_next(it))
+        {
             if (WINDOW_IS_CLIENT(it->data)) {
                 ObClient *c = it->data;
                 /* only look at windows in the same layer and that are
@@ -488,6 +828,7 @@ static GList *find_highest_relative(ObClient *client)
                 }
             }
         }
+        g_slist_free(top);
     }
     return ret;
 }
@@ -518,7 +859,7 @@ void stacking_add_nonintrusive(ObWindow *win)
         if (focus_client && client != focus_client &&
             focus_client->layer == client->layer)
         {
-            it_below = g_list_find(stacking_list, focus_client);
+            it_below = find_link(CLIENT_AS_WINDOW(focus_client));
             /* this can give NULL, but it means the focused window is on the
                bottom of the stacking order, so go to the bottom in that case,
                below it */
@@ -542,26 +883,22 @@ void stacking_add_nonintrusive(ObWindow *win)
         }
     }
 
-    /* make sure it's not in the wrong layer though ! */
-    for (; it_below; it_below = g_list_next(it_below)) {
-        /* stop when the window is not in a higher layer than the window
-           it is going above (it_below) */
-        if (client->layer >= window_layer(it_below->data))
-            break;
-    }
-    for (; it_below != stacking_list; it_below = it_above) {
-        /* stop when the window is not in a lower layer than the
-           window it is going under (it_above) */
-        it_above = it_below ?
-            g_list_previous(it_below) : g_list_last(stacking_list);
-        if (client->layer <= window_layer(it_above->data))
-            break;
+    /* make sure it's not in the wrong layer though ! if the window it is
+       going above (it_below) is in a higher layer, go to the top of the
+       client's layer */
+    if (it_below && client->layer < window_layer(it_below->data))
+        it_below = layer_first(client->layer);
+    /* if the window it is going under (it_above) is in a lower layer, go to
+       the top of the layers below the client's */
+    if (it_below != stacking_list) {
+        it_above = it_below ? g_list_previous(it_below) : stacking_list_tail;
+        if (client->layer > window_layer(it_above->data))
+            it_below = layer_first(client->layer - 1);
     }
 
     wins = g_list_append(NULL, win);
     do_restack(wins, it_below);
     g_list_free(wins);
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 /*! Returns TRUE if client is occluded by the sibling. If sibling is NULL it
@@ -576,7 +913,7 @@ static gboolean stacking_occluded(ObClient *client, ObClient *sibling)
     if (sibling && client->layer != sibling->layer)
         return occluded;
 
-    for (it = g_list_previous(g_list_find(stacking_list, client)); it;
+    for (it = g_list_previous(find_link(CLIENT_AS_WINDOW(client))); it;
          it = g_list_previous(it))
         if (WINDOW_IS_CLIENT(it->data)) {
             ObClient *c = it->data;
@@ -617,7 +954,7 @@ static gboolean stacking_occludes(ObClient *client, ObClient *sibling)
     if (sibling && client->layer != sibling->layer)
         return occludes;
 
-    for (it = g_list_next(g_list_find(stacking_list, client));
+    for (it = g_list_next(find_link(CLIENT_AS_WINDOW(client)));
          it; it = g_list_next(it))
         if (WINDOW_IS_CLIENT(it->data)) {
             ObClient *c = it->data;
@@ -38,18 +38,25 @@ typedef enum {
     OB_NUM_STACKING_LAYERS
 } ObStackingLayer;
 
-/* list of ObWindow*s in stacking order from highest to lowest */
+/* list of ObWindow*s in stacking order from highest to lowest.  it is only
+   changed by the functions here, which keep an index of where each window and
+   each layer is in it */
 extern GList *stacking_list;
 /* list of ObWindow*s in stacking order from lowest to highest */
 extern GList *stacking_list_tail;
 
-/*! Sets the window stacking list on the root window from the
-  stacking_list */
+/*! Marks the window stacking list on the root window as out of date, it will
+  be set from the stacking_list once the pending events have been handled */
 void stacking_set_list(void);
+/*! Sets the window stacking list on the root window from the stacking_list
+  now, if it is out of date */
+void stacking_flush_list(void);
 
 void stacking_add(struct _ObWindow *win);
 void stacking_add_nonintrusive(struct _ObWindow *win);
-#define stacking_remove(win) stacking_list = g_list_remove(stacking_list, win);
+/*! Takes a window out of the stacking order.  win is an ObWindow*, or
+  something which can be used as one, such as an ObClient* */
+void stacking_remove(gpointer win);
 
 /*! Raises a window above all others in its stacking layer */
 void stacking_raise(struct _ObWindow *window);
@@ -0,0 +1,141 @@
+#/*
+#!/bin/sh
+#*/
+#if 0
+gcc -O2 -o ./placebench -I../.. \
+  `pkg-config --cflags --libs obrender-3.5 obt-3.5` \
+  placebench.c ../place_overlap.c && \
+./placebench
+exit
+#endif
+
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   placebench.c for the Openbox window manager
+   Copyright (c) 2003-2007   Dana Jansens
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "../geom.h"
+#include "../place_overlap.h"
+#include <glib.h>
+#include <stdio.h>
+
+/* times placing a window with least overlap among the windows already open,
+   and checks that both ways of searching choose the same place */
+
+/* place_overlap.c reads this from the config */
+gboolean config_place_center = TRUE;
+
+static const gint counts[] = { 5, 20, 50, 100, 150, 300 };
+#define NUM_COUNTS (sizeof(counts) / sizeof(counts[0]))
+
+#define NUM_LAYOUTS 50
+
+static const Rect monitor = { 0, 0, 1920, 1080 };
+
+/* windows of any size, anywhere on and around the monitor */
+static void random_layout(Rect *rects, gint n, Size *req)
+{
+    gint i;
+
+    for (i = 0; i < n; ++i)
+        RECT_SET(rects[i],
+                 g_random_int_range(-200, monitor.width),
+                 g_random_int_range(-200, monitor.height),
+                 g_random_int_range(1, monitor.width / 2),
+                 g_random_int_range(1, monitor.height / 2));
+    SIZE_SET(*req,
+             g_random_int_range(50, monitor.width / 2),
+             g_random_int_range(50, monitor.height / 2));
+}
+
+/* windows the sizes people use, cascaded from a few places the way they
+   build up when they are opened one after another, with some maximized
+   ones and a panel */
+static void realistic_layout(Rect *rects, gint n, Size *req)
+{
+    static const gint sizes[][2] = {
+        { 640, 480 }, { 800, 600 }, { 1024, 768 }, { 484, 316 },
+        { 1280, 720 }, { 500, 400 }, { 300, 200 }
+    };
+    const gint nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    gint i;
+
+    RECT_SET(rects[0], 0, monitor.height - 30, monitor.width, 30);
+    for (i = 1; i < n; ++i) {
+        const gint *s = sizes[g_random_int_range(0, nsizes)];
+
+        if (g_random_int_range(0, 20) == 0)
+            RECT_SET(rects[i], 0, 0, monitor.width, monitor.height - 30);
+        else
+            RECT_SET(rects[i],
+                     (i % 7) * 60 + (i / 7 % 5) * 240,
+                     (i % 7) * 40 + (i / 7 % 3) * 120,
+                     s[0], s[1]);
+    }
+    SIZE_SET(*req, sizes[0][0], sizes[0][1]);
+}
+
+static void bench(const gchar *name,
+                  void (*layout)(Rect *rects, gint n, Size *req))
+{
+    guint i;
+    gint j;
+
+    printf("%s layouts\n", name);
+    for (i = 0; i < NUM_COUNTS; ++i) {
+        gint n = counts[i];
+        Rect *rects[NUM_LAYOUTS];
+        Size req[NUM_LAYOUTS];
+        Point sweep[NUM_LAYOUTS], exhaustive;
+        GTimer *t;
+        gdouble sweep_time, exhaustive_time;
+
+        for (j = 0; j < NUM_LAYOUTS; ++j) {
+            rects[j] = g_new(Rect, n);
+            layout(rects[j], n, &req[j]);
+        }
+
+        t = g_timer_new();
+        for (j = 0; j < NUM_LAYOUTS; ++j)
+            place_overlap_find_least_placement(rects[j], n, &monitor,
+                                               &req[j], &sweep[j]);
+        sweep_time = g_timer_elapsed(t, NULL);
+
+        g_timer_start(t);
+        for (j = 0; j < NUM_LAYOUTS; ++j) {
+            place_overlap_find_least_placement_exhaustive(rects[j], n,
+                                                          &monitor, &req[j],
+                                                          &exhaustive);
+            g_assert(POINT_EQUAL(sweep[j], exhaustive));
+        }
+        exhaustive_time = g_timer_elapsed(t, NULL);
+        g_timer_destroy(t);
+
+        printf("  %3d windows: sweep %9.3f ms  exhaustive %9.3f ms\n", n,
+               sweep_time * 1000 / NUM_LAYOUTS,
+               exhaustive_time * 1000 / NUM_LAYOUTS);
+
+        for (j = 0; j < NUM_LAYOUTS; ++j)
+            g_free(rects[j]);
+    }
+}
+
+int main()
+{
+    bench("random", random_layout);
+    bench("realistic", realistic_layout);
+    return 0;
+}
@@ -166,7 +166,9 @@ void window_manage(Window win)
 
     /* check if it has already been unmapped by the time we started
        mapping. the grab does a sync so we don't have to here */
-    if (xqueue_exists_local(check_unmap, &win)) {
+    if (xqueue_exists_local_for(win, DestroyNotify, check_unmap, &win) ||
+        xqueue_exists_local_for(win, UnmapNotify, check_unmap, &win))
+    {
         ob_debug("Trying to manage unmapped window. Aborting that.");
         no_manage = TRUE;
     }